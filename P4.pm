@@ -37,6 +37,31 @@ $VERSION = qq( 3.5313 );
 
 bootstrap P4 $VERSION;
 
+#
+# Message severities and generic codes, for Messages() and MessageCount()
+#
+use constant E_EMPTY	=> 0;
+use constant E_INFO	=> 1;
+use constant E_WARN	=> 2;
+use constant E_FAILED	=> 3;
+use constant E_FATAL	=> 4;
+
+use constant EV_NONE	=> 0x00;
+use constant EV_USAGE	=> 0x01;
+use constant EV_UNKNOWN	=> 0x02;
+use constant EV_CONTEXT	=> 0x03;
+use constant EV_ILLEGAL	=> 0x04;
+use constant EV_NOTYET	=> 0x05;
+use constant EV_PROTECT	=> 0x06;
+use constant EV_EMPTY	=> 0x11;
+use constant EV_FAULT	=> 0x21;
+use constant EV_CLIENT	=> 0x22;
+use constant EV_ADMIN	=> 0x23;
+use constant EV_CONFIG	=> 0x24;
+use constant EV_UPGRADE	=> 0x25;
+use constant EV_COMM	=> 0x26;
+use constant EV_TOOBIG	=> 0x27;
+
 #
 # Execute a command. The return value depends on the context of the call.
 #
@@ -55,6 +80,112 @@ sub Run
     return $results;
 }
 
+#
+# Iterate over the output of a big changes, jobs, filelog or fstat a page
+# at a time. Returns a P4::Iterator, or undef if the command can't be
+# iterated over.
+#
+sub Iterate
+{
+    my $self = shift;
+    return $self->_Iterate( map { "$_" } @_ );
+}
+
+#
+# Returns the warnings and errors from the last command as hashes, without
+# formatting them unless asked to. Filters are by generic code (see the
+# EV_* constants above), unique message code and severity.
+#
+# Synopsis:	@msgs = $p4->Messages( generic => P4::EV_EMPTY, text => 1 );
+#
+sub Messages
+{
+    my $self = shift;
+    my %opts = @_;
+    my $generic = defined( $opts{ 'generic' } ) ? $opts{ 'generic' } : -1;
+    my $code = $opts{ 'code' } || 0;
+    my @msgs = $self->_Messages( $generic, $code, $opts{ 'text' } ? 1 : 0 );
+
+    return @msgs unless defined( $opts{ 'severity' } );
+    return grep { $_->{ 'severity' } == $opts{ 'severity' } } @msgs;
+}
+
+#
+# In-memory diffs. Either a pair of strings, returning the one result, or
+# a reference to an array of pairs (array refs), returning a list.
+#
+# Synopsis:	$diff = $p4->DiffStrings( $old, $new, "u" );
+#		@hunks = $p4->DiffHunks( [ [ $old1, $new1 ], [ $old2, $new2 ] ] );
+#
+sub DiffStrings
+{
+    my $self = shift;
+    return $self->_Diff( 0, @_ );
+}
+
+sub DiffHunks
+{
+    my $self = shift;
+    return $self->_Diff( 1, @_ );
+}
+
+sub _Diff
+{
+    my $self = shift;
+    my $hunks = shift;
+
+    if( ref( $_[ 0 ] ) eq 'ARRAY' )
+    {
+	my ( $pairs, $flags, $threads ) = @_;
+	$threads = 4 unless defined( $threads );
+	return $self->_DiffStrings( $pairs, $flags, $threads, $hunks );
+    }
+
+    my ( $left, $right, $flags ) = @_;
+    my @r = $self->_DiffStrings( [ [ $left, $right ] ], $flags, 1, $hunks );
+    return $r[ 0 ];
+}
+
+#
+# Compare the workspace with the have list.
+#
+# Synopsis:	$r = $p4->ScanWorkspace( threads => 16, since => $lastSync );
+#
+sub ScanWorkspace
+{
+    my $self = shift;
+    my %opts = @_;
+    my $threads = $opts{ 'threads' } || 8;
+
+    return $self->_ScanWorkspace( $opts{ 'root' }, $threads, 
+				  $opts{ 'since' } || 0 );
+}
+
+#
+# Run a command on several servers at once. Servers are either ports or
+# hashes of port, user, password, client and charset.
+#
+# Synopsis:	@changes = $p4->FanOut( { servers => [ "edge1:1666", 
+#						      "edge2:1666" ],
+#					  sort => "-change" },
+#					"changes", "-m10" );
+#
+sub FanOut
+{
+    my $self = shift;
+    my $opts = shift;
+    my @servers = map { ref( $_ ) ? $_ : { port => $_ } } 
+		  @{ $opts->{ 'servers' } || [] };
+    my $results = $self->_FanOut( \@servers, $opts->{ 'sort' }, 
+				  map { "$_" } @_ );
+
+    return undef		unless defined( $results );
+    return @$results 		if( wantarray );
+    return undef 		if( scalar( @$results ) == 0 );
+    return $$results[ 0 ] 	if( scalar( @$results ) == 1 );
+    return $results;
+}
+
 # Change the current working directory. Returns undef on failure.
 sub SetCwd
 {
@@ -77,8 +208,20 @@ sub SetCwd
 sub Login()
 {
     my $self = shift;
-    $self->SetInput( $self->GetPassword() );
-    return $self->Run( "login" );
+
+    unless( $self->IsTicketCache() )
+    {
+	$self->SetInput( $self->GetPassword() );
+	return $self->Run( "login" );
+    }
+
+    # With ticket caching, only log in if we don't have a ticket already
+    my $results = $self->_Login();
+    return undef		unless defined( $results );
+    return @$results 		if( wantarray );
+    return undef 		if( scalar( @$results ) == 0 );
+    return $$results[ 0 ] 	if( scalar( @$results ) == 1 );
+    return $results;
 }
 
 #
@@ -187,6 +330,23 @@ sub Init
     $self->Connect();
 }
 
+#*******************************************************************************
+#* Iterators returned by P4::Iterate()
+#*******************************************************************************
+package P4::Iterator;
+
+# Returns the next record, or undef when there are no more
+sub Next
+{
+    my $self = shift;
+    while( !@{ $self->{ 'page' } } )
+    {
+	my $page = $self->_NextPage() or return undef;
+	$self->{ 'page' } = $page;
+    }
+    return shift @{ $self->{ 'page' } };
+}
+
 1;
 __END__
 
@@ -228,6 +388,54 @@ Construct a new P4 object. e.g.
 
   my $p4 = new P4;
 
+=item P4::BatchTimes()
+
+Returns a list of hashes describing each batch of the last command
+run with SetBatching() enabled: C<files>, C<bytes>, C<seconds> and, for
+parallel batches, the C<connection> used. The list is empty if the
+command wasn't split.
+
+=item P4::BuildIndex( $file, $path )
+
+Builds a local index of the head revision metadata (headRev, headChange,
+headType, headAction, headTime and fileSize) of the files in $path, from
+a single fstat, and writes it to $file. The index is kept sorted by depot
+path and is used straight from a memory mapping, so that IndexLookup()
+and IndexPrefix() answer in microseconds without asking the server.
+Returns the number of files indexed, or undef on failure.
+
+The index remembers the last change submitted in $path when it was
+built; use UpdateIndex() to bring it up to date.
+
+=item P4::Cancel()
+
+Stops the command that's running, which then returns the output it had
+received so far along with the error "Command cancelled.". Useful from a
+progress callback (see SetProgress()) or an input callback. The
+connection is remade, so the P4 object can be used again straight away.
+Cancelled() says why the last command was stopped.
+
+The same goes for work spread over several connections: parallel
+batches, FanOut(), SaveSpecs() and the pages of an iterator stop too,
+as do the time and output limits. Forms that SaveSpecs() didn't get to
+are reported as not saved.
+
+=item P4::CancelAll()
+
+A class method: stops the commands running on every P4 object in the
+process, as Cancel() does. All it does is set a flag, so it's safe to
+call from another thread. Commands started afterwards aren't affected.
+
+Perl doesn't run a %SIG handler until the command it interrupted has
+finished, so calling CancelAll() from one stops nothing. To have a
+signal stop a command, use SetCancelOnSignal() instead.
+
+=item P4::Cancelled()
+
+Returns why the last command was stopped before it finished:
+C<"cancelled">, C<"signal">, C<"time">, C<"records"> or C<"bytes">.
+Returns undef if it wasn't.
+
 =item P4::Connect()
 
 Initializes the Perforce client and connects to the server.
@@ -245,6 +453,46 @@ For example:
  $client->DebugLevel( 0 );
  print( "Debug level = ", $client->DebugLevel(), "\n" );
 
+=item P4::DiffHunks( $left, $right, [ $flags ] )
+
+=item P4::DiffHunks( \@pairs, [ $flags, [ $threads ] ] )
+
+As DiffStrings(), but rather than diff output, returns a reference to
+an array of hashes describing each block of changed lines. Each has a
+C<type> ('a' for added, 'd' for deleted, or 'c' for changed) and the
+C<leftStart>, C<leftCount>, C<rightStart> and C<rightCount> of the
+block. Starts are line numbers from 1; where a count is 0, the start
+is the line after which the lines were added or deleted.
+
+  for my $h ( @{ $p4->DiffHunks( $old, $new ) } )
+  {
+      print "$h->{ 'type' } at line $h->{ 'rightStart' }\n";
+  }
+
+=item P4::DiffStrings( $left, $right, [ $flags ] )
+
+=item P4::DiffStrings( \@pairs, [ $flags, [ $threads ] ] )
+
+Compares two strings line by line in memory and returns the diff,
+without writing any temporary files. The flags are those of
+C<p4 diff -d>: "n" for RCS output, "c" or "u" (optionally followed by
+the number of lines of context) for context or unified diffs, and "s"
+for a summary, along with "b", "w" or "l" to ignore changes in
+whitespace, all whitespace or line endings. The default is a normal
+diff. Unified diffs have no file name headers, just the hunks.
+
+Given a reference to an array of pairs, each itself an array ref of
+the left and right strings, returns a list of the diffs in the same
+order. The pairs are shared out between a pool of native threads,
+four unless you say otherwise.
+
+If either string of a pair is a character string, both are compared as
+UTF-8 and the diff is a character string; otherwise they are compared
+byte for byte.
+
+  my $diff = $p4->DiffStrings( $old, $new, "u" );
+  my @diffs = $p4->DiffStrings( [ [ $a1, $b1 ], [ $a2, $b2 ] ], "u3", 8 );
+
 =item P4::Dropped()
 
 Returns true if the TCP/IP connection between client and server has 
@@ -261,6 +509,37 @@ Returns a list of the error messages received during execution of
 the last command.
 
 
+=item P4::FanOut( { servers => [ ... ], [ sort => $field ] }, cmd, [ arg, ... ] )
+
+Runs the same command on several servers at once, each over a
+connection and thread of its own, so it takes as long as the slowest
+server rather than all of them added together. Servers may be given
+as ports, or as hashes with a C<port> and any of C<user>, C<password>,
+C<client> and C<charset>; anything not given is taken from this P4
+object, which needn't be connected itself.
+
+The exception is the password, which may be a ticket for this P4
+object's server. It's only passed on to a server with the same port
+(and user, if one is given). Any other server gets the C<password> given
+for it, or else finds its own ticket in P4TICKETS, or P4PASSWD, just as
+a new P4 object would.
+
+The output is always tagged, and every record gets a C<server> field
+holding the port it came from. Without C<sort> the results of each
+server are returned in turn. With it they are merged into order by
+that field, numerically if the values are numbers, and in descending
+order if the name starts with a '-'. Errors and warnings from all the
+servers are available from Errors() and Warnings() as usual.
+
+  my @changes = $p4->FanOut( { servers => [ 'edge1:1666', 'edge2:1666' ],
+                               sort => '-change' },
+                             'changes', '-m10' );
+
+=item P4::FilteredCount()
+
+Returns the number of records discarded by the filter (see SetFilter())
+during the last command.
+
 =item P4::FormatSpec( type, string )
 
 Converts a Perforce form of the specified type (client/label etc.)
@@ -309,6 +588,44 @@ Returns the current address for your Perforce server. Taken from
 a previous call to SetPort(), or from $ENV{P4PORT} or a P4CONFIG
 file.
 
+=item P4::IndexLookup( $depotFile )
+
+Returns a hashref of the metadata for a depot file from the open index,
+or undef if the file isn't in it. Deleted files have no fileSize.
+
+=item P4::IndexPrefix( $prefix )
+
+Returns a list of hashrefs, as for IndexLookup(), for every file in the
+open index whose depot path starts with $prefix, in depot path order.
+
+=item P4::InternStats()
+
+Returns a hashref of statistics about value interning for the last
+command: the number of C<lookups>, the number of C<hits> (values that
+were already in the table), the number of distinct C<entries> and the
+C<hitRate>. A high hit rate means most values were shared rather than
+copied.
+
+=item P4::InternValues( [0|1|2] )
+
+Enables interning of short, repetitive values in tagged output, such
+as C<headAction>, C<headType>, C<action> and C<user> in a large fstat.
+Rather than a separate string for every occurrence, each distinct value
+is stored once per command:
+
+  0	Off (the default).
+  1	Values are copies sharing one string buffer. They behave just
+	like ordinary strings.
+  2	Every occurrence is the very same read-only scalar. This saves
+	the most memory, but the values in the results can't be
+	modified.
+
+Values longer than 64 bytes are never interned, and the table is
+limited in size. Fields whose values rarely repeat (file names,
+digests) stop being interned after the first thousand or so records.
+Setting 1 needs Perl 5.10 or later, and does nothing with older Perls.
+Returns the current setting.
+
 =item P4::IsParseForms()
 
 Returns true if ParseForms mode is enabled on this client.
@@ -320,6 +637,46 @@ Returns true if Tagged mode is enabled on this client.
 a previous call to SetPort(), or from $ENV{P4PORT} or a P4CONFIG
 file.
 
+=item P4::IsTicketCache()
+
+Returns true if ticket caching is enabled (see SetTicketCache()).
+
+=item P4::Iterate( cmd, [$arg...] )
+
+Runs a "changes", "jobs", "filelog" or "fstat" command a page at a time,
+so that even very large results can be worked through without holding
+them all in memory. Returns a P4::Iterator, whose Next() method returns
+the records one at a time, and undef when there are no more:
+
+  my $i = $p4->Iterate( "changes", "-m", 1000, "//depot/..." );
+  while( my $change = $i->Next() ) { ... }
+
+Any -m given is the size of the first page rather than a limit on the
+total. Pages are fetched on a connection of the iterator's own, always
+in tagged mode. While you work through one page the next is fetched in
+the background, and the page size is adjusted so that each fetch takes
+between half a second and two seconds. Each page continues from where
+the last one left off: changes from the last change number, jobs and
+fstat (which must have a single file argument) by job name and depot
+path respectively, and filelog from the oldest revision listed for each
+file. Reverse ordering (-r) isn't supported, and changes are only
+iterated over when submitted, so C<-s submitted> is implied and other
+statuses are refused. A field list given to
+fstat with -T always has depotFile added, as continuing needs it.
+
+Errors from fetching a page are available from Errors() on the P4
+object as usual once Next() returns undef. $i->Pages() returns the
+number of pages fetched so far and $i->PageSize() the current page size.
+
+=item P4::Login()
+
+Logs in using the password given to SetPassword() (or from the
+environment). With ticket caching enabled (see SetTicketCache()), a
+cached ticket for the server and user is used if there is one, without
+contacting the server at all. Otherwise C<p4 login -p> is run and the 
+ticket it returns is cached and used in place of the password, so 
+GetPassword() returns the ticket from then on.
+
 =item P4::MergeErrors( [0|1] )
 
 For backwards compatibility. In previous versions of P4, errors and
@@ -336,6 +693,48 @@ warnings will go into the error array. i.e.
   $p4->MergeErrors( 0 );
 
 
+=item P4::MergeOutput( [0|1] )
+
+Gets and optionally sets output merging. Normally, the content of a file
+returned by commands such as C<print> arrives as a series of chunks, each
+of which becomes a separate result element. With output merging enabled,
+consecutive chunks of file content (and the output of C<diff>) are copied
+straight into a single scalar instead, so a large file costs one copy
+and one scalar rather than one per chunk. Any other output (e.g. the
+tagged header for the next file) ends the current scalar.
+
+  $p4->MergeOutput( 1 );
+  my ( $header, $content ) = $p4->Print( "//depot/big.iso" );
+
+=item P4::MessageCount( [ generic ] )
+
+Returns the number of warnings and errors from the last command, or
+just those with the given generic code (P4::EV_EMPTY for "no such
+file(s)" and the like, P4::EV_PROTECT for permission problems, etc.).
+The counts are kept as messages arrive, so no formatting is involved.
+
+=item P4::Messages( [ generic => $g ], [ code => $c ], [ severity => $s ], [ text => 1 ] )
+
+Returns the warnings and errors from the last command as a list of
+hashrefs with the message's C<severity> (P4::E_WARN, P4::E_FAILED or
+P4::E_FATAL), C<generic> code, unique C<code>, C<subsystem>, C<subcode>
+and C<args>, a hashref of the values substituted into the message. The
+text is only formatted (into C<text>) if asked for. Messages can be
+picked out by generic code, unique code or severity:
+
+  my @missing = $p4->Messages( generic => P4::EV_EMPTY );
+  my @real    = grep { $_->{ 'generic' } != P4::EV_EMPTY } $p4->Messages();
+
+Messages are kept unformatted until Errors(), Warnings() or Messages()
+with C<text> asks for them, so commands that produce many thousands of
+per-file warnings no longer pay for formatting them all.
+
+=item P4::OpenIndex( $file )
+
+Opens an index written by BuildIndex(), for use with IndexLookup(),
+IndexPrefix() and UpdateIndex(). Returns the number of files in the
+index, or undef if it can't be opened.
+
 =item P4::ParseForms()
 
 Request that forms returned by commands such as C<$p4-E<gt>GetChange()>, or
@@ -354,12 +753,42 @@ equivalent:
     my $hash = $p4->ParseClient( $clientspec );
 
 
+=item P4::ParseSpecs( type, \@forms, [ threads ] )
+
+Parses a whole array of forms of the same type, returning a list with
+a hashref for each, in the same order. The specdef is fetched once and
+the forms are parsed on a pool of native threads (four unless you say
+otherwise); only the conversion to hashes happens on Perl's thread. A
+form that can't be parsed gives undef in its place, and its error is
+added to Errors() without stopping the rest. The error says which form
+it was, and the form's index is also in the C<formIndex> argument of the
+error as returned by Messages().
+Requires ParseForms mode.
+
 =item P4::Password( $oldpass, $newpass )
 
 Run a C<p4 password> command to change the user's password from
 $oldpass to $newpass. Not to be confused with P4::SetPassword.
 
 
+=item P4::ProgressStats()
+
+Returns a hashref of progress statistics for the last command (or the
+current one, if called from a progress callback): the C<files> and
+C<bytes> done so far, the C<totalFiles> and C<totalBytes> expected if
+the server said, the C<elapsed> time in seconds, the average transfer
+C<rate> in bytes per second, and a C<description> of the current 
+operation if the API supplied one. The statistics are kept whether or 
+not a progress callback is set.
+
+=item P4::ReplicaStats()
+
+Returns a list of hashes describing the replicas given to SetReplicas():
+the C<port>, the moving average C<latency> of the commands it has run
+(in seconds), the number of C<commands> it has run and of C<failures>
+in a row, and whether it's currently C<healthy> and C<synced> with the
+primary. 
+
 =item P4::Run( cmd, [$arg...] )
 
 Run a Perforce command returning the results. Since Perforce commands
@@ -413,6 +842,85 @@ Pay attention to the calls to client-FstatInfo(), client-OutputText(),
 client-OutputData() and client-HandleError(). I<Each call to one of these
 functions results in either a result element, or an error element.>
 
+=item P4::SaveSpecs( type, \@specs, [ connections ] )
+
+Saves a whole array of specs (hashes) of the same type, as if by
+Save<type>() for each, and returns a list with a hashref for each spec
+in the same order. C<saved> is true if the server accepted it, and
+C<message> holds what the server said ("Job job000123 saved." or the
+error). All the hashes are formatted against the cached specdef first,
+then the forms are sent on a pool of extra connections, four unless
+you say otherwise; with one, your own connection is used. The output
+and errors are also available from Output(), Errors() etc. in the
+usual way. Requires ParseForms mode.
+
+  my @status = $p4->SaveSpecs( "job", \@jobs, 8 );
+  my @failed = grep { !$status[ $_ ]->{ 'saved' } } 0 .. $#status;
+
+=item P4::ScanWorkspace( [ root => $dir ], [ threads => $n ], [ since => $time ] )
+
+Compares the files in the workspace with the revisions you have, much
+as C<p4 diff -se> and C<p4 diff -sd> would, together with the files
+C<p4 reconcile -n> would add. The directory tree under C<root> (the
+client root by default) is read by a pool of threads, eight unless
+you say otherwise. Files whose size rules out a match are reported
+straight away; the rest are hashed, again in parallel, and their MD5
+digests compared with those the server holds for the have revisions.
+Files modified before the C<since> time (in seconds since the epoch,
+say the time of your last sync) are assumed to be unchanged if their
+size is right, and aren't hashed at all.
+
+Returns a hashref with C<modified>, C<missing>, C<extra> and
+C<unchecked> arrays of local paths, plus the number of C<files> found
+and the number C<hashed>. Opened files are left out. Files that can't
+be compared locally, such as utf16 files or unicode files translated
+to another charset, are listed as unchecked. P4IGNORE is not applied
+to the extra files.
+
+  my $r = $p4->ScanWorkspace( threads => 16 );
+  print "$_\n" for @{ $r->{ 'modified' } };
+
+=item P4::SetAggregate( \%spec )
+
+Aggregates the tagged output of the next command in C++, so that only
+the summary comes back to Perl rather than a hash per record. The spec
+may contain:
+
+  group		A field name, or a reference to an array of them, to
+		group the records by. "field:N" keeps only the first N
+		levels of a depot path, so depotFile:2 groups files
+		by //depot/dir.
+  sum, min, max	A numeric field name (or array of them) to total, or
+		find the smallest or largest value of, in each group.
+  order		The column to sort the rows by: "count", or one of 
+		"sum(field)", "min(field)" and "max(field)".
+  ascending	Sort in ascending order. The default is descending.
+  top		Return only the first N rows.
+
+Each row is a hash containing the group fields, the number of records
+in the group as C<count>, and the requested columns. Without any group
+fields, there's a single row for the whole output. For example, to find
+the total size of each file type in each top-level directory:
+
+  $p4->SetAggregate( { group => [ 'headType', 'depotFile:2' ],
+		       sum   => 'fileSize',
+		       order => 'sum(fileSize)' } );
+  foreach my $row ( $p4->Fstat( "-Ol", "//..." ) ) {
+      print "$row->{ 'depotFile' } $row->{ 'headType' } ",
+	    "$row->{ 'count' } $row->{ 'sum(fileSize)' }\n";
+  }
+
+With no group or columns, but C<top> and C<order>, the top N records
+themselves are returned, ordered by the named field:
+
+  $p4->SetAggregate( { top => 100, order => 'fileSize' } );
+  my @biggest = $p4->Fstat( "-Ol", "//..." );
+
+Records that don't contain a numeric value for a field are left out of
+its columns. Any filter set with SetFilter() is applied first. The 
+aggregate only applies to the next command. Returns undef (with a 
+warning) if the spec is invalid.
+
 =item P4::SetApiLevel( integer )
 
 Specify the API compatibility level to use for this script. 
@@ -431,6 +939,103 @@ Must be called before calling P4::Connect(). e.g.
   $p4->Connect() or die( "Failed to connect to Perforce" );
   etc.
 
+=item P4::SetAutoReconnect( attempts, [ maxwait ] )
+
+Enables managed connection mode. Before and after each command, P4
+checks whether the connection to the server has been dropped (by a 
+server restart or an idle timeout, for example) and if so it connects
+again transparently, replaying your tagged, form parsing, API level,
+charset and program name settings. Up to C<attempts> connection 
+attempts are made, pausing between them for an exponentially 
+increasing period which never exceeds C<maxwait> seconds (default 5).
+
+If the connection was dropped while a read-only command such as 
+C<fstat>, C<changes> or C<print> (or any C<-o> form fetch) was running,
+the command is run again, once, on the new connection. Other commands
+are not retried as they may already have taken effect. A value of 0 
+disables managed mode.
+
+  $p4->SetAutoReconnect( 5, 30 );
+  $p4->Connect() or die( "Failed to connect to Perforce" );
+
+=item P4::SetAutoSplit( connections )
+
+Enables automatic splitting of commands that the server refuses for
+going over the limits set by SetMaxResults() and SetMaxScanRows() (or
+by your group). When that happens, the command is run again in pieces:
+each path argument on its own, and paths ending in C<...> that are still
+too big split into the files directly in that directory and a path for
+each of its subdirectories (found with C<p4 dirs>), and so on down until
+every piece fits. The output of the pieces is merged, grouped by 
+directory, and handed on as soon as each is complete. A path that can't
+be split any further still gets the limit error.
+
+Splitting only applies to commands whose output is a list of records
+for each file: C<files>, C<filelog>, C<fstat>, C<have>, C<integrated>,
+C<opened>, C<print>, C<sizes> and C<verify>. If C<connections> is more
+than 1, the pieces are run in parallel on that many extra connections
+(those used by SetBatching()). 0 turns splitting off. SplitCount() says
+how many paths the last command had to be split into pieces.
+
+  $p4->SetMaxScanRows( 500000 );
+  $p4->SetAutoSplit( 4 );
+  my @files = $p4->Fstat( '//depot/...' );
+  print "Split ", $p4->SplitCount(), " times\n";
+
+=item P4::SetBatching( files, [ bytes, [ connections ] ] )
+
+Enables argument batching. From then on, a command with more than 
+C<files> file arguments, or whose file arguments add up to more than
+C<bytes> bytes, is split into a series of smaller commands so that it
+doesn't hit server limits or hold server tables locked for a long time.
+Each batch is given all of the original options. The output, warnings
+and errors of all of the batches are merged, in order, into the usual
+results. A limit of 0 is no limit, and C<SetBatching( 0 )> turns
+batching off.
+
+Options are the leading arguments starting with '-'. Options which
+take a value (such as C<-c>, C<-t>, C<-m> or C<-F>) bring the next
+argument with them, and C<--> ends the options.
+
+If C<connections> is more than 1, the batches are run in parallel on 
+that many extra connections to the server, which are made when first 
+needed and closed by Disconnect(). This is best kept for read-only 
+commands such as C<fstat> and C<files>. e.g.
+
+  $p4->SetBatching( 5000, 0, 4 );
+  my @files = $p4->Fstat( @lots_of_files );
+  foreach my $b ( $p4->BatchTimes() ) {
+      print "$b->{ 'files' } files in $b->{ 'seconds' }s\n";
+  }
+
+There is no need for the command line client's C<-x> argument files:
+the API sends the arguments straight to the server.
+
+=item P4::SetBudget( records, [ bytes ] )
+
+Limits how much output each command may return. Once a command has
+returned C<records> results (records, lines or chunks of file content),
+or C<bytes> bytes of output, it's stopped and you get what had arrived
+so far, with the warning "Output truncated: ..." to say the results are
+incomplete. Filtered and aggregated records don't count. A limit of 0 is
+no limit, and C<SetBudget( 0 )> removes the budget. e.g.
+
+  $p4->SetBudget( 1000 );
+  my @files = $p4->Files( '//depot/...' );	# The first 1000 at most
+  print "Truncated\n" if $p4->Cancelled();
+
+=item P4::SetCancelOnSignal( enable )
+
+With this enabled, a signal that arrives while a command is running, and
+that has a Perl handler in %SIG, stops the command. Run() then returns
+the output received so far with the error "Command cancelled by a
+signal.", and the handler runs straight afterwards. Without it, Perl
+holds the signal until the command has finished, however long that
+takes.
+
+  $SIG{ INT } = sub { $interrupted = 1 };
+  $p4->SetCancelOnSignal( 1 );
+
 =item P4::SetCharset( $charset )
 
 Specify the character set to use for local files when used with a
@@ -458,6 +1063,50 @@ Perforce conventions. i.e.
 Sets the current working directory for the client. This should
 be called after the Connect() and before the Run().
 
+=item P4::SetFieldType( $field, $type, [ $command ] )
+
+Overrides the built-in table of numeric fields used when TypedValues()
+is enabled. C<$type> is "int", "num" (floating point) or "string". If
+C<$command> is given, the override only applies to that command. e.g.
+
+  $p4->TypedValues( 1 );
+  $p4->SetFieldType( "value", "int", "counters" );
+  $p4->SetFieldType( "time", "string" );
+
+Returns undef (with a warning) if the type is unknown.
+
+=item P4::SetFilter( $expression )
+
+Sets a filter for the tagged output of the next command. Records that
+don't match the filter are thrown away before they're converted into
+Perl hashes, which is much faster than filtering the results yourself
+when most of them are unwanted. For example:
+
+  $p4->SetFilter( 'headType =~ /binary/ && fileSize > 104857600' );
+  my @big = $p4->Fstat( "-Ol", "//depot/..." );
+  print $p4->FilteredCount(), " records discarded\n";
+
+An expression is made up of comparisons between a field name and a
+value, combined with C<&&>, C<||> and C<!> (or C<and>, C<or> and C<not>)
+and grouped with parentheses. The comparison operators are:
+
+  ==  !=		String equality. If the value contains * or ? 
+			it's a glob match instead, so //depot/main/* 
+			matches everything under //depot/main/.
+  < <= > >=		Numeric comparison.
+  =~  !~		Regular expression match. e.g. /^text/i
+
+Values may be quoted with single or double quotes, and must be if they
+contain spaces. A comparison involving a field that is missing from a
+record is always false. Regular expressions require Perl 5.10 or later.
+
+For C<fstat>, P4 also translates the parts of the filter it safely can
+into an C<-F> argument, so the server doesn't send records which would
+only be discarded. It doesn't do this if you supply C<-F> yourself.
+
+The filter only applies to the next command. Returns undef (with a 
+warning) if the expression can't be parsed.
+
 =item P4::SetHost( $hostname )
 
 Sets the name of the client host - overriding the actual hostname.
@@ -468,11 +1117,34 @@ don't know when or why you might want to do that, then don't do it.
 =item P4::SetInput( arg )
 
 Save the supplied argument as input to be supplied to a subsequent 
-command.  The input may be: a hashref, a scalar string or an array 
-of hashrefs or scalar strings. Note that if you pass an array the
-array will be shifted once each time the Perforce command being
+command.  The input may be: a hashref, a scalar string, a filehandle,
+a code ref or an array of any of these. Note that if you pass an array
+the array will be shifted once each time the Perforce command being
 executed asks for user input.
 
+Filehandles and code refs let you supply large inputs without building
+them in memory first. A filehandle is read to end of file, in large
+blocks straight into the command's input buffer; when the command is
+prompting (for a password, say) only one line is read. A code ref is 
+called each time input is needed, with the prompt text as its argument
+if there is one, and should return a hashref or string, or undef when
+it has nothing more to give. e.g.
+
+  open( my $fh, "<", "bigclient.txt" ) or die;
+  $p4->SetInput( $fh );
+  $p4->Run( "client", "-i" );
+
+  $p4->SetInput( sub { shift( @specs ) } );
+
+=item P4::SetKeepAlive( seconds )
+
+Keep an idle connection warm by sending a cheap command to the server
+whenever it has been idle for the given number of seconds. The
+keepalive traffic is sent from a background thread, so long-running
+daemons don't need to arrange it themselves. A value of 0 turns it off.
+
+  $p4->SetKeepAlive( 300 );
+
 =item P4::SetMaxResults( value )
 
 Limit the number of results for subsequent commands to the value
@@ -509,6 +1181,29 @@ to:
 Set the name of your script. This value is displayed in the server log
 on 2004.2 or later servers.
 
+=item P4::SetProgress( $coderef, [ $interval ] )
+
+Sets a callback to report the progress of long-running commands such
+as C<sync>, C<print> and C<submit>. The callback is called with a 
+hashref like the one returned by ProgressStats(), no more often than 
+every C<$interval> seconds (default 1), and once more with C<done> set
+when the command finishes. While a command is running, C<rate> is the
+transfer rate over the last few reports, so a collapse in throughput 
+shows up quickly.
+
+Files are counted from the command's output, and with 2012.1 or later 
+APIs, from the API's own progress indicators, which also give byte 
+counts for file transfers. e.g.
+
+  $p4->SetProgress( sub {
+      my $p = shift;
+      printf( "%d/%d files, %.1f MB/s\n", $p->{ 'files' }, 
+	      $p->{ 'totalFiles' }, $p->{ 'rate' } / 1048576 );
+  }, 5 );
+  $p4->Sync( "//depot/..." );
+
+Pass undef to remove the callback.
+
 =item P4::SetProtocol( $protflag, $value )
 
 Set protocol options for this session. Deprecated. Use C<Tagged()> or
@@ -521,6 +1216,63 @@ For example:
  my @f = $p4->Fstat( "filename" );
  my $c = $f[ 0 ]->{ 'clientFile' };
 
+=item P4::SetReplicas( \@ports, [ lagwindow ] )
+
+Sends read-only commands, such as C<fstat>, C<files>, C<changes>,
+C<describe>, C<filelog> and C<print> (and C<-o> form fetches), to a set
+of read-only replicas, while everything else goes to the server given
+by SetPort(). Connections to the replicas are made when first needed,
+with the same user, client, charset and protocol settings, and are
+closed by Disconnect().
+
+Each read goes to whichever replica has been answering quickest
+recently; replicas not used yet are tried first. One that can't be
+reached, or drops the connection, is left alone for a while (a second,
+doubling on each failure up to a minute) and the command is run
+elsewhere. If no replica is available, the primary is used.
+
+So that you read your own writes, after any other command each replica
+is asked (with C<p4 pull -lj>) whether it has caught up with the
+primary before it's used again. Replicas that can't say, perhaps
+because you lack the C<super> access that needs, are used again once
+C<lagwindow> seconds (10 by default) have passed since the write. An
+empty list turns routing off.
+
+  $p4->SetPort( 'commit:1666' );
+  $p4->SetReplicas( [ 'replica1:1666', 'replica2:1666' ] );
+  $p4->Connect() or die( "Failed to connect to Perforce" );
+  my @changes = $p4->Changes( '-m10' );		# From a replica
+
+=item P4::SetTicketCache( enable, [ $file ] )
+
+Enables caching of login tickets. After Login() (or after a command
+refused because you need to log in, which is then logged in and run
+again automatically) the ticket is kept for the life of the process, 
+and used instead of the password by every P4 object connecting to the
+same server as the same user, by the extra connections used for
+batching and replicas, and by child processes. New connections
+therefore need no login round trip at all. If a cached ticket expires,
+the next command that's refused for it logs in again with the password
+and is retried, once.
+
+If C<$file> is given, tickets are also kept there, in the same form as
+a P4TICKETS file, so that later processes can use them too. The file is
+only readable by its owner. The user's own tickets file isn't touched.
+
+  $p4->SetPassword( $password );
+  $p4->SetTicketCache( 1, "$ENV{HOME}/.p4perl_tickets" );
+  $p4->Connect() or die( "Failed to connect to Perforce" );
+  $p4->Login();
+
+=item P4::SetTimeLimit( seconds )
+
+Sets a deadline for each command. A command still running C<seconds>
+after it started is stopped, and returns the output it had received by
+then along with the error "Command cancelled: time limit of ... seconds
+reached.". Fractions of a second are allowed; 0 removes the limit. The
+API checks for this every half second or so while waiting for the
+server. Stopped commands aren't retried by SetAutoReconnect().
+
 =item P4::SetUser( $username )
 
 Set your Perforce username. Defaults to:
@@ -533,12 +1285,54 @@ Set your Perforce username. Defaults to:
 
 Deprecated in favour of C<Tagged> (same functionality).
 
+=item P4::SplitCount()
+
+Returns the number of times the last command had to be split up to
+fit within the server's limits (see SetAutoSplit()), or 0 if it
+wasn't.
+
 =item P4::Tagged()
 
 Responses from commands that support tagged output will be returned
 in the form of a hashref rather than plain text. Must be called 
 prior to calling C<Connect()>.
 
+=item P4::TypedValues( [0|1] )
+
+When enabled, fields in tagged output that are known to hold numbers,
+such as C<headRev>, C<change>, C<fileSize>, C<headTime> and C<time>,
+are returned as Perl integers rather than strings. Each one then takes
+less memory, and sorting or summing them needs no conversion. Values
+that aren't plain integers (a change of "default", say) are left as
+strings. Form fields are only converted if the spec says they hold a
+single word, so dates and text in forms always stay strings.
+
+Returns the current setting. Use SetFieldType() to change the type of
+particular fields.
+
+=item P4::UpdateIndex()
+
+Brings the open index up to date. The changes submitted since the last
+one the index has seen are replayed from "describe -s", the files they
+touched are fstat'ed for their sizes, and the index file is rewritten in
+a single pass and remapped. Returns the number of changes applied.
+
+=item P4::Utf8Values( [0|1] )
+
+For use with unicode servers when the charset is C<utf8>. When
+enabled, tagged values, info messages, errors and warnings that hold
+any non-ASCII text come back as Perl character strings (with the UTF-8
+flag on), so there's no need to run C<Encode::decode_utf8()> over
+them. Each value is validated in C++ first; anything that isn't valid
+UTF-8 is left as bytes, and plain ASCII needs no flag. File content
+from print and friends is never flagged. Has no effect with any other
+charset.
+
+  $p4->SetCharset( "utf8" );
+  $p4->Utf8Values( 1 );
+
+Returns the current setting.
+
 =item P4::WarningCount()
 
 Returns the number of warnings issued by the last command.
@@ -607,6 +1401,28 @@ For example:
 
 =back
 
+=head1 FORKING AND THREADS
+
+=head2 Forking
+
+P4 objects may safely be inherited across a C<fork()>, so preforking
+servers can connect (and log in, and fetch spec definitions) once in the
+parent. The first time a child uses an inherited object, P4 closes its
+copy of the connection it shares with the parent without sending
+anything on it, and connects again using the same settings, specdef
+cache and ticket.
+Calling Disconnect() in a child never disturbs the parent's connection.
+
+=head2 Threads
+
+P4 objects may also be used with Perl ithreads. When a thread is created,
+each P4 object copied into it gets its own connection with the same
+settings (including the specdef cache). If the original object was
+connected, the copy connects when it's first used in the new thread,
+and its keepalive thread, if any, starts when it first runs a command.
+Objects are never shared between threads, so each thread can run
+commands in parallel with the others.
+
 =head1 COMPATIBILITY WITH PREVIOUS VERSIONS
 
 This version of P4 is largely backwards compatible with previous
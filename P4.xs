@@ -50,6 +50,9 @@ extern "C"
 #include "strtable.h"
 #include "debug.h"
 #include "p4perldebug.h"
+#include "p4perlsys.h"
+#include "p4breaker.h"
+#include "p4iterator.h"
 #include "perlclientapi.h"
 
 /*
@@ -74,10 +77,39 @@ extern "C"
  * results.
  */
 
-#define CLIENT_PTR_NAME 	"_p4client_ptr"
+/*
+ * The PerlClientApi object is attached to the P4 object's HV using
+ * extension magic rather than being stored in it as a plain IV. That lets
+ * Perl tell us when the HV is freed and, in threaded Perls, when it's
+ * copied into a new interpreter. Each interpreter therefore owns its own
+ * PerlClientApi (and ClientApi) and nothing is ever freed twice.
+ */
 
-static PerlClientApi *
-ExtractClient( SV *var )
+static int
+P4ClientFree( pTHX_ SV *sv, MAGIC *mg )
+{
+    delete (PerlClientApi *) mg->mg_ptr;
+    mg->mg_ptr = 0;
+    return 0;
+}
+
+#ifdef USE_ITHREADS
+static int
+P4ClientDup( pTHX_ MAGIC *mg, CLONE_PARAMS *param )
+{
+    PerlClientApi *	c = (PerlClientApi *) mg->mg_ptr;
+
+    if( c )
+	mg->mg_ptr = (char *) c->Clone();
+    return 0;
+}
+#endif
+
+// Filled in at BOOT time
+static MGVTBL p4ClientVtbl;
+
+static MAGIC *
+ClientMagic( SV *var )
 {
     if (!(sv_isobject((SV*)var) && sv_derived_from((SV*)var,"P4")))
     {
@@ -85,16 +117,69 @@ ExtractClient( SV *var )
 	return 0;
     }
 
-    HV *	h = (HV *)SvRV( var );
-    SV **	c = hv_fetch( h, CLIENT_PTR_NAME, strlen( CLIENT_PTR_NAME ),0);
+    for( MAGIC *mg = SvMAGIC( SvRV( var ) ); mg; mg = mg->mg_moremagic )
+	if( mg->mg_type == PERL_MAGIC_ext && mg->mg_virtual == &p4ClientVtbl )
+	    return mg;
+
+    warn( "No client object attached to P4 object!" );
+    return 0;
+}
+
+static PerlClientApi *
+ExtractClient( SV *var )
+{
+    MAGIC *	mg = ClientMagic( var );
+    return mg ? (PerlClientApi *) mg->mg_ptr : 0;
+}
+
+/*
+ * P4::Iterator objects carry their P4Iterator the same way. An iterator
+ * has a connection (and maybe a thread) of its own, which can't be
+ * shared with another interpreter, so a copy in a new thread is inert.
+ */
+
+static int
+P4IteratorFree( pTHX_ SV *sv, MAGIC *mg )
+{
+    delete (P4Iterator *) mg->mg_ptr;
+    mg->mg_ptr = 0;
+    return 0;
+}
+
+#ifdef USE_ITHREADS
+static int
+P4IteratorDup( pTHX_ MAGIC *mg, CLONE_PARAMS *param )
+{
+    mg->mg_ptr = 0;
+    return 0;
+}
+#endif
 
-    if( !c )
+// Filled in at BOOT time
+static MGVTBL p4IteratorVtbl;
+
+static MAGIC *
+IteratorMagic( SV *var )
+{
+    if (!(sv_isobject((SV*)var) && sv_derived_from((SV*)var,"P4::Iterator")))
     {
-	warn( "No '" CLIENT_PTR_NAME "' member found in P4 object!" );
+	warn("Not a P4::Iterator object!" );
 	return 0;
     }
 
-    return (PerlClientApi *) SvIV( *c );
+    for( MAGIC *mg = SvMAGIC( SvRV( var ) ); mg; mg = mg->mg_moremagic )
+	if( mg->mg_type == PERL_MAGIC_ext && mg->mg_virtual == &p4IteratorVtbl )
+	    return mg;
+
+    warn( "No iterator attached to P4::Iterator object!" );
+    return 0;
+}
+
+static P4Iterator *
+ExtractIterator( SV *var )
+{
+    MAGIC *	mg = IteratorMagic( var );
+    return mg ? (P4Iterator *) mg->mg_ptr : 0;
 }
 
 
@@ -102,26 +187,40 @@ ExtractClient( SV *var )
 MODULE = P4	PACKAGE = P4
 VERSIONCHECK: DISABLE
 
+BOOT:
+    /*
+     * The members of MGVTBL vary between versions of Perl, so the vtables
+     * are zeroed statics and just the ones we use are set here.
+     */
+    p4ClientVtbl.svt_free = P4ClientFree;
+    p4IteratorVtbl.svt_free = P4IteratorFree;
+#ifdef USE_ITHREADS
+    p4ClientVtbl.svt_dup = P4ClientDup;
+    p4IteratorVtbl.svt_dup = P4IteratorDup;
+#endif
+
 SV *
 new( CLASS )
 	char *CLASS;
 
 	INIT:
-	    SV *		iv;
 	    HV *		myself;
 	    HV *		stash;
+	    MAGIC *		mg;
 	    PerlClientApi *	c;
 
 	CODE:
 	    /*
-	     * Create a PerlClientApi object and stash a pointer to it
-	     * in an HV.
+	     * Create a PerlClientApi object and attach it to an HV
 	     */
 	    c = new PerlClientApi();
-	    iv = newSViv( (I32)c );
 
 	    myself = newHV();
-	    hv_store( myself, CLIENT_PTR_NAME, strlen( CLIENT_PTR_NAME ), iv, 0 );
+	    mg = sv_magicext( (SV *)myself, 0, PERL_MAGIC_ext, &p4ClientVtbl,
+			      (const char *) c, 0 );
+#ifdef USE_ITHREADS
+	    mg->mg_flags |= MGf_DUP;
+#endif
 
 	    /* Return a blessed reference to the HV */
 	    RETVAL = newRV_noinc( (SV *)myself );
@@ -136,12 +235,13 @@ DESTROY( THIS )
 	SV	*THIS
 
 	INIT:
-	    PerlClientApi	*c;
+	    MAGIC	*mg;
 
 	CODE:
-	    c = ExtractClient( THIS );
-	    if( !c ) XSRETURN_UNDEF;
-	    delete c;
+	    mg = ClientMagic( THIS );
+	    if( !mg ) XSRETURN_UNDEF;
+	    delete (PerlClientApi *) mg->mg_ptr;
+	    mg->mg_ptr = 0;
 
 SV *
 Dropped( THIS )
@@ -377,6 +477,86 @@ _Run( THIS, cmd, ... )
 	OUTPUT:
 	    RETVAL
 
+void
+BatchTimes( THIS )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+	    AV *		a;
+	    SV **		s;
+	    int			i;
+
+	PPCODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    a = c->GetBatchTimes();
+	    sv_2mortal( (SV *) a );
+	    for( i = 0; i <= av_len( a ); i++ )
+	    {
+		s = av_fetch( a, i, 0 );
+		if( !s ) continue;
+		XPUSHs( *s );
+	    }
+
+SV *
+BuildIndex( THIS, file, path )
+	SV *	THIS
+	SV *	file
+	SV *	path
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    if ( !c->IsConnected() )
+	    {
+		warn("P4::BuildIndex() - Not connected. Call P4::Connect() first" );
+		XSRETURN_UNDEF;
+	    }
+	    RETVAL = c->BuildIndex( SvPV_nolen( file ), SvPV_nolen( path ) );
+
+	OUTPUT:
+	    RETVAL
+
+void
+Cancel( THIS )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    c->Cancel();
+
+void
+CancelAll( ... )
+	CODE:
+	    // A class method: it stops the commands of every P4 object
+	    PerlClientApi::CancelAll();
+
+SV *
+Cancelled( THIS )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+	    const char *	reason;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    reason = c->Cancelled();
+	    if( !reason ) XSRETURN_UNDEF;
+	    RETVAL = newSVpv( reason, 0 );
+
+	OUTPUT:
+	    RETVAL
+
 SV *
 DebugLevel( THIS, ... )
 	SV * 	THIS
@@ -407,6 +587,40 @@ DebugLevel( THIS, ... )
 	OUTPUT:
 	    RETVAL
 	    
+void
+_DiffStrings( THIS, pairs, flags, threads, hunks )
+	SV *	THIS
+	SV *	pairs
+	SV *	flags
+	int	threads
+	int	hunks
+
+	INIT:
+	    PerlClientApi *	c;
+	    AV *		a;
+	    SV **		s;
+	    int			i;
+
+	PPCODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if( !SvROK( pairs ) || SvTYPE( SvRV( pairs ) ) != SVt_PVAV )
+	    {
+		warn( "Argument to DiffStrings must be an array ref" );
+		XSRETURN_UNDEF;
+	    }
+
+	    a = c->DiffStrings( (AV *) SvRV( pairs ), 
+			        SvOK( flags ) ? SvPV_nolen( flags ) : "",
+				threads, hunks );
+	    sv_2mortal( (SV *) a );
+	    for( i = 0; i <= av_len( a ); i++ )
+	    {
+		s = av_fetch( a, i, 0 );
+		XPUSHs( s ? *s : &PL_sv_undef );
+	    }
+
 void
 Errors( THIS )
 	SV * 	THIS
@@ -442,6 +656,59 @@ ErrorCount( THIS )
 	OUTPUT:
 	    RETVAL
 	
+SV *
+_FanOut( THIS, servers, sort, cmd, ... )
+	SV *	THIS
+	SV *	servers
+	SV *	sort
+	SV *	cmd
+
+	INIT:
+	    PerlClientApi *	c;
+	    I32			va_start = 4;
+	    I32			i;
+	    char **		cmdargs = NULL;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if( !SvROK( servers ) || SvTYPE( SvRV( servers ) ) != SVt_PVAV )
+	    {
+		warn( "P4::FanOut() - Servers must be an array reference" );
+		XSRETURN_UNDEF;
+	    }
+
+	    /* P4::FanOut() has already stringified the arguments */
+	    if( items > va_start )
+	    {
+		New( 0, cmdargs, items - va_start, char * );
+		for( i = va_start; i < items; i++ )
+		    cmdargs[ i - va_start ] = SvPV_nolen( ST( i ) );
+	    }
+
+	    RETVAL = c->FanOut( (AV *) SvRV( servers ),
+				SvOK( sort ) ? SvPV_nolen( sort ) : 0,
+				SvPV_nolen( cmd ), items - va_start, cmdargs );
+	    if( cmdargs ) Safefree( cmdargs );
+
+	OUTPUT:
+	    RETVAL
+
+I32
+FilteredCount( THIS )
+	SV * 	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    RETVAL = c->GetFilteredCount();
+	OUTPUT:
+	    RETVAL
+
 SV *
 FormatSpec( THIS, type, hash )
 	SV *	THIS
@@ -474,6 +741,45 @@ FormatSpec( THIS, type, hash )
 	OUTPUT:
 	    RETVAL
 
+SV *
+IndexLookup( THIS, path )
+	SV *	THIS
+	SV *	path
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    RETVAL = c->IndexLookup( SvPV_nolen( path ) );
+
+	OUTPUT:
+	    RETVAL
+
+void
+IndexPrefix( THIS, prefix )
+	SV *	THIS
+	SV *	prefix
+
+	INIT:
+	    PerlClientApi *	c;
+	    AV *		a;
+	    SV **		s;
+	    int			i;
+
+	PPCODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    a = c->IndexPrefix( SvPV_nolen( prefix ) );
+	    sv_2mortal( (SV *) a );
+	    for( i = 0; i <= av_len( a ); i++ )
+	    {
+		s = av_fetch( a, i, 0 );
+		if( !s ) continue;
+		XPUSHs( *s );
+	    }
+
 I32
 IsParseForms( THIS )
 	SV *	THIS
@@ -502,6 +808,97 @@ IsTagged( THIS )
 	OUTPUT:
 	    RETVAL
 
+I32
+IsTicketCache( THIS )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi	*c;
+	
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    RETVAL = c->IsTicketCache();
+	OUTPUT:
+	    RETVAL
+
+SV *
+_Iterate( THIS, cmd, ... )
+	SV *	THIS
+	SV *	cmd
+
+	INIT:
+	    PerlClientApi *	c;
+	    P4Iterator *	it;
+	    I32			va_start = 2;
+	    I32			i;
+	    char **		cmdargs = NULL;
+	    HV *		iter;
+	    MAGIC *		mg;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if ( !c->IsConnected() )
+	    {
+		warn("P4::Iterate() - Not connected. Call P4::Connect() first" );
+		XSRETURN_UNDEF;
+	    }
+
+	    /* P4::Iterate() has already stringified the arguments */
+	    if( items > va_start )
+	    {
+		New( 0, cmdargs, items - va_start, char * );
+		for( i = va_start; i < items; i++ )
+		    cmdargs[ i - va_start ] = SvPV_nolen( ST( i ) );
+	    }
+
+	    it = c->Iterate( SvPV_nolen( cmd ), items - va_start, cmdargs );
+	    if( cmdargs ) Safefree( cmdargs );
+	    if( !it ) XSRETURN_UNDEF;
+
+	    /*
+	     * The iterator holds a reference to its P4 object, so the P4
+	     * object outlives it, and starts with an empty page.
+	     */
+	    iter = newHV();
+	    mg = sv_magicext( (SV *)iter, 0, PERL_MAGIC_ext, &p4IteratorVtbl,
+			      (const char *) it, 0 );
+#ifdef USE_ITHREADS
+	    mg->mg_flags |= MGf_DUP;
+#endif
+	    hv_store( iter, "p4", 2, newSVsv( THIS ), 0 );
+	    hv_store( iter, "page", 4, newRV_noinc( (SV *) newAV() ), 0 );
+
+	    RETVAL = newRV_noinc( (SV *)iter );
+	    sv_bless( RETVAL, gv_stashpv( "P4::Iterator", TRUE ) );
+
+	OUTPUT:
+	    RETVAL
+
+SV *
+_Login( THIS )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if ( !c->IsConnected() )
+	    {
+		warn("P4::Login() - Not connected. Call P4::Connect() first" );
+		XSRETURN_UNDEF;
+	    }
+
+	    RETVAL = c->Login();
+
+	OUTPUT:
+	    RETVAL
+
 SV *
 MergeErrors( THIS, ... )
 	SV *	THIS
@@ -530,12 +927,99 @@ MergeErrors( THIS, ... )
 	OUTPUT:
 	    RETVAL
 	    
-void
-ParseForms( THIS )
+SV *
+MergeOutput( THIS, ... )
 	SV *	THIS
-
 	INIT:
-	    PerlClientApi	*c;
+	    PerlClientApi *	c;
+
+	    I32			va_start = 1;
+	    int			merge = -1;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if( items > va_start )
+	    {
+		if( !SvIOK( ST( va_start ) ) )
+		{
+		    warn( "Argument to MergeOutput() must be an integer" );
+		    XSRETURN_UNDEF;
+		}
+		merge = SvIV( ST( va_start ) );
+	    }
+	    RETVAL = c->MergeOutput( merge );
+
+	OUTPUT:
+	    RETVAL
+
+SV *
+MessageCount( THIS, ... )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+	    I32			va_start = 1;
+	    int			generic = -1;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    if( items > va_start && SvOK( ST( va_start ) ) )
+		generic = SvIV( ST( va_start ) );
+	    RETVAL = newSViv( c->GetMessageCount( generic ) );
+
+	OUTPUT:
+	    RETVAL
+
+void
+_Messages( THIS, generic, code, text )
+	SV *	THIS
+	int	generic
+	int	code
+	int	text
+
+	INIT:
+	    PerlClientApi *	c;
+	    AV *		a;
+	    SV **		s;
+	    int			i;
+
+	PPCODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    a = c->GetMessages( generic, code, text );
+	    sv_2mortal( (SV *) a );
+	    for( i = 0; i <= av_len( a ); i++ )
+	    {
+		s = av_fetch( a, i, 0 );
+		if( !s ) continue;
+		XPUSHs( *s );
+	    }
+
+SV *
+OpenIndex( THIS, file )
+	SV *	THIS
+	SV *	file
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    RETVAL = c->OpenIndex( SvPV_nolen( file ) );
+
+	OUTPUT:
+	    RETVAL
+
+void
+ParseForms( THIS )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi	*c;
 	
 	CODE:
 	    c = ExtractClient( THIS );
@@ -560,6 +1044,176 @@ ParseSpec( THIS, type, buf )
 	OUTPUT:
 	    RETVAL
 
+void
+ParseSpecs( THIS, type, forms, ... )
+	SV *	THIS
+	SV *	type
+	SV *	forms
+
+	INIT:
+	    PerlClientApi *	c;
+	    I32			va_start = 3;
+	    int			threads = 4;
+	    AV *		a;
+	    SV **		s;
+	    int			i;
+
+	PPCODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if( !SvROK( forms ) || SvTYPE( SvRV( forms ) ) != SVt_PVAV )
+	    {
+		warn( "Argument to ParseSpecs must be an array ref" );
+		XSRETURN_UNDEF;
+	    }
+
+	    if( items > va_start && SvOK( ST( va_start ) ) )
+		threads = SvIV( ST( va_start ) );
+
+	    a = c->ParseSpecs( SvPV_nolen( type ), (AV *) SvRV( forms ), 
+			       threads );
+	    sv_2mortal( (SV *) a );
+	    for( i = 0; i <= av_len( a ); i++ )
+	    {
+		s = av_fetch( a, i, 0 );
+		XPUSHs( s ? *s : &PL_sv_undef );
+	    }
+
+SV *
+ProgressStats( THIS )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    RETVAL = newRV_noinc( (SV *) c->GetProgressStats() );
+	OUTPUT:
+	    RETVAL
+
+void
+ReplicaStats( THIS )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+	    AV *		a;
+	    SV **		s;
+	    int			i;
+
+	PPCODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    a = c->ReplicaStats();
+	    sv_2mortal( (SV *) a );
+	    for( i = 0; i <= av_len( a ); i++ )
+	    {
+		s = av_fetch( a, i, 0 );
+		if( !s ) continue;
+		XPUSHs( *s );
+	    }
+
+
+void
+SaveSpecs( THIS, type, specs, ... )
+	SV *	THIS
+	SV *	type
+	SV *	specs
+
+	INIT:
+	    PerlClientApi *	c;
+	    I32			va_start = 3;
+	    int			connections = 4;
+	    AV *		a;
+	    SV **		s;
+	    int			i;
+
+	PPCODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if ( !c->IsConnected() )
+	    {
+		warn("P4::SaveSpecs() - Not connected. Call P4::Connect() first" );
+		XSRETURN_UNDEF;
+	    }
+
+	    if( !SvROK( specs ) || SvTYPE( SvRV( specs ) ) != SVt_PVAV )
+	    {
+		warn( "Argument to SaveSpecs must be an array ref" );
+		XSRETURN_UNDEF;
+	    }
+
+	    if( items > va_start && SvOK( ST( va_start ) ) )
+		connections = SvIV( ST( va_start ) );
+
+	    a = c->SaveSpecs( SvPV_nolen( type ), (AV *) SvRV( specs ), 
+			      connections );
+	    sv_2mortal( (SV *) a );
+	    for( i = 0; i <= av_len( a ); i++ )
+	    {
+		s = av_fetch( a, i, 0 );
+		if( !s ) continue;
+		XPUSHs( *s );
+	    }
+
+SV *
+_ScanWorkspace( THIS, root, threads, since )
+	SV *	THIS
+	SV *	root
+	int	threads
+	double	since
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if ( !c->IsConnected() )
+	    {
+		warn("P4::ScanWorkspace() - Not connected. Call P4::Connect() first" );
+		XSRETURN_UNDEF;
+	    }
+
+	    RETVAL = c->ScanWorkspace( SvOK( root ) ? SvPV_nolen( root ) : 0,
+				       threads, since );
+
+	OUTPUT:
+	    RETVAL
+
+SV *
+SetAggregate( THIS, ... )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+	    I32			va_start = 1;
+	    HV *		spec = 0;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    // No argument (or undef) clears the aggregate
+	    if( items > va_start && SvOK( ST( va_start ) ) )
+	    {
+		if( !SvROK( ST( va_start ) ) || 
+		    SvTYPE( SvRV( ST( va_start ) ) ) != SVt_PVHV )
+		{
+		    warn( "Argument to SetAggregate must be a hash reference" );
+		    XSRETURN_UNDEF;
+		}
+		spec = (HV *) SvRV( ST( va_start ) );
+	    }
+
+	    RETVAL = c->SetAggregate( spec );
+	OUTPUT:
+	    RETVAL
 
 void
 SetApiLevel( THIS,  level )
@@ -582,6 +1236,96 @@ SetApiLevel( THIS,  level )
 	    c->SetApiLevel( SvIV( level ) );
 
 
+void
+SetAutoReconnect( THIS, attempts, ... )
+	SV *	THIS
+	int	attempts
+
+	INIT:
+	    PerlClientApi	*c;
+	    I32			va_start = 2;
+	    int			maxWait = 0;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    // Optional maximum pause between attempts, in seconds
+	    if( items > va_start )
+		maxWait = (int)( SvNV( ST( va_start ) ) * 1000 );
+
+	    c->SetAutoReconnect( attempts, maxWait );
+
+void
+SetAutoSplit( THIS, connections )
+	SV *	THIS
+	int	connections
+
+	INIT:
+	    PerlClientApi	*c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    c->SetAutoSplit( connections );
+
+void
+SetBatching( THIS, files, ... )
+	SV *	THIS
+	int	files
+
+	INIT:
+	    PerlClientApi	*c;
+	    I32			va_start = 2;
+	    int			bytes = 0;
+	    int			connections = 1;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    // Optional byte limit and number of connections
+	    if( items > va_start && SvOK( ST( va_start ) ) )
+		bytes = SvIV( ST( va_start ) );
+	    if( items > va_start + 1 )
+		connections = SvIV( ST( va_start + 1 ) );
+
+	    c->SetBatching( files, bytes, connections );
+
+
+void
+SetBudget( THIS, records, ... )
+	SV *	THIS
+	int	records
+
+	INIT:
+	    PerlClientApi	*c;
+	    I32			va_start = 2;
+	    double		bytes = 0;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    // Optional byte limit
+	    if( items > va_start && SvOK( ST( va_start ) ) )
+		bytes = SvNV( ST( va_start ) );
+
+	    c->SetBudget( records, bytes );
+
+void
+SetCancelOnSignal( THIS, enable )
+	SV *	THIS
+	int	enable
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    c->SetCancelOnSignal( enable );
+
 void
 SetCharset( THIS,  charset )
 	SV *	THIS
@@ -624,6 +1368,50 @@ _SetCwd( THIS, cwd )
 	    c->SetCwd( cwd );
 
 
+SV *
+SetFilter( THIS, ... )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+	    I32			va_start = 1;
+	    const char *	expr = 0;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    // No argument (or undef) clears the filter
+	    if( items > va_start && SvOK( ST( va_start ) ) )
+		expr = SvPV_nolen( ST( va_start ) );
+
+	    RETVAL = c->SetFilter( expr );
+	OUTPUT:
+	    RETVAL
+
+SV *
+SetFieldType( THIS, field, type, ... )
+	SV *	THIS
+	char *	field
+	char *	type
+
+	INIT:
+	    PerlClientApi *	c;
+	    I32			va_start = 3;
+	    const char *	cmd = 0;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    // Optional command the type applies to
+	    if( items > va_start && SvOK( ST( va_start ) ) )
+		cmd = SvPV_nolen( ST( va_start ) );
+
+	    RETVAL = c->SetFieldType( field, type, cmd );
+	OUTPUT:
+	    RETVAL
+
 void
 SetHost( THIS, hostname )
 	SV *	THIS
@@ -650,6 +1438,18 @@ SetInput( THIS, value )
 	    if( !c ) XSRETURN_UNDEF;
 	    c->SetInput( value );
 
+void
+SetKeepAlive( THIS, seconds )
+	SV *	THIS
+	int	seconds
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    c->SetKeepAlive( seconds );
+
 void
 SetMaxResults( THIS, value )
 	SV *	THIS
@@ -715,6 +1515,34 @@ SetProg( THIS,  name )
 	    if( !c ) XSRETURN_UNDEF;
 	    c->SetProg( name );
 
+void
+SetProgress( THIS, callback, ... )
+	SV *	THIS
+	SV *	callback
+
+	INIT:
+	    PerlClientApi *	c;
+	    I32			va_start = 2;
+	    double		interval = 1.0;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if( SvOK( callback ) && 
+		( !SvROK( callback ) || SvTYPE( SvRV( callback ) ) != SVt_PVCV ) )
+	    {
+		warn( "Argument to SetProgress() must be a code reference" );
+		XSRETURN_UNDEF;
+	    }
+
+	    // Optional minimum interval between calls, in seconds
+	    if( items > va_start )
+		interval = SvNV( ST( va_start ) );
+
+	    c->SetProgress( callback, interval );
+
+
 void
 SetProtocol( THIS, protocol, value )
 	SV *	THIS
@@ -729,6 +1557,65 @@ SetProtocol( THIS, protocol, value )
 	    if( !c ) XSRETURN_UNDEF;
 	    c->SetProtocol( protocol, value );
 
+void
+SetReplicas( THIS, ports, ... )
+	SV *	THIS
+	SV *	ports
+
+	INIT:
+	    PerlClientApi	*c;
+	    I32			va_start = 2;
+	    double		lag = -1;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if( !SvROK( ports ) || SvTYPE( SvRV( ports ) ) != SVt_PVAV )
+	    {
+		warn( "P4::SetReplicas() - Ports must be an array reference" );
+		XSRETURN_UNDEF;
+	    }
+
+	    // Optional lag window, in seconds
+	    if( items > va_start )
+		lag = SvNV( ST( va_start ) );
+
+	    c->SetReplicas( (AV *) SvRV( ports ), lag );
+
+void
+SetTicketCache( THIS, enable, ... )
+	SV *	THIS
+	int	enable
+
+	INIT:
+	    PerlClientApi	*c;
+	    I32			va_start = 2;
+	    char *		file = 0;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    // Optional file to keep the tickets in too
+	    if( items > va_start && SvOK( ST( va_start ) ) )
+		file = SvPV_nolen( ST( va_start ) );
+
+	    c->SetTicketCache( enable, file );
+
+void
+SetTimeLimit( THIS, seconds )
+	SV *	THIS
+	double	seconds
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    c->SetTimeLimit( seconds );
+
 void
 SetUser( THIS, username )
 	SV *	THIS
@@ -742,6 +1629,20 @@ SetUser( THIS, username )
 	    if( !c ) XSRETURN_UNDEF;
 	    c->SetUser( username );
 
+I32
+SplitCount( THIS )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    RETVAL = c->GetSplitCount();
+	OUTPUT:
+	    RETVAL
+
 void
 Tagged( THIS )
 	SV *	THIS
@@ -755,6 +1656,80 @@ Tagged( THIS )
 	    c->Tagged();
 
 
+SV *
+TypedValues( THIS, ... )
+	SV *	THIS
+	INIT:
+	    PerlClientApi *	c;
+
+	    I32			va_start = 1;
+	    int			typed = -1;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if( items > va_start )
+	    {
+		if( !SvIOK( ST( va_start ) ) )
+		{
+		    warn( "Argument to TypedValues() must be an integer" );
+		    XSRETURN_UNDEF;
+		}
+		typed = SvIV( ST( va_start ) );
+	    }
+	    RETVAL = c->TypedValues( typed );
+
+	OUTPUT:
+	    RETVAL
+
+SV *
+UpdateIndex( THIS )
+	SV *	THIS
+
+	INIT:
+	    PerlClientApi *	c;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+	    if ( !c->IsConnected() )
+	    {
+		warn("P4::UpdateIndex() - Not connected. Call P4::Connect() first" );
+		XSRETURN_UNDEF;
+	    }
+	    RETVAL = c->UpdateIndex();
+
+	OUTPUT:
+	    RETVAL
+
+SV *
+Utf8Values( THIS, ... )
+	SV *	THIS
+	INIT:
+	    PerlClientApi *	c;
+
+	    I32			va_start = 1;
+	    int			utf8 = -1;
+
+	CODE:
+	    c = ExtractClient( THIS );
+	    if( !c ) XSRETURN_UNDEF;
+
+	    if( items > va_start )
+	    {
+		if( !SvIOK( ST( va_start ) ) )
+		{
+		    warn( "Argument to Utf8Values() must be an integer" );
+		    XSRETURN_UNDEF;
+		}
+		utf8 = SvIV( ST( va_start ) );
+	    }
+	    RETVAL = c->Utf8Values( utf8 );
+
+	OUTPUT:
+	    RETVAL
+
 SV *
 WarningCount( THIS )
 	SV *	THIS
@@ -790,3 +1765,69 @@ Warnings( THIS )
 		if( !s ) continue;
 		XPUSHs( *s );
 	    }
+
+
+MODULE = P4	PACKAGE = P4::Iterator
+
+void
+DESTROY( THIS )
+	SV	*THIS
+
+	INIT:
+	    MAGIC	*mg;
+
+	CODE:
+	    mg = IteratorMagic( THIS );
+	    if( !mg ) XSRETURN_UNDEF;
+	    delete (P4Iterator *) mg->mg_ptr;
+	    mg->mg_ptr = 0;
+
+SV *
+_NextPage( THIS )
+	SV *	THIS
+
+	INIT:
+	    P4Iterator *	it;
+	    PerlClientApi *	c;
+	    SV **		p4;
+
+	CODE:
+	    it = ExtractIterator( THIS );
+	    if( !it ) XSRETURN_UNDEF;
+	    p4 = hv_fetch( (HV *) SvRV( THIS ), "p4", 2, 0 );
+	    c = p4 ? ExtractClient( *p4 ) : 0;
+	    if( !c ) XSRETURN_UNDEF;
+	    RETVAL = c->NextPage( it );
+
+	OUTPUT:
+	    RETVAL
+
+SV *
+Pages( THIS )
+	SV *	THIS
+
+	INIT:
+	    P4Iterator *	it;
+
+	CODE:
+	    it = ExtractIterator( THIS );
+	    if( !it ) XSRETURN_UNDEF;
+	    RETVAL = newSViv( it->Pages() );
+
+	OUTPUT:
+	    RETVAL
+
+SV *
+PageSize( THIS )
+	SV *	THIS
+
+	INIT:
+	    P4Iterator *	it;
+
+	CODE:
+	    it = ExtractIterator( THIS );
+	    if( !it ) XSRETURN_UNDEF;
+	    RETVAL = newSViv( it->PageSize() );
+
+	OUTPUT:
+	    RETVAL
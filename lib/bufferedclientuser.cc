@@ -0,0 +1,243 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: bufferedclientuser.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: A ClientUser that records server output for replaying
+ * 		  later. Must not use Perl in any way.
+ *
+ ******************************************************************************/
+
+#include <clientapi.h>
+#include "bufferedclientuser.h"
+
+BufferedClientUser::BufferedClientUser()
+{
+    head = tail = 0;
+    errors = 0;
+    stats = 0;
+    bytes = 0;
+    hasInput = 0;
+}
+
+BufferedClientUser::~BufferedClientUser()
+{
+    Clear();
+}
+
+BufferedClientUser::Event *
+BufferedClientUser::Append( EventType t )
+{
+    Event *ev = new Event;
+    ev->type = t;
+    ev->level = 0;
+    ev->dict = 0;
+    ev->error = 0;
+    ev->next = 0;
+
+    if( tail )
+	tail->next = ev;
+    else
+	head = ev;
+    tail = ev;
+    return ev;
+}
+
+void
+BufferedClientUser::HandleError( Error *e )
+{
+    Event *ev = Append( B_ERROR );
+    ev->error = new Error;
+    *ev->error = *e;
+
+    if( tagVar.Length() && ev->error->GetDict() )
+	ev->error->GetDict()->SetVar( tagVar.Text(), tagVal );
+
+    if( !e->IsInfo() && !e->IsWarning() )
+	errors++;
+}
+
+void
+BufferedClientUser::OutputText( const_char *data, int length )
+{
+    Append( B_TEXT )->data.Set( data, length );
+    bytes += length;
+}
+
+void
+BufferedClientUser::OutputInfo( char level, const_char *data )
+{
+    Event *ev = Append( B_INFO );
+    ev->level = level;
+    ev->data.Set( data );
+}
+
+void
+BufferedClientUser::OutputStat( StrDict *values )
+{
+    StrRef	var, val;
+    for( int i = 0; values->GetVar( i, var, val ); i++ )
+	bytes += var.Length() + val.Length();
+
+    Event *ev = Append( B_STAT );
+    ev->dict = new StrBufDict( *values );
+    if( tagVar.Length() )
+	ev->dict->SetVar( tagVar.Text(), tagVal );
+    stats++;
+}
+
+void
+BufferedClientUser::OutputBinary( const_char *data, int length )
+{
+    Append( B_BINARY )->data.Set( data, length );
+    bytes += length;
+}
+
+void
+BufferedClientUser::InputData( StrBuf *strbuf, Error *e )
+{
+    if( !hasInput )
+    {
+	e->Set( E_FAILED, "No input supplied for background command" );
+	return;
+    }
+    strbuf->Set( input );
+}
+
+void
+BufferedClientUser::Prompt( const StrPtr &msg, StrBuf &rsp, int noEcho, 
+			    Error *e )
+{
+    InputData( &rsp, e );
+}
+
+void
+BufferedClientUser::Replay( ClientUser *to )
+{
+    for( Event *ev = head; ev; ev = ev->next )
+    {
+	switch( ev->type )
+	{
+	case B_ERROR:
+	    to->HandleError( ev->error );
+	    break;
+	case B_TEXT:
+	    to->OutputText( ev->data.Text(), ev->data.Length() );
+	    break;
+	case B_INFO:
+	    to->OutputInfo( ev->level, ev->data.Text() );
+	    break;
+	case B_STAT:
+	    to->OutputStat( ev->dict );
+	    break;
+	case B_BINARY:
+	    to->OutputBinary( ev->data.Text(), ev->data.Length() );
+	    break;
+	}
+    }
+    Clear();
+}
+
+void
+BufferedClientUser::Messages( StrBuf *buf )
+{
+    buf->Clear();
+    for( Event *ev = head; ev; ev = ev->next )
+    {
+	StrBuf	m;
+
+	switch( ev->type )
+	{
+	case B_ERROR:
+	    ev->error->Fmt( &m, EF_PLAIN );
+	    break;
+	case B_TEXT:
+	case B_INFO:
+	    m.Set( ev->data );
+	    break;
+	default:
+	    continue;
+	}
+
+	if( buf->Length() )
+	    buf->Append( "\n" );
+	buf->Append( &m );
+    }
+}
+
+void
+BufferedClientUser::ReplayMessages( ClientUser *to )
+{
+    for( Event *ev = head; ev; ev = ev->next )
+    {
+	switch( ev->type )
+	{
+	case B_ERROR:
+	    to->HandleError( ev->error );
+	    break;
+	case B_TEXT:
+	    to->OutputText( ev->data.Text(), ev->data.Length() );
+	    break;
+	case B_INFO:
+	    to->OutputInfo( ev->level, ev->data.Text() );
+	    break;
+	case B_BINARY:
+	    to->OutputBinary( ev->data.Text(), ev->data.Length() );
+	    break;
+	default:
+	    break;
+	}
+    }
+}
+
+void
+BufferedClientUser::EachStat( StatFunc f, void *arg )
+{
+    for( Event *ev = head; ev; ev = ev->next )
+	if( ev->type == B_STAT )
+	    f( ev->dict, arg );
+}
+
+void
+BufferedClientUser::Clear()
+{
+    while( head )
+    {
+	Event *ev = head;
+	head = ev->next;
+	delete ev->dict;
+	delete ev->error;
+	delete ev;
+    }
+    tail = 0;
+    errors = 0;
+    stats = 0;
+    bytes = 0;
+}
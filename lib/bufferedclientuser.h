@@ -0,0 +1,107 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: bufferedclientuser.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: A ClientUser that records everything the server sends
+ * 		  so that it can be replayed into another ClientUser later.
+ * 		  Used to run commands on threads that mustn't touch Perl:
+ * 		  the output is captured in C++ and handed to the
+ * 		  PerlClientUser once we're back on the interpreter's
+ * 		  thread.
+ *
+ ******************************************************************************/
+
+class BufferedClientUser : public ClientUser
+{
+    public:
+		BufferedClientUser();
+		~BufferedClientUser();
+
+	void	HandleError( Error *e );
+	void	OutputText( const_char *data, int length );
+	void	OutputInfo( char level, const_char *data );
+	void	OutputStat( StrDict *values );
+	void	OutputBinary( const_char *data, int length );
+	void	InputData( StrBuf *strbuf, Error *e );
+	void	Prompt( const StrPtr &msg, StrBuf &rsp, int noEcho, Error *e );
+
+	// Input for commands that need it. Used for every prompt.
+	void	SetInput( const StrPtr &i )	{ input = i; hasInput = 1; }
+
+	// Pass everything we've captured on, in order, and forget it.
+	void	Replay( ClientUser *to );
+	void	Clear();
+
+	// Pass on just the errors and text, for callers that deal with
+	// the tagged output themselves using EachStat().
+	void	ReplayMessages( ClientUser *to );
+
+	// Add var=val to every record and error captured from now on
+	void	SetTag( const char *var, const StrPtr &val )
+		{ tagVar.Set( var ); tagVal.Set( val ); }
+
+	int	ErrorCount()			{ return errors;	}
+
+	// The text of the messages and text output captured, one per line
+	void	Messages( StrBuf *buf );
+
+	// Walking the captured tagged output, and its rough size in bytes
+	typedef void (*StatFunc)( StrDict *record, void *arg );
+	void	EachStat( StatFunc f, void *arg );
+	int	StatCount()			{ return stats;		}
+	double	Bytes()				{ return bytes;		}
+
+    private:
+	enum EventType { B_ERROR, B_TEXT, B_INFO, B_STAT, B_BINARY };
+
+	struct Event
+	{
+	    EventType	type;
+	    char	level;
+	    StrBuf	data;
+	    StrBufDict *dict;
+	    Error *	error;
+	    Event *	next;
+	};
+
+	Event *	Append( EventType t );
+
+    private:
+	Event *	head;
+	Event *	tail;
+	int	errors;
+	int	stats;
+	double	bytes;
+	StrBuf	input;
+	int	hasInput;
+	StrBuf	tagVar;
+	StrBuf	tagVal;
+};
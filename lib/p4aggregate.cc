@@ -0,0 +1,471 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4aggregate.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Aggregation of tagged output in C++.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <clientapi.h>
+#include "p4aggregate.h"
+
+P4Aggregate::P4Aggregate()
+{
+    keys = 0;
+    nKeys = 0;
+    columns = 0;
+    nColumns = 0;
+    orderColumn = -1;
+    ascending = 0;
+    top = 0;
+    groups = 0;
+    nGroups = 0;
+    maxGroups = 0;
+    table = 0;
+    tableSize = 0;
+}
+
+P4Aggregate::~P4Aggregate()
+{
+    Reset();
+    delete [] groups;
+    delete [] table;
+    delete [] keys;
+    delete [] columns;
+}
+
+void
+P4Aggregate::Reset()
+{
+    for( int i = 0; i < nGroups; i++ )
+	FreeGroup( groups[ i ] );
+    nGroups = 0;
+    if( table )
+	memset( table, 0, tableSize * sizeof( Group * ) );
+}
+
+void
+P4Aggregate::FreeGroup( Group *g )
+{
+    delete [] g->values;
+    delete [] g->acc;
+    delete [] g->seen;
+    delete g->record;
+    delete g;
+}
+
+void
+P4Aggregate::AddGroup( const char *field, int depth )
+{
+    Key	*k = new Key[ nKeys + 1 ];
+    for( int i = 0; i < nKeys; i++ )
+    {
+	k[ i ].field = keys[ i ].field;
+	k[ i ].name = keys[ i ].name;
+	k[ i ].depth = keys[ i ].depth;
+    }
+    k[ nKeys ].field = field;
+    k[ nKeys ].name = field;
+    k[ nKeys ].depth = depth;
+    delete [] keys;
+    keys = k;
+    nKeys++;
+}
+
+void
+P4Aggregate::AddColumn( Function f, const char *field )
+{
+    static const char *names[] = { "sum", "min", "max" };
+
+    Column *c = new Column[ nColumns + 1 ];
+    for( int i = 0; i < nColumns; i++ )
+    {
+	c[ i ].func = columns[ i ].func;
+	c[ i ].field = columns[ i ].field;
+	c[ i ].name = columns[ i ].name;
+    }
+    c[ nColumns ].func = f;
+    c[ nColumns ].field = field;
+    c[ nColumns ].name << names[ f ] << "(" << field << ")";
+    delete [] columns;
+    columns = c;
+    nColumns++;
+}
+
+//
+// Choose what to sort by: "count", the name of one of the columns (e.g.
+// "sum(fileSize)"), or in record mode, the name of a field. Call this
+// after adding the groups and columns. Returns 0 if the column is unknown.
+//
+int
+P4Aggregate::SetOrder( const char *column, int asc )
+{
+    ascending = asc;
+    orderColumn = -1;
+    orderField.Clear();
+
+    if( !nKeys && !nColumns )
+    {
+	orderField = column;
+	return 1;
+    }
+
+    if( !strcmp( column, "count" ) )
+    {
+	orderColumn = nColumns;
+	return 1;
+    }
+
+    for( int i = 0; i < nColumns; i++ )
+    {
+	if( !strcmp( columns[ i ].name.Text(), column ) )
+	{
+	    orderColumn = i;
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+int
+P4Aggregate::IsRecordMode()
+{
+    return !nKeys && !nColumns && top > 0 && orderField.Length();
+}
+
+void
+P4Aggregate::Add( StrDict *record )
+{
+    if( IsRecordMode() )
+    {
+	AddRecord( record );
+	return;
+    }
+
+    MakeKey( record, scratch );
+
+    Group *g = Lookup( scratch );
+    if( !g ) g = NewGroup( scratch );
+
+    g->count++;
+
+    for( int i = 0; i < nColumns; i++ )
+    {
+	double	d;
+	if( !Numeric( record->GetVar( columns[ i ].field ), d ) )
+	    continue;
+
+	double	&a = g->acc[ i ];
+	if( !g->seen[ i ]++ )
+	    a = d;
+	else if( columns[ i ].func == A_SUM )
+	    a += d;
+	else if( columns[ i ].func == A_MIN ? d < a : d > a )
+	    a = d;
+    }
+}
+
+//
+// The key is the group values laid end to end, each followed by a null.
+// A missing field groups with the empty string.
+//
+void
+P4Aggregate::MakeKey( StrDict *record, StrBuf &key )
+{
+    key.Clear();
+    for( int i = 0; i < nKeys; i++ )
+    {
+	StrPtr *v = record->GetVar( keys[ i ].field );
+	if( v )
+	{
+	    const char	*s = v->Text();
+	    int		len = v->Length();
+
+	    if( keys[ i ].depth > 0 )
+	    {
+		// Keep the first 'depth' levels of a depot path
+		const char	*p = s;
+		int		levels = 0;
+
+		if( p[ 0 ] == '/' && p[ 1 ] == '/' )
+		    p += 2;
+
+		for( ; *p; p++ )
+		{
+		    if( *p == '/' && ++levels == keys[ i ].depth )
+		    {
+			len = p - s;
+			break;
+		    }
+		}
+	    }
+	    key.Append( s, len );
+	}
+	key.Extend( '\0' );
+    }
+}
+
+unsigned
+P4Aggregate::Hash( const StrPtr &s )
+{
+    // FNV-1a
+    unsigned		h = 2166136261U;
+    const unsigned char	*p = (const unsigned char *)s.Text();
+
+    for( int i = 0; i < s.Length(); i++ )
+	h = ( h ^ p[ i ] ) * 16777619U;
+    return h;
+}
+
+P4Aggregate::Group *
+P4Aggregate::Lookup( const StrPtr &key )
+{
+    if( !tableSize ) return 0;
+
+    unsigned i = Hash( key ) & ( tableSize - 1 );
+    for( ; table[ i ]; i = ( i + 1 ) & ( tableSize - 1 ) )
+    {
+	StrBuf	&k = table[ i ]->key;
+	if( k.Length() == key.Length() &&
+	    !memcmp( k.Text(), key.Text(), key.Length() ) )
+	    return table[ i ];
+    }
+    return 0;
+}
+
+void
+P4Aggregate::Grow()
+{
+    int size = tableSize ? tableSize * 2 : 256;
+
+    delete [] table;
+    table = new Group *[ size ];
+    memset( table, 0, size * sizeof( Group * ) );
+    tableSize = size;
+
+    for( int i = 0; i < nGroups; i++ )
+    {
+	unsigned h = Hash( groups[ i ]->key ) & ( size - 1 );
+	while( table[ h ] )
+	    h = ( h + 1 ) & ( size - 1 );
+	table[ h ] = groups[ i ];
+    }
+
+    Group **g = new Group *[ size ];
+    if( nGroups ) memcpy( g, groups, nGroups * sizeof( Group * ) );
+    delete [] groups;
+    groups = g;
+    maxGroups = size;
+}
+
+P4Aggregate::Group *
+P4Aggregate::NewGroup( const StrPtr &key )
+{
+    // Keep the table no more than half full
+    if( ( nGroups + 1 ) * 2 > tableSize )
+	Grow();
+
+    Group *g = new Group;
+    g->key.Set( key.Text(), key.Length() );
+    g->values = nKeys ? new StrRef[ nKeys ] : 0;
+    g->acc = nColumns ? new double[ nColumns ] : 0;
+    g->seen = nColumns ? new int[ nColumns ] : 0;
+    g->record = 0;
+    g->count = 0;
+    g->order = 0;
+
+    const char *p = g->key.Text();
+    for( int i = 0; i < nKeys; i++ )
+    {
+	int len = strlen( p );
+	g->values[ i ].Set( (char *)p, len );
+	p += len + 1;
+    }
+    for( int i = 0; i < nColumns; i++ )
+    {
+	g->acc[ i ] = 0;
+	g->seen[ i ] = 0;
+    }
+
+    unsigned h = Hash( key ) & ( tableSize - 1 );
+    while( table[ h ] )
+	h = ( h + 1 ) & ( tableSize - 1 );
+    table[ h ] = g;
+    groups[ nGroups++ ] = g;
+    return g;
+}
+
+//
+// Record mode: keep the best 'top' records in a heap with the worst of
+// them at the root, so each new record costs at most log(top) compares.
+// Sort keys are arranged so that smaller is always better.
+//
+void
+P4Aggregate::AddRecord( StrDict *record )
+{
+    double	d;
+    if( !Numeric( record->GetVar( orderField ), d ) )
+	return;
+    if( !ascending ) d = -d;
+
+    if( !maxGroups )
+    {
+	groups = new Group *[ top ];
+	maxGroups = top;
+    }
+
+    int	i;
+    if( nGroups < top )
+    {
+	// Sift up
+	i = nGroups++;
+	while( i > 0 && groups[ ( i - 1 ) / 2 ]->order < d )
+	{
+	    groups[ i ] = groups[ ( i - 1 ) / 2 ];
+	    i = ( i - 1 ) / 2;
+	}
+	groups[ i ] = new Group;
+	groups[ i ]->values = 0;
+	groups[ i ]->acc = 0;
+	groups[ i ]->seen = 0;
+	groups[ i ]->count = 1;
+    }
+    else
+    {
+	if( d >= groups[ 0 ]->order )
+	    return;
+
+	// Replace the root and sift down
+	Group *g = groups[ 0 ];
+	delete g->record;
+	i = 0;
+	for( ;; )
+	{
+	    int c = i * 2 + 1;
+	    if( c >= nGroups ) break;
+	    if( c + 1 < nGroups && groups[ c + 1 ]->order > groups[ c ]->order )
+		c++;
+	    if( groups[ c ]->order <= d ) break;
+	    groups[ i ] = groups[ c ];
+	    i = c;
+	}
+	groups[ i ] = g;
+    }
+
+    groups[ i ]->order = d;
+    groups[ i ]->record = new StrBufDict( *record );
+}
+
+int
+P4Aggregate::Compare( const void *a, const void *b )
+{
+    double x = ( *(Group **)a )->order;
+    double y = ( *(Group **)b )->order;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+void
+P4Aggregate::Finish()
+{
+    if( !IsRecordMode() && orderColumn >= 0 )
+    {
+	// Groups with no value for the order column sort last
+	for( int i = 0; i < nGroups; i++ )
+	{
+	    Group *g = groups[ i ];
+	    double d;
+
+	    if( orderColumn == nColumns )
+		d = g->count;
+	    else if( g->seen[ orderColumn ] )
+		d = g->acc[ orderColumn ];
+	    else
+	    {
+		g->order = 1e308;
+		continue;
+	    }
+	    g->order = ascending ? d : -d;
+	}
+    }
+
+    // Records and ordered groups are sorted; otherwise groups are
+    // reported in the order they were first seen.
+    if( IsRecordMode() || orderColumn >= 0 )
+	qsort( groups, nGroups, sizeof( Group * ), Compare );
+
+    if( top > 0 && nGroups > top )
+    {
+	for( int i = top; i < nGroups; i++ )
+	    FreeGroup( groups[ i ] );
+	nGroups = top;
+    }
+}
+
+const StrPtr &
+P4Aggregate::KeyValue( int g, int k )
+{
+    return groups[ g ]->values[ k ];
+}
+
+double
+P4Aggregate::Count( int g )
+{
+    return groups[ g ]->count;
+}
+
+double
+P4Aggregate::Value( int g, int c )
+{
+    return groups[ g ]->acc[ c ];
+}
+
+int
+P4Aggregate::HasValue( int g, int c )
+{
+    return groups[ g ]->seen[ c ];
+}
+
+StrDict *
+P4Aggregate::Record( int g )
+{
+    return groups[ g ]->record;
+}
+
+int
+P4Aggregate::Numeric( StrPtr *v, double &d )
+{
+    if( !v || !v->Length() ) return 0;
+
+    char *end;
+    d = strtod( v->Text(), &end );
+    return *end == '\0';
+}
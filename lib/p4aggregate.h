@@ -0,0 +1,140 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4aggregate.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Aggregation of tagged output in C++. Records are folded
+ * 		  into groups (keyed on one or more fields, optionally
+ * 		  truncating depot paths to a number of levels) as they
+ * 		  arrive, keeping a count and sums, minima and maxima of
+ * 		  numeric fields. Only the final table goes back to Perl.
+ *
+ * 		  With no group keys, but a top-K limit and an order
+ * 		  field, it instead keeps the K records with the largest
+ * 		  values of that field (e.g. the 100 biggest files).
+ *
+ ******************************************************************************/
+
+class P4Aggregate
+{
+    public:
+	enum Function { A_SUM, A_MIN, A_MAX };
+
+		P4Aggregate();
+		~P4Aggregate();
+
+	// Configuration. Depth is the number of depot path levels to keep
+	// from the field's value, or 0 for the whole value.
+	void	AddGroup( const char *field, int depth = 0 );
+	void	AddColumn( Function f, const char *field );
+	int	SetOrder( const char *column, int ascending );
+	void	SetTop( int k )			{ top = k;		}
+
+	// Feed it records
+	void	Add( StrDict *record );
+
+	// Discard the groups, keeping the configuration
+	void	Reset();
+
+	// Sort and trim the groups ready for reading
+	void	Finish();
+
+	// Reading the groups back
+	int		IsRecordMode();
+	int		GroupCount()		{ return nGroups;	}
+	int		KeyCount()		{ return nKeys;		}
+	int		ColumnCount()		{ return nColumns;	}
+	const StrPtr &	KeyName( int k )	{ return keys[ k ].name; }
+	const StrPtr &	ColumnName( int c )	{ return columns[ c ].name; }
+	const StrPtr &	KeyValue( int g, int k );
+	double		Count( int g );
+	double		Value( int g, int c );
+	int		HasValue( int g, int c );
+
+	// In record mode, the records that made the cut
+	StrDict *	Record( int g );
+
+    private:
+	struct Key
+	{
+	    StrBuf	field;
+	    StrBuf	name;
+	    int		depth;
+	};
+
+	struct Column
+	{
+	    Function	func;
+	    StrBuf	field;
+	    StrBuf	name;
+	};
+
+	struct Group
+	{
+	    StrBuf	key;		// Key values, each null terminated
+	    StrRef *	values;		// Pointers into key
+	    double *	acc;
+	    int *	seen;
+	    double	count;
+	    double	order;		// Sort key
+	    StrBufDict *record;		// Record mode only
+	};
+
+	Group *	Lookup( const StrPtr &key );
+	Group *	NewGroup( const StrPtr &key );
+	void	Grow();
+	void	FreeGroup( Group *g );
+	void	AddRecord( StrDict *record );
+	void	MakeKey( StrDict *record, StrBuf &key );
+
+	static unsigned	Hash( const StrPtr &s );
+	static int	Numeric( StrPtr *v, double &d );
+	static int	Compare( const void *a, const void *b );
+
+    private:
+	Key *		keys;
+	int		nKeys;
+	Column *	columns;
+	int		nColumns;
+
+	int		orderColumn;	// -1 for none
+	StrBuf		orderField;	// Record mode
+	int		ascending;
+	int		top;
+
+	Group **	groups;		// In insertion order, then sorted
+	int		nGroups;
+	int		maxGroups;
+
+	Group **	table;		// Open addressing hash table
+	int		tableSize;
+
+	StrBuf		scratch;
+};
@@ -0,0 +1,115 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4arena.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Simple bump allocator for short-lived scratch memory.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "p4arena.h"
+
+// Alignment of the pointers we hand out
+#define ARENA_ALIGN	( sizeof( double ) )
+
+P4Arena::P4Arena( int bs )
+{
+    blockSize = bs;
+    first = current = 0;
+}
+
+P4Arena::~P4Arena()
+{
+    while( first )
+    {
+	Block *n = first->next;
+	free( first );
+	first = n;
+    }
+}
+
+P4Arena::Block *
+P4Arena::NewBlock( int minSize )
+{
+    int		size = minSize > blockSize ? minSize : blockSize;
+    Block *	b = (Block *) malloc( sizeof( Block ) + size );
+
+    b->next = 0;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+char *
+P4Arena::Alloc( int size )
+{
+    size = ( size + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 );
+
+    if( !current )
+	first = current = NewBlock( size );
+
+    // Move on to the next block (reusing it if we have one) until we
+    // find one with room.
+    while( current->size - current->used < size )
+    {
+	if( !current->next || current->next->size < size )
+	{
+	    Block *b = NewBlock( size );
+	    b->next = current->next;
+	    current->next = b;
+	}
+	current = current->next;
+	current->used = 0;
+    }
+
+    char *p = current->Data() + current->used;
+    current->used += size;
+    return p;
+}
+
+char *
+P4Arena::Dup( const char *s, int len )
+{
+    char *p = Alloc( len + 1 );
+    memcpy( p, s, len );
+    p[ len ] = 0;
+    return p;
+}
+
+void
+P4Arena::Reset()
+{
+    current = first;
+    if( current )
+	current->used = 0;
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4arena.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Simple bump allocator for short-lived scratch memory.
+ * 		  Allocations are never freed individually; the whole arena
+ * 		  is reset in one go. Blocks are kept across resets so that
+ * 		  in the steady state no heap allocation is done at all.
+ *
+ ******************************************************************************/
+
+class P4Arena
+{
+    public:
+		P4Arena( int blockSize = 4096 );
+		~P4Arena();
+
+	char *	Alloc( int size );
+
+	// Copy a (not necessarily terminated) string into the arena,
+	// adding a terminating null.
+	char *	Dup( const char *s, int len );
+
+	void	Reset();
+
+    private:
+	struct Block
+	{
+	    Block *	next;
+	    int		size;
+	    int		used;
+	    char *	Data()	{ return (char *)( this + 1 ); }
+	};
+
+	Block *	NewBlock( int minSize );
+
+    private:
+	Block *	first;
+	Block *	current;
+	int	blockSize;
+};
@@ -0,0 +1,281 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4batch.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Splitting of long file argument lists into batches, and
+ * 		  running batches in parallel. Must not use Perl in any
+ * 		  way as the workers run on threads of their own.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include <clientapi.h>
+#include "p4perlsys.h"
+#include "p4breaker.h"
+#include "bufferedclientuser.h"
+#include "p4batch.h"
+
+//
+// Options that take a value, for the commands people usually run with
+// long lists of files. The same letter means different things to 
+// different commands: 'print -o file' takes one, 'integrate -o' doesn't.
+// Commands not listed get the options that usually take a value.
+//
+static const struct
+{
+    const char *cmd;
+    const char *options;
+} valueOptions[] = {
+    { "add",		"ct"		},
+    { "annotate",	""		},
+    { "changes",	"cemsu"		},
+    { "delete",		"c"		},
+    { "diff",		"dmt"		},
+    { "edit",		"ct"		},
+    { "filelog",	"cm"		},
+    { "files",		"m"		},
+    { "fixes",		"cjm"		},
+    { "fstat",		"AceFmORST"	},
+    { "have",		""		},
+    { "integrate",	"bcmPsS"	},
+    { "integrated",	"b"		},
+    { "labelsync",	"l"		},
+    { "lock",		"c"		},
+    { "move",		"ct"		},
+    { "opened",		"cCmu"		},
+    { "print",		"mo"		},
+    { "reopen",		"ct"		},
+    { "resolve",	"c"		},
+    { "revert",		"cC"		},
+    { "shelve",		"c"		},
+    { "sizes",		"bm"		},
+    { "sync",		"m"		},
+    { "tag",		"l"		},
+    { "unlock",		"c"		},
+    { "unshelve",	"bcsS"		},
+    { "verify",		"bm"		},
+    { 0,		"AbcCeFjmStT"	}
+};
+
+P4Batch::P4Batch( const char *cmd, int argc, char * const *argv, 
+		  int maxFiles, int maxBytes )
+{
+    int	nOpts = 0;
+    int	i;
+
+    batches = 0;
+    nBatches = 0;
+    this->cmd = cmd;
+    prog = 0;
+    maxResults = maxScanRows = 0;
+    next = 0;
+
+    while( nOpts < argc && argv[ nOpts ][ 0 ] == '-' )
+    {
+	if( !strcmp( argv[ nOpts ], "--" ) )
+	{
+	    nOpts++;
+	    break;
+	}
+	if( TakesValue( cmd, argv[ nOpts ] ) && nOpts + 1 < argc )
+	    nOpts++;
+	nOpts++;
+    }
+
+    if( nOpts == argc )
+	return;
+
+    // Work out where the batches start. There can't be more of them
+    // than there are files.
+    int	*starts = new int[ argc - nOpts + 1 ];
+    int	files = 0;
+    int	bytes = 0;
+
+    for( i = nOpts; i < argc; i++ )
+    {
+	int len = strlen( argv[ i ] ) + 1;
+
+	if( files && ( ( maxFiles > 0 && files >= maxFiles ) ||
+		       ( maxBytes > 0 && bytes + len > maxBytes ) ) )
+	{
+	    files = bytes = 0;
+	}
+
+	if( !files )
+	    starts[ nBatches++ ] = i;
+
+	files++;
+	bytes += len;
+    }
+    starts[ nBatches ] = argc;
+
+    batches = new Batch[ nBatches ];
+    for( int b = 0; b < nBatches; b++ )
+    {
+	Batch	&bt = batches[ b ];
+
+	bt.files = starts[ b + 1 ] - starts[ b ];
+	bt.argc = nOpts + bt.files;
+	bt.argv = new char *[ bt.argc ];
+	bt.bytes = 0;
+	bt.seconds = 0;
+	bt.connection = 0;
+	bt.output = 0;
+
+	for( i = 0; i < nOpts; i++ )
+	    bt.argv[ i ] = argv[ i ];
+
+	for( i = 0; i < bt.files; i++ )
+	{
+	    bt.argv[ nOpts + i ] = argv[ starts[ b ] + i ];
+	    bt.bytes += strlen( bt.argv[ nOpts + i ] ) + 1;
+	}
+    }
+
+    delete [] starts;
+}
+
+P4Batch::~P4Batch()
+{
+    for( int b = 0; b < nBatches; b++ )
+    {
+	delete [] batches[ b ].argv;
+	delete batches[ b ].output;
+    }
+    delete [] batches;
+}
+
+int
+P4Batch::TakesValue( const char *cmd, const char *arg )
+{
+    int	i;
+
+    if( !arg[ 1 ] || arg[ 2 ] )
+	return 0;
+
+    for( i = 0; valueOptions[ i ].cmd; i++ )
+	if( !strcmp( cmd, valueOptions[ i ].cmd ) )
+	    break;
+
+    return strchr( valueOptions[ i ].options, arg[ 1 ] ) != 0;
+}
+
+void
+P4Batch::RunParallel( ClientApi **clients, int n, const char *cmd, 
+		      const char *prog, int maxResults, int maxScanRows,
+		      KeepAlive *alive )
+{
+    this->cmd = cmd;
+    this->prog = prog;
+    this->maxResults = maxResults;
+    this->maxScanRows = maxScanRows;
+    next = 0;
+    breaker.Reset( alive );
+
+    for( int b = 0; b < nBatches; b++ )
+	batches[ b ].output = new BufferedClientUser;
+
+    if( n > nBatches )
+	n = nBatches;
+
+    //
+    // The first worker runs on this thread, so there's always at least
+    // one even if no more threads can be started.
+    //
+    Worker	*workers = new Worker[ n ];
+    int		i;
+
+    for( i = 0; i < n; i++ )
+    {
+	workers[ i ].batch = this;
+	workers[ i ].client = clients[ i ];
+	workers[ i ].index = i;
+	clients[ i ]->SetBreak( i ? breaker.ForWorker() 
+				  : breaker.ForCaller() );
+    }
+
+    for( i = 1; i < n; i++ )
+	workers[ i ].thread.Start( WorkerThread, &workers[ i ] );
+
+    RunBatches( &workers[ 0 ] );
+
+    for( i = 1; i < n; i++ )
+	breaker.Join( workers[ i ].thread );
+
+    for( i = 0; i < n; i++ )
+	clients[ i ]->SetBreak( 0 );
+
+    delete [] workers;
+}
+
+void
+P4Batch::WorkerThread( void *arg )
+{
+    Worker *w = (Worker *) arg;
+    w->batch->RunBatches( w );
+}
+
+void
+P4Batch::RunBatches( Worker *w )
+{
+    for( ;; )
+    {
+	int	b;
+	{
+	    P4Lock	l( lock );
+	    if( next >= nBatches || breaker.Stopped() )
+		return;
+	    b = next++;
+	}
+
+	Batch	&bt = batches[ b ];
+	double	start = P4PerlSys::Now();
+
+	if( maxResults  )	w->client->SetVar( "maxResults",  maxResults  );
+	if( maxScanRows )	w->client->SetVar( "maxScanRows", maxScanRows );
+
+#if P4API_VERSION >= 513026
+	w->client->SetProg( prog );
+#endif
+	w->client->SetArgv( bt.argc, bt.argv );
+	w->client->Run( cmd, bt.output );
+
+	bt.seconds = P4PerlSys::Now() - start;
+	bt.connection = w->index;
+    }
+}
+
+void
+P4Batch::Replay( int b, ClientUser *ui )
+{
+    if( batches[ b ].output )
+	batches[ b ].output->Replay( ui );
+}
@@ -0,0 +1,123 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4batch.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Splitting of long file argument lists into batches so
+ * 		  that huge commands (an edit of 200,000 files, say) go to
+ * 		  the server as a series of smaller ones. Batches can be
+ * 		  run one after another by the caller, or in parallel on
+ * 		  several connections here, with the output captured for
+ * 		  replaying in batch order afterwards.
+ *
+ * 		  The leading arguments that start with '-' are options,
+ * 		  and are passed with every batch. Options known to take a
+ * 		  value (-c 1234, -t binary, -m 10 etc.) bring the
+ * 		  following argument with them, and "--" ends the options.
+ * 		  Everything after the options is split up.
+ *
+ ******************************************************************************/
+
+class BufferedClientUser;
+
+class P4Batch
+{
+    public:
+		P4Batch( const char *cmd, int argc, char * const *argv, 
+			 int maxFiles, int maxBytes );
+		~P4Batch();
+
+	int		Count()			{ return nBatches;	}
+
+	// The arguments for a batch: the options followed by its files
+	int		Argc( int b )		{ return batches[ b ].argc; }
+	char * const *	Argv( int b )		{ return batches[ b ].argv; }
+
+	int		Files( int b )		{ return batches[ b ].files; }
+	int		Bytes( int b )		{ return batches[ b ].bytes; }
+	double		Seconds( int b )	{ return batches[ b ].seconds; }
+	int		Connection( int b )	{ return batches[ b ].connection; }
+	void		SetSeconds( int b, double s )	
+						{ batches[ b ].seconds = s; }
+
+	// Run every batch, sharing them out between the connections, which
+	// must be initialised already. Returns when all have finished, or
+	// as soon as alive (if given; only called on this thread) says to
+	// stop, when the batches not yet run are left out.
+	void	RunParallel( ClientApi **clients, int n, const char *cmd,
+			     const char *prog, int maxResults, int maxScanRows,
+			     KeepAlive *alive = 0 );
+
+	// Pass the captured output of a batch on to the real ClientUser
+	void	Replay( int b, ClientUser *ui );
+
+	// Whether a command line option (e.g. "-c") of cmd is followed by
+	// a value
+	static int	TakesValue( const char *cmd, const char *arg );
+
+    private:
+	struct Batch
+	{
+	    int			argc;
+	    char **		argv;
+	    int			files;
+	    int			bytes;
+	    double		seconds;
+	    int			connection;
+	    BufferedClientUser *output;
+	};
+
+	struct Worker
+	{
+	    P4Batch *		batch;
+	    ClientApi *		client;
+	    int			index;
+	    P4Thread		thread;
+	};
+
+	static void	WorkerThread( void *arg );
+	void		RunBatches( Worker *w );
+
+    private:
+	Batch *		batches;
+	int		nBatches;
+
+	// What each worker needs to run a command
+	const char *	cmd;
+	const char *	prog;
+	int		maxResults;
+	int		maxScanRows;
+
+	// The next batch to be picked up by a worker
+	P4Mutex		lock;
+	int		next;
+
+	P4Breaker	breaker;
+};
@@ -0,0 +1,72 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4breaker.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Stopping a command whose work is shared out between a
+ * 		  pool of threads and connections.
+ *
+ ******************************************************************************/
+
+#include <clientapi.h>
+#include "p4perlsys.h"
+#include "p4breaker.h"
+
+P4Breaker::P4Breaker()
+{
+    alive = 0;
+    stopped = 0;
+    caller.breaker = this;
+    worker.breaker = this;
+}
+
+void
+P4Breaker::Reset( KeepAlive *alive )
+{
+    this->alive = alive;
+    stopped = 0;
+}
+
+int
+P4Breaker::Check()
+{
+    if( !stopped && alive && !alive->IsAlive() )
+	stopped = 1;
+    return !stopped;
+}
+
+void
+P4Breaker::Join( P4Thread &t )
+{
+    while( alive && t.IsRunning() && !t.IsFinished() && Check() )
+	P4PerlSys::Sleep( 50 );
+    t.Join();
+}
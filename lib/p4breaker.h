@@ -0,0 +1,86 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4breaker.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Stopping a command whose work is shared out between a
+ * 		  pool of threads and connections. What decides whether
+ * 		  the command should go on (our PerlClientUser) may only be
+ * 		  asked on the caller's thread, so that thread asks, both
+ * 		  from its own connection and while it waits for the
+ * 		  others, and the workers' connections just see the
+ * 		  answer. Must not use Perl in any way.
+ *
+ ******************************************************************************/
+
+class P4Breaker
+{
+    public:
+		P4Breaker();
+
+	// Start afresh, taking orders from alive, which may be 0
+	void		Reset( KeepAlive *alive );
+
+	// For SetBreak() on a connection used on the caller's thread, and
+	// on one used by any other thread
+	KeepAlive *	ForCaller()		{ return &caller;	}
+	KeepAlive *	ForWorker()		{ return &worker;	}
+
+	// Caller's thread only. Asks again; returns 0 to stop.
+	int		Check();
+
+	// Any thread. Whether we've been told to stop.
+	int		Stopped()		{ return stopped;	}
+
+	// Caller's thread only. Joins the thread, asking whether to stop
+	// all the while it runs.
+	void		Join( P4Thread &t );
+
+    private:
+	class Caller : public KeepAlive
+	{
+	    public:
+		int		IsAlive()	{ return breaker->Check();   }
+		P4Breaker *	breaker;
+	};
+
+	class Worker : public KeepAlive
+	{
+	    public:
+		int		IsAlive()	{ return !breaker->Stopped(); }
+		P4Breaker *	breaker;
+	};
+
+	KeepAlive *	alive;
+	volatile int	stopped;
+	Caller		caller;
+	Worker		worker;
+};
@@ -0,0 +1,265 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4fanout.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Running a command on several servers concurrently. Must
+ * 		  not use Perl in any way as the workers run on threads of
+ * 		  their own.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <clientapi.h>
+#include "p4perlsys.h"
+#include "p4breaker.h"
+#include "bufferedclientuser.h"
+#include "p4fanout.h"
+
+P4FanOut::P4FanOut()
+{
+    servers = 0;
+    nServers = 0;
+    maxServers = 0;
+    records = 0;
+    nRecords = 0;
+}
+
+P4FanOut::~P4FanOut()
+{
+    for( int i = 0; i < nServers; i++ )
+    {
+	delete servers[ i ].client;
+	delete servers[ i ].output;
+    }
+    delete [] servers;
+    delete [] records;
+}
+
+void
+P4FanOut::AddServer( ClientApi *client, const char *name )
+{
+    if( nServers == maxServers )
+    {
+	maxServers = maxServers ? maxServers * 2 : 8;
+	Server *n = new Server[ maxServers ];
+	for( int i = 0; i < nServers; i++ )
+	{
+	    n[ i ].client = servers[ i ].client;
+	    n[ i ].name.Set( servers[ i ].name );
+	    n[ i ].output = servers[ i ].output;
+	    n[ i ].seconds = servers[ i ].seconds;
+	}
+	delete [] servers;
+	servers = n;
+    }
+
+    Server &s = servers[ nServers++ ];
+    s.fanOut = this;
+    s.client = client;
+    s.name.Set( name );
+    s.output = new BufferedClientUser;
+    s.output->SetTag( "server", s.name );
+    s.seconds = 0;
+}
+
+//
+// One thread per server, as the point is to wait for them all at once.
+// The first runs on this thread, and any that can't be given a thread of
+// their own are run here afterwards.
+//
+void
+P4FanOut::Run( const char *cmd, int argc, char * const *argv,
+	       const char *prog, int maxResults, int maxScanRows,
+	       KeepAlive *alive )
+{
+    this->cmd = cmd;
+    this->argc = argc;
+    this->argv = argv;
+    this->prog = prog;
+    this->maxResults = maxResults;
+    this->maxScanRows = maxScanRows;
+    breaker.Reset( alive );
+
+    int	i;
+
+    for( i = 0; i < nServers; i++ )
+    {
+	servers[ i ].fanOut = this;
+	servers[ i ].client->SetBreak( i ? breaker.ForWorker() 
+					 : breaker.ForCaller() );
+    }
+
+    for( i = 1; i < nServers; i++ )
+	servers[ i ].thread.Start( WorkerThread, &servers[ i ] );
+
+    if( nServers )
+	RunServer( servers[ 0 ] );
+
+    //
+    // Servers that couldn't have a thread of their own run here, on the
+    // caller's thread
+    //
+    for( i = 1; i < nServers; i++ )
+    {
+	if( servers[ i ].thread.IsRunning() )
+	    breaker.Join( servers[ i ].thread );
+	else if( breaker.Check() )
+	{
+	    servers[ i ].client->SetBreak( breaker.ForCaller() );
+	    RunServer( servers[ i ] );
+	}
+    }
+
+    for( i = 0; i < nServers; i++ )
+	servers[ i ].client->SetBreak( 0 );
+}
+
+void
+P4FanOut::WorkerThread( void *arg )
+{
+    Server	*s = (Server *) arg;
+    s->fanOut->RunServer( *s );
+}
+
+void
+P4FanOut::RunServer( Server &s )
+{
+    double	start = P4PerlSys::Now();
+    Error	e;
+
+    if( breaker.Stopped() )
+	return;
+
+    s.client->Init( &e );
+    if( e.Test() )
+    {
+	s.output->HandleError( &e );
+	s.seconds = P4PerlSys::Now() - start;
+	return;
+    }
+
+    if( maxResults  )	s.client->SetVar( "maxResults",  maxResults  );
+    if( maxScanRows )	s.client->SetVar( "maxScanRows", maxScanRows );
+
+#if P4API_VERSION >= 513026
+    s.client->SetProg( prog );
+#endif
+    s.client->SetArgv( argc, argv );
+    s.client->Run( cmd, s.output );
+    s.client->Final( &e );
+
+    s.seconds = P4PerlSys::Now() - start;
+}
+
+void
+P4FanOut::Replay( ClientUser *ui, const char *sortField )
+{
+    int		i;
+
+    if( !sortField || !*sortField )
+    {
+	for( i = 0; i < nServers; i++ )
+	    servers[ i ].output->Replay( ui );
+	return;
+    }
+
+    descending = ( *sortField == '-' );
+    this->sortField = sortField + descending;
+
+    int	total = 0;
+    for( i = 0; i < nServers; i++ )
+	total += servers[ i ].output->StatCount();
+
+    delete [] records;
+    records = new Record[ total ];
+    nRecords = 0;
+
+    for( current = 0; current < nServers; current++ )
+    {
+	servers[ current ].output->ReplayMessages( ui );
+	servers[ current ].output->EachStat( AddRecord, this );
+    }
+
+    qsort( records, nRecords, sizeof( Record ), CompareRecords );
+
+    //
+    // Sorted ascending, with ties broken by server and arrival (negated
+    // when descending), so walking backwards keeps ties in order too.
+    //
+    for( i = 0; i < nRecords; i++ )
+	ui->OutputStat( records[ descending ? nRecords - 1 - i : i ].dict );
+
+    for( i = 0; i < nServers; i++ )
+	servers[ i ].output->Clear();
+}
+
+void
+P4FanOut::AddRecord( StrDict *dict, void *arg )
+{
+    P4FanOut	*f = (P4FanOut *) arg;
+    Record	&r = f->records[ f->nRecords ];
+    StrPtr	*v = dict->GetVar( f->sortField );
+    const char	*p;
+
+    r.dict = dict;
+    r.key = v ? v->Text() : "";
+    r.server = f->descending ? -f->current : f->current;
+    r.seq = f->descending ? -f->nRecords : f->nRecords;
+
+    // Numbers sort as numbers, and before anything that isn't one
+    p = r.key + ( *r.key == '-' );
+    r.numeric = *p != 0 && p - r.key + strspn( p, "0123456789" ) == 
+			   strlen( r.key );
+    r.num = r.numeric ? atoll( r.key ) : 0;
+
+    f->nRecords++;
+}
+
+int
+P4FanOut::CompareRecords( const void *a, const void *b )
+{
+    const Record	*x = (const Record *) a;
+    const Record	*y = (const Record *) b;
+    int			c;
+
+    if( x->numeric && y->numeric )
+	c = x->num < y->num ? -1 : x->num > y->num;
+    else if( x->numeric != y->numeric )
+	c = y->numeric - x->numeric;
+    else
+	c = strcmp( x->key, y->key );
+
+    if( !c ) c = x->server - y->server;
+    if( !c ) c = x->seq - y->seq;
+    return c;
+}
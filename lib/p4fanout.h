@@ -0,0 +1,116 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4fanout.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Running the same command against several servers at
+ * 		  once, one thread and connection per server. The output
+ * 		  of each is captured with every record tagged with the
+ * 		  server it came from, then handed on, optionally merged
+ * 		  into order by one of the fields. Must not use Perl in
+ * 		  any way.
+ *
+ ******************************************************************************/
+
+class P4FanOut
+{
+    public:
+		P4FanOut();
+		~P4FanOut();
+
+	// Takes ownership of the client, which should have its settings
+	// but not be connected yet. Records are tagged with the name.
+	void		AddServer( ClientApi *client, const char *name );
+
+	int		Count()			{ return nServers;	}
+	const StrPtr &	Name( int i )		{ return servers[ i ].name; }
+	double		Seconds( int i )	{ return servers[ i ].seconds; }
+
+	// Returns when every server has answered (or failed to), or as
+	// soon as alive (if given; only called on this thread) says to stop
+	void		Run( const char *cmd, int argc, char * const *argv,
+			     const char *prog, int maxResults, 
+			     int maxScanRows, KeepAlive *alive = 0 );
+
+	// Hand the output on to the real ClientUser: everything from each
+	// server in turn, or if there's a field to sort by, the messages
+	// followed by all the records in order of that field (descending
+	// if it starts with '-'). Numeric fields are compared as numbers.
+	void		Replay( ClientUser *ui, const char *sortField );
+
+    private:
+	struct Server
+	{
+	    P4FanOut *		fanOut;
+	    ClientApi *		client;
+	    StrBuf		name;
+	    BufferedClientUser *output;
+	    double		seconds;
+	    P4Thread		thread;
+	};
+
+	struct Record
+	{
+	    StrDict *		dict;
+	    const char *	key;
+	    long long		num;
+	    int			numeric;
+	    int			server;
+	    int			seq;
+	};
+
+	static void	WorkerThread( void *arg );
+	static void	AddRecord( StrDict *dict, void *arg );
+	static int	CompareRecords( const void *a, const void *b );
+	void		RunServer( Server &s );
+
+    private:
+	Server *	servers;
+	int		nServers;
+	int		maxServers;
+
+	// What each worker needs to run the command
+	const char *	cmd;
+	int		argc;
+	char * const *	argv;
+	const char *	prog;
+	int		maxResults;
+	int		maxScanRows;
+
+	// While collecting records to be sorted
+	Record *	records;
+	int		nRecords;
+	const char *	sortField;
+	int		descending;
+	int		current;
+
+	P4Breaker	breaker;
+};
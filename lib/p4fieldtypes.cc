@@ -0,0 +1,252 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4fieldtypes.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Knowledge of which fields in tagged output hold numbers.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include <clientapi.h>
+#include "p4fieldtypes.h"
+
+//
+// Fields known to hold integers. Values which turn out not to be plain
+// integers (a change of "default", a revision of "none") stay strings,
+// so it doesn't matter if a field is sometimes something else.
+//
+static struct NumericField
+{
+    const char *	cmd;	// Null for all commands
+    const char *	field;
+} numericFields[] = {
+    { 0,		"change"	},
+    { 0,		"fileSize"	},
+    { 0,		"haveRev"	},
+    { 0,		"headChange"	},
+    { 0,		"headModTime"	},
+    { 0,		"headRev"	},
+    { 0,		"headTime"	},
+    { 0,		"rev"		},
+    { 0,		"time"		},
+    { 0,		"Update"	},
+    { 0,		"Access"	},
+    { "annotate",	"lower"		},
+    { "annotate",	"upper"		},
+    { "counter",	"value"		},
+    { "counters",	"value"		},
+    { "diff2",		"rev2"		},
+    { "fixes",		"Change"	},
+    { "fixes",		"Date"		},
+    { "fstat",		"headCharset"	},
+    { "fstat",		"otherOpens"	},
+    { "groups",		"maxLockTime"	},
+    { "groups",		"maxResults"	},
+    { "groups",		"maxScanRows"	},
+    { "groups",		"timeout"	},
+    { "integrated",	"endFromRev"	},
+    { "integrated",	"endToRev"	},
+    { "integrated",	"startFromRev"	},
+    { "integrated",	"startToRev"	},
+    { "sizes",		"fileCount"	},
+    { 0, 0 }
+};
+
+P4FieldTypes::P4FieldTypes()
+{
+    table = 0;
+    count = 0;
+    size = 0;
+}
+
+P4FieldTypes::~P4FieldTypes()
+{
+    delete [] table;
+}
+
+void
+P4FieldTypes::Set( const char *field, Type t, const char *cmd )
+{
+    StrBuf	key;
+    StrBuf	val;
+
+    key << ( cmd ? cmd : "" ) << " " << field;
+    val << (int) t;
+    overrides.SetVar( key, val );
+
+    // Make sure the next Select() rebuilds the table
+    current.Clear();
+}
+
+void
+P4FieldTypes::CopyOverrides( P4FieldTypes &from )
+{
+    StrRef	var, val;
+
+    for( int i = 0; from.overrides.GetVar( i, var, val ); i++ )
+	overrides.SetVar( var, val );
+    current.Clear();
+}
+
+void
+P4FieldTypes::Select( const char *cmd, const StrPtr *specDef )
+{
+    // The table for the last command is usually the one we want
+    if( !specDef && current.Length() && current == cmd )
+	return;
+
+    current = cmd;
+    count = 0;
+
+    for( NumericField *f = numericFields; f->field; f++ )
+	if( !f->cmd || !strcmp( f->cmd, cmd ) )
+	    Add( f->field, strlen( f->field ), T_INT );
+
+    if( specDef )
+    {
+	Exclude( specDef );
+	current.Clear();
+    }
+
+    // User overrides come last so that they always win
+    StrRef	var, val;
+    int	len = strlen( cmd );
+
+    for( int i = 0; overrides.GetVar( i, var, val ); i++ )
+    {
+	const char *sp = strchr( var.Text(), ' ' );
+	if( sp != var.Text() && 
+	    ( sp - var.Text() != len || strncmp( var.Text(), cmd, len ) ) )
+	    continue;
+
+	Add( sp + 1, strlen( sp + 1 ), (Type) val.Atoi() );
+    }
+}
+
+//
+// Spec definitions say what each form field holds. Anything that isn't
+// a single word (text, lines, dates, select lists etc.) is a string
+// whatever it's called. Dates are in the server's local time, so they
+// stay strings too.
+//
+void
+P4FieldTypes::Exclude( const StrPtr *specDef )
+{
+    const char *p = specDef->Text();
+
+    while( *p )
+    {
+	const char *end = strstr( p, ";;" );
+	if( !end ) end = p + strlen( p );
+
+	const char *semi = strchr( p, ';' );
+	if( !semi || semi > end ) semi = end;
+
+	const char *type = strstr( p, ";type:" );
+	if( type && type < end && strncmp( type + 6, "word;", 5 ) )
+	    Add( p, semi - p, T_STRING );
+
+	p = *end ? end + 2 : end;
+    }
+}
+
+//
+// Add a field to the table, or change its type if it's there already.
+// The table is kept sorted by name for Lookup().
+//
+void
+P4FieldTypes::Add( const char *field, int len, Type t )
+{
+    StrRef	name( field, len );
+    int		i;
+
+    for( i = 0; i < count; i++ )
+    {
+	int c = strncmp( table[ i ].name.Text(), field, len );
+	if( !c ) c = table[ i ].name.Length() - len;
+
+	if( !c )
+	{
+	    table[ i ].type = t;
+	    return;
+	}
+	if( c > 0 )
+	    break;
+    }
+
+    if( count == size )
+    {
+	int	n = size ? size * 2 : 64;
+	Entry	*e = new Entry[ n ];
+
+	for( int j = 0; j < count; j++ )
+	{
+	    e[ j ].name = table[ j ].name;
+	    e[ j ].type = table[ j ].type;
+	}
+	delete [] table;
+	table = e;
+	size = n;
+    }
+
+    for( int j = count; j > i; j-- )
+    {
+	table[ j ].name = table[ j - 1 ].name;
+	table[ j ].type = table[ j - 1 ].type;
+    }
+
+    table[ i ].name = name;
+    table[ i ].type = t;
+    count++;
+}
+
+P4FieldTypes::Type
+P4FieldTypes::Lookup( const char *field, int length )
+{
+    int	lo = 0;
+    int	hi = count - 1;
+
+    while( lo <= hi )
+    {
+	int		mid = ( lo + hi ) / 2;
+	const StrBuf	&n = table[ mid ].name;
+	int		c = strncmp( n.Text(), field, length );
+
+	if( !c ) c = n.Length() - length;
+	if( !c ) return table[ mid ].type;
+
+	if( c < 0 )
+	    lo = mid + 1;
+	else
+	    hi = mid - 1;
+    }
+    return T_STRING;
+}
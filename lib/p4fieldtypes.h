@@ -0,0 +1,79 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4fieldtypes.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Knowledge of which fields in tagged output hold numbers,
+ * 		  so that they can be converted straight to Perl integers
+ * 		  (or floating point values) rather than strings. There's
+ * 		  a built-in table of the usual numeric fields, some for
+ * 		  all commands and some for particular commands, which
+ * 		  the user can override field by field.
+ *
+ ******************************************************************************/
+
+class P4FieldTypes
+{
+    public:
+	enum Type { T_STRING, T_INT, T_NUM };
+
+		P4FieldTypes();
+		~P4FieldTypes();
+
+	// User overrides. A null cmd applies to all commands.
+	void	Set( const char *field, Type t, const char *cmd = 0 );
+	void	CopyOverrides( P4FieldTypes &from );
+
+	// Build the lookup table for the fields of one command. Fields the
+	// spec definition (if any) says hold text, dates etc. are strings.
+	void	Select( const char *cmd, const StrPtr *specDef = 0 );
+
+	Type	Lookup( const char *field, int length );
+
+    private:
+	struct Entry
+	{
+	    StrBuf	name;
+	    Type	type;
+	};
+
+	void	Add( const char *field, int len, Type t );
+	void	Exclude( const StrPtr *specDef );
+
+    private:
+	// The user's overrides: "cmd field" (or " field") -> type
+	StrBufDict	overrides;
+
+	// The current command's table, kept sorted by name
+	Entry *		table;
+	int		count;
+	int		size;
+	StrBuf		current;
+};
@@ -0,0 +1,581 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4filter.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Filter expressions evaluated against tagged output
+ * 		  before it's converted into Perl data.
+ *
+ ******************************************************************************/
+
+#ifdef OS_NT
+#  include <math.h>
+#endif
+
+#include <clientapi.h>
+
+/* When including Perl headers, make sure the linkage is C, not C++ */
+extern "C" 
+{
+#include "EXTERN.h"
+#include "perl.h"
+#include "XSUB.h"
+}
+
+#ifdef Error
+// Defined by older versions of Perl to be Perl_Error
+# undef Error
+#endif
+
+#include "p4filter.h"
+
+//
+// Regular expressions are compiled and run by Perl's own engine so that
+// users get the syntax they expect. This relies on the pregcomp()
+// interface introduced in Perl 5.10; older Perls can't use =~ or !~.
+//
+#ifdef RXf_PMf_FOLD
+# define P4FILTER_REGEX
+#endif
+
+P4Filter::Node::Node( NodeType t )
+{
+    type = t;
+    left = right = 0;
+    number = 0;
+    regex = 0;
+}
+
+P4Filter::Node::~Node()
+{
+    delete left;
+    delete right;
+#ifdef P4FILTER_REGEX
+    if( regex )
+	ReREFCNT_dec( (REGEXP *) regex );
+#endif
+}
+
+P4Filter::P4Filter()
+{
+    root = 0;
+    expr = pos = 0;
+    error = 0;
+    scratchSv = 0;
+}
+
+P4Filter::~P4Filter()
+{
+    delete root;
+    if( scratchSv )
+	SvREFCNT_dec( (SV *) scratchSv );
+}
+
+int
+P4Filter::Compile( const char *e, StrBuf &msg )
+{
+    delete root;
+    expr = pos = e;
+    error = &msg;
+    msg.Clear();
+
+    root = ParseOr();
+
+    SkipSpace();
+    if( root && *pos )
+	SetError( "unexpected text" );
+
+    if( msg.Length() )
+    {
+	delete root;
+	root = 0;
+    }
+
+    error = 0;
+    return root != 0;
+}
+
+void
+P4Filter::SetError( const char *what )
+{
+    if( error->Length() )
+	return;
+
+    *error << "Filter syntax error, " << what << " at offset " 
+	   << (int)( pos - expr ) << ": '" << pos << "'";
+}
+
+void
+P4Filter::SkipSpace()
+{
+    while( *pos && isspace( (unsigned char) *pos ) )
+	pos++;
+}
+
+//
+// Accept a word operator (and, or, not) only when it's a word on its own.
+//
+int
+P4Filter::Keyword( const char *word )
+{
+    int	len = strlen( word );
+
+    if( strncmp( pos, word, len ) )
+	return 0;
+    if( isalnum( (unsigned char) pos[ len ] ) || pos[ len ] == '_' )
+	return 0;
+
+    pos += len;
+    return 1;
+}
+
+P4Filter::Node *
+P4Filter::ParseOr()
+{
+    Node *n = ParseAnd();
+
+    while( n )
+    {
+	SkipSpace();
+	if( !strncmp( pos, "||", 2 ) )
+	    pos += 2;
+	else if( !Keyword( "or" ) )
+	    break;
+
+	Node *o = new Node( F_OR );
+	o->left = n;
+	o->right = ParseAnd();
+	n = o;
+
+	if( !o->right )
+	{
+	    delete n;
+	    return 0;
+	}
+    }
+    return n;
+}
+
+P4Filter::Node *
+P4Filter::ParseAnd()
+{
+    Node *n = ParseNot();
+
+    while( n )
+    {
+	SkipSpace();
+	if( !strncmp( pos, "&&", 2 ) )
+	    pos += 2;
+	else if( !Keyword( "and" ) )
+	    break;
+
+	Node *a = new Node( F_AND );
+	a->left = n;
+	a->right = ParseNot();
+	n = a;
+
+	if( !a->right )
+	{
+	    delete n;
+	    return 0;
+	}
+    }
+    return n;
+}
+
+P4Filter::Node *
+P4Filter::ParseNot()
+{
+    SkipSpace();
+
+    if( ( *pos == '!' && pos[ 1 ] != '=' && pos[ 1 ] != '~' ) || 
+	Keyword( "not" ) )
+    {
+	if( *pos == '!' ) pos++;
+
+	Node *n = ParseNot();
+	if( !n )
+	    return 0;
+
+	Node *o = new Node( F_NOT );
+	o->left = n;
+	return o;
+    }
+
+    if( *pos == '(' )
+    {
+	pos++;
+	Node *n = ParseOr();
+	if( !n )
+	    return 0;
+
+	SkipSpace();
+	if( *pos != ')' )
+	{
+	    SetError( "missing ')'" );
+	    delete n;
+	    return 0;
+	}
+	pos++;
+	return n;
+    }
+
+    return ParseTerm();
+}
+
+//
+// field op value
+//
+P4Filter::Node *
+P4Filter::ParseTerm()
+{
+    const char *	start;
+    NodeType		type;
+    StrBuf		field;
+
+    SkipSpace();
+    for( start = pos; isalnum( (unsigned char) *pos ) || *pos == '_' || 
+		      *pos == ','; pos++ )
+	;
+
+    if( pos == start )
+    {
+	SetError( "expected a field name" );
+	return 0;
+    }
+    field.Set( start, pos - start );
+
+    SkipSpace();
+    if( !strncmp( pos, "==", 2 ) )	{ type = F_EQ;		pos += 2; }
+    else if( !strncmp( pos, "!=", 2 ) )	{ type = F_NE;		pos += 2; }
+    else if( !strncmp( pos, "=~", 2 ) )	{ type = F_MATCH;	pos += 2; }
+    else if( !strncmp( pos, "!~", 2 ) )	{ type = F_NOMATCH;	pos += 2; }
+    else if( !strncmp( pos, "<=", 2 ) )	{ type = F_LE;		pos += 2; }
+    else if( !strncmp( pos, ">=", 2 ) )	{ type = F_GE;		pos += 2; }
+    else if( *pos == '=' )		{ type = F_EQ;		pos++;	  }
+    else if( *pos == '<' )		{ type = F_LT;		pos++;	  }
+    else if( *pos == '>' )		{ type = F_GT;		pos++;	  }
+    else
+    {
+	SetError( "expected a comparison operator" );
+	return 0;
+    }
+
+    Node *n = new Node( type );
+    n->field = field;
+
+    if( !ParseValue( n->value, type == F_MATCH || type == F_NOMATCH ) )
+    {
+	delete n;
+	return 0;
+    }
+
+    switch( type )
+    {
+    case F_LT:
+    case F_LE:
+    case F_GT:
+    case F_GE:
+	if( !Number( &n->value, n->number ) )
+	{
+	    SetError( "numeric comparison with a non-numeric value" );
+	    delete n;
+	    return 0;
+	}
+	break;
+
+    case F_EQ:
+    case F_NE:
+	// Wildcards turn equality into a glob match
+	if( strchr( n->value.Text(), '*' ) || strchr( n->value.Text(), '?' ) )
+	{
+	    int	negate = ( type == F_NE );
+
+	    n->type = F_GLOB;
+	    if( negate )
+	    {
+		Node *o = new Node( F_NOT );
+		o->left = n;
+		n = o;
+	    }
+	}
+	break;
+
+    case F_MATCH:
+    case F_NOMATCH:
+#ifdef P4FILTER_REGEX
+	{
+	    // Flags follow the closing delimiter, which ParseValue() left
+	    // in place for us.
+	    U32	flags = 0;
+	    for( ; isalpha( (unsigned char) *pos ); pos++ )
+	    {
+		if( *pos == 'i' )
+		    flags |= RXf_PMf_FOLD;
+		else
+		{
+		    SetError( "unsupported regular expression flag" );
+		    delete n;
+		    return 0;
+		}
+	    }
+
+	    SV *pat = newSVpvn( n->value.Text(), n->value.Length() );
+	    n->regex = pregcomp( pat, flags );
+	    SvREFCNT_dec( pat );
+	}
+#else
+	SetError( "regular expressions require Perl 5.10 or later" );
+	delete n;
+	return 0;
+#endif
+	break;
+
+    default:
+	break;
+    }
+
+    return n;
+}
+
+//
+// Values may be 'quoted', "quoted", /delimited/ (for regexes) or just a 
+// bare word that runs up to the next space, parenthesis or operator.
+//
+int
+P4Filter::ParseValue( StrBuf &value, int regex )
+{
+    SkipSpace();
+    value.Clear();
+
+    if( *pos == '\'' || *pos == '"' || ( regex && *pos == '/' ) )
+    {
+	char	quote = *pos++;
+
+	for( ; *pos && *pos != quote; pos++ )
+	{
+	    // Backslashes escape the delimiter. In a regex anything else
+	    // is left for the regex engine to interpret.
+	    if( *pos == '\\' && pos[ 1 ] )
+	    {
+		if( pos[ 1 ] == quote || !regex )
+		    pos++;
+		else
+		    value.Extend( *pos++ );
+	    }
+	    value.Extend( *pos );
+	}
+
+	if( *pos != quote )
+	{
+	    SetError( "unterminated value" );
+	    return 0;
+	}
+	pos++;
+	value.Terminate();
+	return 1;
+    }
+
+    const char *start = pos;
+    for( ; *pos && !isspace( (unsigned char) *pos ); pos++ )
+	if( *pos == ')' || *pos == '&' || *pos == '|' )
+	    break;
+
+    if( pos == start )
+    {
+	SetError( "expected a value" );
+	return 0;
+    }
+
+    value.Set( start, pos - start );
+    return 1;
+}
+
+int
+P4Filter::Match( StrDict *record )
+{
+    return root ? Eval( root, record ) : 1;
+}
+
+int
+P4Filter::Eval( Node *n, StrDict *record )
+{
+    switch( n->type )
+    {
+    case F_AND:	return Eval( n->left, record ) && Eval( n->right, record );
+    case F_OR:	return Eval( n->left, record ) || Eval( n->right, record );
+    case F_NOT:	return !Eval( n->left, record );
+    default:	break;
+    }
+
+    StrPtr	*v = record->GetVar( n->field );
+    double	d;
+
+    if( !v )
+	return 0;
+
+    switch( n->type )
+    {
+    case F_EQ:	return *v == n->value;
+    case F_NE:	return *v != n->value;
+    case F_GLOB:	return Glob( n->value.Text(), v->Text() );
+    case F_LT:	return Number( v, d ) && d <  n->number;
+    case F_LE:	return Number( v, d ) && d <= n->number;
+    case F_GT:	return Number( v, d ) && d >  n->number;
+    case F_GE:	return Number( v, d ) && d >= n->number;
+
+#ifdef P4FILTER_REGEX
+    case F_MATCH:
+    case F_NOMATCH:
+	{
+	    // The regex engine wants an SV to work on, so we reuse one
+	    if( !scratchSv )
+		scratchSv = newSVpvn( "", 0 );
+
+	    SV *sv = (SV *) scratchSv;
+	    sv_setpvn( sv, v->Text(), v->Length() );
+
+	    int m = pregexec( (REGEXP *) n->regex, SvPVX( sv ), SvEND( sv ), 
+			      SvPVX( sv ), 0, sv, 1 );
+	    return n->type == F_MATCH ? m : !m;
+	}
+#endif
+
+    default:
+	return 0;
+    }
+}
+
+//
+// Simple glob matching: '*' matches any run of characters and '?' matches
+// any single character.
+//
+int
+P4Filter::Glob( const char *p, const char *s )
+{
+    const char *	star = 0;
+    const char *	retry = 0;
+
+    while( *s )
+    {
+	if( *p == '*' )
+	{
+	    star = ++p;
+	    retry = s;
+	}
+	else if( *p == '?' || *p == *s )
+	{
+	    p++;
+	    s++;
+	}
+	else if( star )
+	{
+	    p = star;
+	    s = ++retry;
+	}
+	else
+	    return 0;
+    }
+
+    while( *p == '*' )
+	p++;
+
+    return !*p;
+}
+
+int
+P4Filter::Number( const StrPtr *s, double &d )
+{
+    char *end;
+
+    if( !s->Length() )
+	return 0;
+
+    d = strtod( s->Text(), &end );
+    return *end == 0;
+}
+
+int
+P4Filter::ServerFilter( StrBuf &out )
+{
+    out.Clear();
+    return root && Translate( root, out, 1 );
+}
+
+//
+// Translate a node into fstat -F syntax. Only equality and glob matches
+// are translated: the server's notion of equality is at least as lenient
+// as ours, but numeric and negated comparisons might not be, so those are
+// left to Match(). When 'partial' is set, untranslatable terms of an AND
+// are simply dropped, which leaves a less selective (but still correct)
+// server-side filter. Returns 0 if the node can't be translated.
+//
+int
+P4Filter::Translate( Node *n, StrBuf &out, int partial )
+{
+    StrBuf	l, r;
+    int		lok, rok;
+
+    switch( n->type )
+    {
+    case F_AND:
+	lok = Translate( n->left, l, partial );
+	rok = Translate( n->right, r, partial );
+	if( lok && rok )
+	    out << "( " << l << " ) & ( " << r << " )";
+	else if( lok && partial )
+	    out << l;
+	else if( rok && partial )
+	    out << r;
+	else
+	    return 0;
+	return 1;
+
+    case F_OR:
+	// Both sides must be fully translated or we'd lose records
+	if( !Translate( n->left, l, 0 ) || !Translate( n->right, r, 0 ) )
+	    return 0;
+	out << "( " << l << " ) | ( " << r << " )";
+	return 1;
+
+    case F_EQ:
+    case F_GLOB:
+	// Anything that would need quoting on the server is left to us
+	for( const char *c = n->value.Text(); *c; c++ )
+	    if( !isalnum( (unsigned char) *c ) && !strchr( "_-./+*@#,", *c ) )
+		return 0;
+
+	out << n->field << "=" << n->value;
+	return 1;
+
+    default:
+	return 0;
+    }
+}
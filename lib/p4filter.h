@@ -0,0 +1,109 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4filter.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Filter expressions evaluated against tagged output
+ * 		  before it's converted into Perl data. e.g.
+ *
+ * 		    headType =~ /binary/ && fileSize > 104857600
+ * 		    depotFile == *.c || !( headAction == delete )
+ *
+ * 		  Supported operators are == and != (string equality, or
+ * 		  glob matching if the value contains * or ?), the numeric
+ * 		  comparisons <, <=, > and >=, =~ and !~ (Perl regular
+ * 		  expressions), and &&, || and ! (or 'and', 'or' and 'not')
+ * 		  with parentheses for grouping. A comparison against a
+ * 		  field that's missing from a record is always false.
+ *
+ ******************************************************************************/
+
+class P4Filter
+{
+    public:
+		P4Filter();
+		~P4Filter();
+
+	// Returns 0, with an explanation in msg, on a syntax error.
+	int	Compile( const char *expr, StrBuf &msg );
+
+	int	Match( StrDict *record );
+
+	// Translate as much of the filter as possible into the syntax of
+	// 'p4 fstat -F' so the server can do some of the work. The result
+	// selects a superset of the records Match() accepts, so it must
+	// be used in addition to Match(), not instead of it. Returns 0 if
+	// nothing could be translated.
+	int	ServerFilter( StrBuf &out );
+
+    private:
+	enum NodeType
+	{
+	    F_AND, F_OR, F_NOT,
+	    F_EQ, F_NE, F_GLOB, F_LT, F_LE, F_GT, F_GE, F_MATCH, F_NOMATCH
+	};
+
+	struct Node
+	{
+		Node( NodeType t );
+		~Node();
+
+	    NodeType	type;
+	    Node *	left;
+	    Node *	right;
+	    StrBuf	field;
+	    StrBuf	value;
+	    double	number;
+	    void *	regex;
+	};
+
+	Node *	ParseOr();
+	Node *	ParseAnd();
+	Node *	ParseNot();
+	Node *	ParseTerm();
+
+	void	SkipSpace();
+	int	Keyword( const char *word );
+	int	ParseValue( StrBuf &value, int regex );
+	void	SetError( const char *what );
+
+	int	Eval( Node *n, StrDict *record );
+	int	Translate( Node *n, StrBuf &out, int partial );
+
+	static int	Glob( const char *pattern, const char *s );
+	static int	Number( const StrPtr *s, double &d );
+
+    private:
+	Node *		root;
+	const char *	expr;
+	const char *	pos;
+	StrBuf *	error;
+	void *		scratchSv;
+};
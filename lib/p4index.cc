@@ -0,0 +1,551 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4index.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Local, memory-mapped index of head revision metadata.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <clientapi.h>
+#include "p4perlsys.h"
+#include "p4index.h"
+
+static const char indexMagic[ 8 ] = "P4PIDX1";
+
+//
+// Offset of a file type or action in the names table, adding it if
+// it's not there already. There are only ever a handful of them.
+//
+static int
+NameOffset( StrBuf &table, StrBufDict &offsets, const char *name )
+{
+    StrPtr	*o = offsets.GetVar( name );
+
+    if( o )
+	return o->Atoi();
+
+    int	offset = table.Length();
+    table.Append( name, strlen( name ) + 1 );
+    offsets.SetVar( name, offset );
+    return offset;
+}
+
+P4Index::P4Index()
+{
+    header = 0;
+    entries = 0;
+    paths = 0;
+    names = 0;
+    updates = 0;
+    nUpdates = 0;
+    maxUpdates = 0;
+}
+
+P4Index::~P4Index()
+{
+    Close();
+    DiscardUpdates();
+    delete [] updates;
+}
+
+int
+P4Index::Open( const char *f )
+{
+    Close();
+    file.Set( f );
+
+    if( !map.Map( f ) )
+    {
+	error.Set( "Can't open index file " );
+	error << f;
+	return 0;
+    }
+
+    const char	*d = map.Data();
+    Header	*h = (Header *) d;
+
+    if( !IsValid( d, map.Size() ) )
+    {
+	map.Unmap();
+	error.Set( f );
+	error << " is not a P4Perl index file";
+	return 0;
+    }
+
+    header = h;
+    entries = (Entry *)( d + h->entries );
+    paths = d;
+    names = d + h->names;
+    root.Set( names, h->rootLen );
+    return 1;
+}
+
+//
+// Checks that the header and every entry only point within the file, and
+// that every string they point to ends before the file does, so that a
+// truncated or corrupt index can't have us read beyond the mapping.
+//
+int
+P4Index::IsValid( const char *d, P4INT64 size )
+{
+    const Header	*h = (const Header *) d;
+    P4INT64		entrySize = sizeof( Entry );
+
+    if( size < (P4INT64) sizeof( Header ) || 
+	memcmp( h->magic, indexMagic, 8 ) ||
+	h->count < 0 || h->rootLen < 0 ||
+	h->entries < (P4INT64) sizeof( Header ) || h->entries > size ||
+	h->entries % 8 ||
+	h->entries + h->count * entrySize > h->names ||
+	h->names + h->rootLen >= size ||
+	d[ size - 1 ] )
+	return 0;
+
+    const Entry	*e = (const Entry *)( d + h->entries );
+    P4INT64	namesLen = size - h->names;
+
+    for( int i = 0; i < h->count; i++, e++ )
+    {
+	if( e->path < (P4INT64) sizeof( Header ) || e->pathLen < 0 ||
+	    e->path + e->pathLen >= h->entries || d[ e->path + e->pathLen ] )
+	    return 0;
+
+	if( e->type < 0 || e->type >= namesLen ||
+	    e->action < 0 || e->action >= namesLen )
+	    return 0;
+    }
+
+    return 1;
+}
+
+void
+P4Index::Close()
+{
+    map.Unmap();
+    header = 0;
+    entries = 0;
+    paths = 0;
+    names = 0;
+}
+
+const char *
+P4Index::Root()
+{
+    return root.Text();
+}
+
+int
+P4Index::HighWater()
+{
+    return header ? header->highWater : 0;
+}
+
+int
+P4Index::Count()
+{
+    return header ? header->count : 0;
+}
+
+int
+P4Index::ComparePaths( const char *a, int alen, const char *b, int blen )
+{
+    int	c = memcmp( a, b, alen < blen ? alen : blen );
+    return c ? c : alen - blen;
+}
+
+int
+P4Index::Lower( const char *prefix, int len )
+{
+    int	lo = 0;
+    int	hi = Count();
+
+    while( lo < hi )
+    {
+	int mid = ( lo + hi ) / 2;
+	if( ComparePaths( Path( mid ), PathLength( mid ), prefix, len ) < 0 )
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+int
+P4Index::Find( const char *path, int len )
+{
+    int	i = Lower( path, len );
+
+    if( i < Count() && PathLength( i ) == len && !memcmp( Path( i ), path, len ) )
+	return i;
+    return -1;
+}
+
+int
+P4Index::HasPrefix( int i, const char *prefix, int len )
+{
+    return i < Count() && PathLength( i ) >= len && 
+	   !memcmp( Path( i ), prefix, len );
+}
+
+//
+// The root is normally a path ending in "...", or a single file. We can
+// only tell for certain whether any other wildcards match by asking the
+// server, so files from a describe are taken on trust for those.
+//
+int
+P4Index::InRoot( const StrPtr &path )
+{
+    const char	*r = root.Text();
+    int		len = root.Length();
+    int		prefix = len >= 3 && !strcmp( r + len - 3, "..." ) 
+			 ? len - 3 : len;
+
+    for( const char *p = r; p < r + prefix; p++ )
+	if( strchr( "*%@#", *p ) || 
+	    ( p + 3 <= r + prefix && !strncmp( p, "...", 3 ) ) )
+	    return 1;
+
+    if( prefix < len )
+	return !strncmp( path.Text(), r, prefix );
+
+    return !strcmp( path.Text(), r );
+}
+
+P4Index::Update *
+P4Index::NewUpdate()
+{
+    if( nUpdates == maxUpdates )
+    {
+	int	m = maxUpdates ? maxUpdates * 2 : 256;
+	Update	**nu = new Update *[ m ];
+
+	for( int i = 0; i < nUpdates; i++ )
+	    nu[ i ] = updates[ i ];
+
+	delete [] updates;
+	updates = nu;
+	maxUpdates = m;
+    }
+
+    Update *u = new Update;
+    u->headRev = 0;
+    u->headChange = 0;
+    u->headTime = 0;
+    u->fileSize = -1;
+    u->sized = 0;
+    u->seq = nUpdates;
+
+    updates[ nUpdates++ ] = u;
+    return u;
+}
+
+void
+P4Index::AddFstat( StrDict *d )
+{
+    StrPtr	*path = d->GetVar( "depotFile" );
+    StrPtr	*rev = d->GetVar( "headRev" );
+    StrPtr	*v;
+
+    // Files that have only been opened for add have no head revision
+    if( !path || !rev )
+	return;
+
+    Update *u = NewUpdate();
+    u->path = *path;
+    u->headRev = rev->Atoi();
+    u->sized = 1;
+
+    if( ( v = d->GetVar( "headChange" ) ) )	u->headChange = v->Atoi();
+    if( ( v = d->GetVar( "headType" ) ) )	u->type = *v;
+    if( ( v = d->GetVar( "headAction" ) ) )	u->action = *v;
+    if( ( v = d->GetVar( "headTime" ) ) )	u->headTime = v->Atoi64();
+    if( ( v = d->GetVar( "fileSize" ) ) )	u->fileSize = v->Atoi64();
+}
+
+void
+P4Index::AddDescribe( StrDict *d )
+{
+    StrPtr	*change = d->GetVar( "change" );
+    StrPtr	*time = d->GetVar( "time" );
+    StrPtr	*f;
+    StrPtr	*v;
+
+    for( int i = 0; ( f = d->GetVar( "depotFile", i ) ); i++ )
+    {
+	if( !InRoot( *f ) )
+	    continue;
+
+	Update *u = NewUpdate();
+	u->path = *f;
+
+	if( change )				u->headChange = change->Atoi();
+	if( time )				u->headTime = time->Atoi64();
+	if( ( v = d->GetVar( "rev", i ) ) )	u->headRev = v->Atoi();
+	if( ( v = d->GetVar( "type", i ) ) )	u->type = *v;
+	if( ( v = d->GetVar( "action", i ) ) )	u->action = *v;
+    }
+}
+
+void
+P4Index::DiscardUpdates()
+{
+    for( int i = 0; i < nUpdates; i++ )
+	delete updates[ i ];
+    nUpdates = 0;
+}
+
+int
+P4Index::CompareUpdates( const void *a, const void *b )
+{
+    const Update *ua = *(const Update **) a;
+    const Update *ub = *(const Update **) b;
+
+    int c = ComparePaths( ua->path.Text(), ua->path.Length(),
+			  ub->path.Text(), ub->path.Length() );
+    return c ? c : ua->seq - ub->seq;
+}
+
+void
+P4Index::Apply( Rec &r, Update *u )
+{
+    r.headRev = u->headRev;
+    r.headChange = u->headChange;
+    r.headTime = u->headTime;
+
+    if( u->type.Length() )	r.type = u->type.Text();
+    if( u->action.Length() )	r.action = u->action.Text();
+    if( u->sized )		r.fileSize = u->fileSize;
+}
+
+//
+// Merge the sorted entries we have with the updates (sorted here, oldest
+// first for each path) into a new file. The paths are written as we go;
+// the entries, which are small and fixed size, are collected and written
+// after them.
+//
+int
+P4Index::Write( const char *f, int highWater )
+{
+    StrBuf	tmp;
+    tmp << f << ".tmp";
+
+    FILE	*fp = fopen( tmp.Text(), "wb" );
+    if( !fp )
+    {
+	error.Set( "Can't write index file " );
+	error << tmp;
+	return 0;
+    }
+
+    qsort( updates, nUpdates, sizeof( Update * ), CompareUpdates );
+
+    Header	h;
+    memset( &h, 0, sizeof( h ) );
+    memcpy( h.magic, indexMagic, sizeof( h.magic ) );
+    fwrite( &h, sizeof( h ), 1, fp );
+
+    int		count = Count();
+    Entry	*out = new Entry[ count + nUpdates + 1 ];
+    int		n = 0;
+    P4INT64	offset = sizeof( h );
+    StrBuf	nameTable;
+    StrBufDict	nameOffsets;
+    int		i = 0;
+    int		u = 0;
+
+    nameTable.Append( root.Text(), root.Length() + 1 );
+
+    while( i < count || u < nUpdates )
+    {
+	Rec	r;
+	int	c;
+
+	if( i >= count )
+	    c = 1;
+	else if( u >= nUpdates )
+	    c = -1;
+	else
+	    c = ComparePaths( Path( i ), PathLength( i ), 
+			      updates[ u ]->path.Text(), 
+			      updates[ u ]->path.Length() );
+
+	if( c <= 0 )
+	{
+	    r.path = Path( i );
+	    r.pathLen = PathLength( i );
+	    r.type = HeadType( i );
+	    r.action = HeadAction( i );
+	    r.headRev = HeadRev( i );
+	    r.headChange = HeadChange( i );
+	    r.headTime = HeadTime( i );
+	    r.fileSize = FileSize( i );
+	    i++;
+	}
+	else
+	{
+	    r.path = updates[ u ]->path.Text();
+	    r.pathLen = updates[ u ]->path.Length();
+	    r.type = "";
+	    r.action = "";
+	    r.headRev = 0;
+	    r.headChange = 0;
+	    r.headTime = 0;
+	    r.fileSize = -1;
+	}
+
+	if( c >= 0 )
+	{
+	    for( ; u < nUpdates && !ComparePaths( r.path, r.pathLen,
+				    updates[ u ]->path.Text(),
+				    updates[ u ]->path.Length() ); u++ )
+		Apply( r, updates[ u ] );
+	}
+
+	Entry	&e = out[ n++ ];
+	memset( &e, 0, sizeof( e ) );
+	e.path = offset;
+	e.pathLen = r.pathLen;
+	e.headRev = r.headRev;
+	e.headChange = r.headChange;
+	e.headTime = r.headTime;
+	e.fileSize = r.fileSize;
+	e.type = NameOffset( nameTable, nameOffsets, r.type );
+	e.action = NameOffset( nameTable, nameOffsets, r.action );
+
+	fwrite( r.path, 1, r.pathLen + 1, fp );
+	offset += r.pathLen + 1;
+    }
+
+    // Keep the entries aligned
+    for( ; offset % 8; offset++ )
+	fputc( 0, fp );
+
+    h.count = n;
+    h.highWater = highWater;
+    h.entries = offset;
+    h.names = offset + (P4INT64) n * (P4INT64) sizeof( Entry );
+    h.rootLen = root.Length();
+
+    fwrite( out, sizeof( Entry ), n, fp );
+    fwrite( nameTable.Text(), 1, nameTable.Length(), fp );
+    fseek( fp, 0, SEEK_SET );
+    fwrite( &h, sizeof( h ), 1, fp );
+    delete [] out;
+
+    int	ok = !ferror( fp );
+    if( fclose( fp ) )
+	ok = 0;
+
+    // The old mapping must go before the file can be replaced on Windows
+    StrBuf	name;
+    name.Set( f );
+    Close();
+    DiscardUpdates();
+
+    if( !ok || !P4PerlSys::Rename( tmp.Text(), name.Text() ) )
+    {
+	remove( tmp.Text() );
+	error.Set( "Can't write index file " );
+	error << name;
+	return 0;
+    }
+
+    return Open( name.Text() );
+}
+
+P4IndexUser::P4IndexUser( P4Index *index, Mode mode )
+{
+    this->index = index;
+    this->mode = mode;
+    failed = 0;
+    changes = 0;
+    nChanges = 0;
+    maxChanges = 0;
+}
+
+P4IndexUser::~P4IndexUser()
+{
+    delete [] changes;
+}
+
+//
+// Warnings such as "no such file(s)" just mean there's nothing to index
+//
+void
+P4IndexUser::HandleError( Error *e )
+{
+    if( e->IsInfo() || e->IsWarning() || failed )
+	return;
+
+    error = *e;
+    failed = 1;
+}
+
+void
+P4IndexUser::OutputStat( StrDict *values )
+{
+    switch( mode )
+    {
+    case IU_FSTAT:
+	index->AddFstat( values );
+	break;
+
+    case IU_DESCRIBE:
+	index->AddDescribe( values );
+	break;
+
+    case IU_CHANGES:
+	{
+	    StrPtr	*c = values->GetVar( "change" );
+	    if( !c )
+		break;
+
+	    if( nChanges == maxChanges )
+	    {
+		int	m = maxChanges ? maxChanges * 2 : 64;
+		int	*nc = new int[ m ];
+
+		for( int i = 0; i < nChanges; i++ )
+		    nc[ i ] = changes[ i ];
+
+		delete [] changes;
+		changes = nc;
+		maxChanges = m;
+	    }
+	    changes[ nChanges++ ] = c->Atoi();
+	}
+	break;
+    }
+}
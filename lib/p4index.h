@@ -0,0 +1,218 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4index.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: A local index of head revision metadata for the files
+ * 		  under a depot path, so that services which keep asking
+ * 		  for the head revision, type and size of files don't
+ * 		  need an fstat for every question.
+ *
+ * 		  The index is built once from a full fstat, and written
+ * 		  to disk sorted by depot path. It's used straight from a
+ * 		  read-only memory mapping, so lookups (by path, or for
+ * 		  everything under a prefix) are binary searches with no
+ * 		  parsing or copying. It records the last change it has
+ * 		  seen, and is brought up to date by replaying "describe
+ * 		  -s" for the changes submitted since then; updates are
+ * 		  held in memory and merged into a new file in one pass.
+ *
+ * 		  File layout (native byte order):
+ *
+ * 		      header | paths | entries | names
+ *
+ * 		  Paths are NUL terminated; names holds the root path and
+ * 		  the distinct file types and actions, which entries
+ * 		  refer to by offset.
+ *
+ ******************************************************************************/
+
+class P4Index
+{
+    public:
+		P4Index();
+		~P4Index();
+
+	// Opening an existing index. Returns 0 (see GetError()) on failure.
+	int		Open( const char *file );
+	void		Close();
+	int		IsOpen()		{ return header != 0;	}
+	const char *	GetError()		{ return error.Text();	}
+
+	const char *	File()			{ return file.Text();	}
+	const char *	Root();
+	int		HighWater();
+
+	// Lookups. Find() returns the entry for a path, or -1. Lower()
+	// returns the first entry at or after a prefix, which is Count()
+	// if there's none.
+	int		Count();
+	int		Find( const char *path, int len );
+	int		Lower( const char *prefix, int len );
+	int		HasPrefix( int i, const char *prefix, int len );
+
+	const char *	Path( int i )		{ return paths + E( i )->path; }
+	int		PathLength( int i )	{ return E( i )->pathLen;	}
+	int		HeadRev( int i )	{ return E( i )->headRev;	}
+	int		HeadChange( int i )	{ return E( i )->headChange;	}
+	const char *	HeadType( int i )	{ return names + E( i )->type;	}
+	const char *	HeadAction( int i )	{ return names + E( i )->action;}
+	P4INT64		HeadTime( int i )	{ return E( i )->headTime;	}
+	P4INT64		FileSize( int i )	{ return E( i )->fileSize;	}
+
+	// Updates, held until Write(). Records from fstat, and the files in
+	// a "describe -s" (which doesn't tell us sizes).
+	void		AddFstat( StrDict *d );
+	void		AddDescribe( StrDict *d );
+
+	void		DiscardUpdates();
+
+	// The updates so far. Those from describe -s aren't sized.
+	int		UpdateCount()		{ return nUpdates;		}
+	int		IsSized( int i )	{ return updates[ i ]->sized;	}
+	char *		UpdatePath( int i )	{ return updates[ i ]->path.Text(); }
+
+	// Does a depot path fall within the area the index covers?
+	int		InRoot( const StrPtr &path );
+	void		SetRoot( const char *r )	{ root.Set( r );	}
+
+	// Merges the updates with the current index and writes the result
+	// to the index file, replacing it, and opens it. Returns 0 (see
+	// GetError()) on failure.
+	int		Write( const char *file, int highWater );
+
+    private:
+	struct Header
+	{
+	    char	magic[ 8 ];
+	    int		count;
+	    int		highWater;
+	    P4INT64	entries;
+	    P4INT64	names;
+	    int		rootLen;
+	    int		pad;
+	};
+
+	struct Entry
+	{
+	    P4INT64	path;
+	    P4INT64	headTime;
+	    P4INT64	fileSize;
+	    int		pathLen;
+	    int		headRev;
+	    int		headChange;
+	    int		type;
+	    int		action;
+	    int		pad;
+	};
+
+	// An update that hasn't been written yet
+	struct Update
+	{
+	    StrBuf	path;
+	    StrBuf	type;
+	    StrBuf	action;
+	    int		headRev;
+	    int		headChange;
+	    P4INT64	headTime;
+	    P4INT64	fileSize;
+	    int		sized;
+	    int		seq;
+	};
+
+	// The head revision details for a file while we merge
+	struct Rec
+	{
+	    const char *path;
+	    int		pathLen;
+	    const char *type;
+	    const char *action;
+	    int		headRev;
+	    int		headChange;
+	    P4INT64	headTime;
+	    P4INT64	fileSize;
+	};
+
+	Entry *		E( int i )	{ return entries + i; }
+	int		IsValid( const char *data, P4INT64 size );
+	Update *	NewUpdate();
+	void		Apply( Rec &r, Update *u );
+	static int	CompareUpdates( const void *a, const void *b );
+	static int	ComparePaths( const char *a, int alen, 
+				      const char *b, int blen );
+
+    private:
+	StrBuf		file;
+	StrBuf		root;
+	StrBuf		error;
+
+	P4MappedFile	map;
+	Header *	header;
+	Entry *		entries;
+	const char *	paths;
+	const char *	names;
+
+	Update **	updates;
+	int		nUpdates;
+	int		maxUpdates;
+};
+
+//
+// A ClientUser that feeds the output of the commands used to build and
+// update an index into it, and keeps the change numbers from "changes".
+//
+class P4IndexUser : public ClientUser
+{
+    public:
+	enum Mode { IU_CHANGES, IU_FSTAT, IU_DESCRIBE };
+
+		P4IndexUser( P4Index *index, Mode mode );
+		~P4IndexUser();
+
+	void	HandleError( Error *e );
+	void	OutputStat( StrDict *values );
+
+	int	Failed()			{ return failed;	}
+	Error *	GetError()			{ return &error;	}
+
+	int	ChangeCount()			{ return nChanges;	}
+	int	GetChange( int i )		{ return changes[ i ];	}
+
+    private:
+	P4Index *	index;
+	Mode		mode;
+	Error		error;
+	int		failed;
+
+	int *		changes;
+	int		nChanges;
+	int		maxChanges;
+};
@@ -0,0 +1,176 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4intern.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Interning of short, repetitive values in tagged output.
+ *
+ ******************************************************************************/
+
+#include <clientapi.h>
+
+#ifdef OS_NT
+# include <math.h>
+#endif
+
+extern "C" 
+{
+#include "EXTERN.h"
+#include "perl.h"
+#include "XSUB.h"
+}
+#ifdef Error
+// Defined by older versions of Perl to be Perl_Error
+# undef Error
+#endif
+
+#include "p4intern.h"
+
+//
+// Copies that share a buffer are made from shared hash key scalars,
+// which can't be got at before Perl 5.10. There, I_COPY does nothing and
+// I_SHARED uses ordinary scalars.
+//
+#ifdef SvSHARED_HEK_FROM_PV
+# define P4INTERN_HEK
+#endif
+
+//
+// Limits. Only values up to MAX_LENGTH bytes are interned, and no more
+// than MAX_ENTRIES of them per command. After TRIAL lookups, a field 
+// whose values have been found in the table less than half the time
+// is no longer interned.
+//
+enum 
+{
+    MAX_LENGTH	= 64,
+    MAX_ENTRIES	= 16384,
+    MAX_FIELDS	= 256,
+    TRIAL	= 1024
+};
+
+P4Interner::P4Interner()
+{
+    mode = I_OFF;
+    values = newHV();
+    fields = newHV();
+    stats = new FieldStats[ MAX_FIELDS ];
+    nStats = 0;
+    lookups = hits = entries = 0;
+}
+
+P4Interner::~P4Interner()
+{
+    SvREFCNT_dec( (SV *) values );
+    SvREFCNT_dec( (SV *) fields );
+    delete [] stats;
+}
+
+void
+P4Interner::Reset()
+{
+    // The SVs we've handed out keep their own references
+    SvREFCNT_dec( (SV *) values );
+    values = newHV();
+    hv_clear( fields );
+    nStats = 0;
+    lookups = hits = entries = 0;
+}
+
+SV *
+P4Interner::Get( const StrPtr &field, const char *val, int len )
+{
+    if( mode == I_OFF || len > MAX_LENGTH )
+	return 0;
+
+#ifndef P4INTERN_HEK
+    if( mode == I_COPY )
+	return 0;
+#endif
+
+    SV **	svp = hv_fetch( fields, field.Text(), field.Length(), 0 );
+    int		idx;
+
+    if( svp )
+	idx = SvIV( *svp );
+    else
+    {
+	if( nStats == MAX_FIELDS )
+	    return 0;
+
+	idx = nStats++;
+	stats[ idx ].lookups = 0;
+	stats[ idx ].hits = 0;
+	hv_store( fields, field.Text(), field.Length(), newSViv( idx ), 0 );
+    }
+
+    FieldStats	&fs = stats[ idx ];
+    if( fs.lookups >= TRIAL && fs.hits * 2 < fs.lookups )
+	return 0;
+
+    fs.lookups++;
+    lookups++;
+
+    SV *	sv;
+    if( ( svp = hv_fetch( values, val, len, 0 ) ) )
+    {
+	fs.hits++;
+	hits++;
+	sv = *svp;
+    }
+    else
+    {
+	if( entries >= MAX_ENTRIES )
+	    return 0;
+
+#ifdef P4INTERN_HEK
+	// Shared hash key scalars can be copied by sharing their buffer
+	sv = newSVpvn_share( val, len, 0 );
+#else
+	sv = newSVpvn( val, len );
+#endif
+	if( mode == I_SHARED )
+	    SvREADONLY_on( sv );
+
+	hv_store( values, val, len, sv, 0 );
+	entries++;
+    }
+
+    if( mode == I_SHARED )
+	return SvREFCNT_inc( sv );
+
+#ifdef P4INTERN_HEK
+    // A new scalar sharing the key's buffer. It gets a buffer of its own
+    // if it's ever modified.
+    return newSVhek( SvSHARED_HEK_FROM_PV( SvPVX( sv ) ) );
+#else
+    return 0;
+#endif
+}
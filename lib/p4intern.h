@@ -0,0 +1,89 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4intern.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Interning of short, repetitive values in tagged output.
+ * 		  Fields like headAction, headType, action and user take
+ * 		  only a handful of distinct values across millions of
+ * 		  records, so instead of a new string for every one, we
+ * 		  keep a table of the values seen during the command and
+ * 		  hand out either copies that share the string buffer, or
+ * 		  the very same read-only SV.
+ *
+ * 		  The table is bounded in size, and fields whose values
+ * 		  turn out not to repeat (file names, digests) are left
+ * 		  alone after a trial period.
+ *
+ ******************************************************************************/
+
+class P4Interner
+{
+    public:
+	enum Mode
+	{
+	    I_OFF,		// No interning
+	    I_COPY,		// Copies share the string buffer
+	    I_SHARED		// The same read-only SV is used for every copy
+	};
+
+		P4Interner();
+		~P4Interner();
+
+	void	SetMode( int m )	{ mode = m;		}
+	int	GetMode()		{ return mode;		}
+
+	// Start afresh for a new command. The statistics are kept until
+	// the next command so they can be reported.
+	void	Reset();
+
+	// Returns a new SV for the value, or 0 if it's not being interned
+	SV *	Get( const StrPtr &field, const char *val, int len );
+
+	IV	Lookups()		{ return lookups;	}
+	IV	Hits()			{ return hits;		}
+	IV	Entries()		{ return entries;	}
+
+    private:
+	struct FieldStats
+	{
+	    IV	lookups;
+	    IV	hits;
+	};
+
+	int		mode;
+	HV *		values;
+	HV *		fields;		// field name -> index into stats
+	FieldStats *	stats;
+	int		nStats;
+	IV		lookups;
+	IV		hits;
+	IV		entries;
+};
@@ -0,0 +1,554 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4iterator.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Page-at-a-time iteration with next-page prefetch. Must
+ * 		  not use Perl in any way as pages are fetched on a thread
+ * 		  of their own.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <clientapi.h>
+#include "p4perlsys.h"
+#include "p4breaker.h"
+#include "bufferedclientuser.h"
+#include "p4iterator.h"
+
+//
+// Page size limits. A page that comes back quickly (and isn't too big)
+// means the next one can be twice the size; a slow or bulky one halves it.
+//
+static const int	DEFAULT_PAGE	= 1000;
+static const int	MIN_PAGE	= 50;
+static const int	MAX_PAGE	= 100000;
+static const double	MAX_BYTES	= 4.0 * 1024 * 1024;
+static const double	FAST_PAGE	= 0.5;
+static const double	SLOW_PAGE	= 2.0;
+
+//
+// The commands we can iterate over, the options of theirs that take a
+// value, and the field in their output that continuation is based on.
+//
+static const struct IterCommand
+{
+    const char *	name;
+    int			kind;
+    const char *	valueOptions;
+    const char *	key;
+} iterCommands[] = {
+    { "changes",	0,	"cemsu",	"change"	},
+    { "changelists",	0,	"cemsu",	"change"	},
+    { "jobs",		1,	"em",		"Job"		},
+    { "filelog",	2,	"cm",		"depotFile"	},
+    { "fstat",		3,	"ceFmTA",	"depotFile"	},
+    { 0, 0, 0, 0 }
+};
+
+static const IterCommand *
+LookupCommand( const char *cmd )
+{
+    for( const IterCommand *c = iterCommands; c->name; c++ )
+	if( !strcmp( c->name, cmd ) )
+	    return c;
+    return 0;
+}
+
+//
+// Add a value to a jobs -e or fstat -F expression, escaping anything
+// that has a meaning of its own in a jobview.
+//
+static void
+AppendEscaped( StrBuf &expr, const StrPtr &value )
+{
+    for( const char *p = value.Text(); *p; p++ )
+    {
+	if( strchr( " \t\\()|&^*=<>~!\"", *p ) )
+	    expr.Append( "\\" );
+	expr.Append( p, 1 );
+    }
+}
+
+//
+// Whether a -T field list (comma or space separated) includes a field
+//
+static int
+HasField( const char *list, const char *field )
+{
+    int	len = strlen( field );
+
+    for( const char *p = list; *p; )
+    {
+	int n = strcspn( p, ", " );
+	if( n == len && !strncmp( p, field, len ) )
+	    return 1;
+	p += n;
+	p += strspn( p, ", " );
+    }
+    return 0;
+}
+
+StrBuf *
+P4Iterator::ArgList::Add()
+{
+    if( n == max )
+    {
+	int	m = max ? max * 2 : 8;
+	StrBuf	*nv = new StrBuf[ m ];
+
+	for( int i = 0; i < n; i++ )
+	    nv[ i ] = v[ i ];
+
+	delete [] v;
+	v = nv;
+	max = m;
+    }
+
+    StrBuf *s = &v[ n++ ];
+    s->Clear();
+    return s;
+}
+
+char * const *
+P4Iterator::ArgList::Argv()
+{
+    delete [] argv;
+    argv = new char *[ n + 1 ];
+    for( int i = 0; i < n; i++ )
+	argv[ i ] = v[ i ].Text();
+    argv[ n ] = 0;
+    return argv;
+}
+
+P4Iterator::P4Iterator( ClientApi *client, const char *cmd, int argc,
+			char * const *argv, const char *prog )
+{
+    this->client = client;
+    this->cmd.Set( cmd );
+    this->prog.Set( prog );
+
+    kind = I_CHANGES;
+    key = 0;
+    problem = 0;
+    fetchSize = 0;
+    fetchSeconds = 0;
+    fetching = 0;
+    current = 0;
+    pageSize = DEFAULT_PAGE;
+    pages = 0;
+    waited = 0;
+
+    Parse( argc, argv );
+    if( problem )
+	return;
+
+    // Get the first page on its way straight away
+    BuildArgs();
+    StartFetch();
+}
+
+P4Iterator::~P4Iterator()
+{
+    thread.Join();
+    delete fetching;
+    delete current;
+
+    Error	e;
+    client->Final( &e );
+    delete client;
+}
+
+int
+P4Iterator::Supported( const char *cmd )
+{
+    return LookupCommand( cmd ) != 0;
+}
+
+//
+// Split the caller's arguments into options and paths, taking out the
+// ones we'll be supplying ourselves: -m, and the -e or -F expression that
+// continuation adds to.
+//
+void
+P4Iterator::Parse( int argc, char * const *argv )
+{
+    const IterCommand *c = LookupCommand( cmd.Text() );
+    if( !c )
+    {
+	problem = "Iteration is only supported for changes, jobs, "
+		  "filelog and fstat";
+	return;
+    }
+    kind = (Kind) c->kind;
+    key = c->key;
+
+    int	i;
+    int	submitted = 0;
+    for( i = 0; i < argc && argv[ i ][ 0 ] == '-'; i++ )
+    {
+	const char *a = argv[ i ];
+	const char *val = 0;
+
+	if( !strcmp( a, "--" ) )
+	{
+	    i++;
+	    break;
+	}
+
+	// The value may be the next argument or run on from the flag
+	if( a[ 1 ] && strchr( c->valueOptions, a[ 1 ] ) )
+	    val = a[ 2 ] ? a + 2 : i + 1 < argc ? argv[ ++i ] : "";
+
+	if( a[ 1 ] == 'm' )
+	{
+	    if( atoi( val ) > 0 )
+		pageSize = atoi( val );
+	    continue;
+	}
+
+	if( ( kind == I_JOBS && a[ 1 ] == 'e' ) ||
+	    ( kind == I_FSTAT && a[ 1 ] == 'F' ) )
+	{
+	    userExpr.Set( val );
+	    continue;
+	}
+
+	if( kind != I_FILELOG && a[ 1 ] == 'r' && !a[ 2 ] )
+	    problem = "Can't iterate over output in reverse order";
+
+	if( kind == I_FSTAT && a[ 1 ] == 'S' )
+	    problem = "Can't iterate over fstat output sorted with -S";
+
+	if( kind == I_CHANGES && a[ 1 ] == 's' )
+	{
+	    if( strcmp( val, "submitted" ) )
+		problem = "Can't iterate over pending or shelved changes";
+	    submitted = 1;
+	}
+
+	// Continuation needs every record's depotFile
+	if( kind == I_FSTAT && a[ 1 ] == 'T' )
+	{
+	    StrBuf	fields;
+
+	    fields.Set( val );
+	    if( !HasField( fields.Text(), key ) )
+	    {
+		if( fields.Length() )
+		    fields << ",";
+		fields << key;
+	    }
+
+	    opts.Add()->Set( "-T" );
+	    opts.Add()->Set( fields );
+	    continue;
+	}
+
+	if( val )
+	{
+	    opts.Add()->Set( a, 2 );
+	    opts.Add()->Set( val );
+	}
+	else
+	    opts.Add()->Set( a );
+    }
+
+    for( ; i < argc; i++ )
+	paths.Add()->Set( argv[ i ] );
+
+    //
+    // Later pages of changes are asked for with a revision range, which
+    // only matches submitted changes, so those are all the first page 
+    // can have too.
+    //
+    if( kind == I_CHANGES && !submitted )
+    {
+	opts.Add()->Set( "-s" );
+	opts.Add()->Set( "submitted" );
+    }
+
+    // fstat output is only in depotFile order for a single argument
+    if( kind == I_FSTAT && paths.n != 1 )
+	problem = "fstat iteration needs exactly one file argument";
+
+    if( kind == I_FILELOG )
+	for( i = 0; i < paths.n; i++ )
+	    pending.Add()->Set( paths.v[ i ] );
+}
+
+//
+// Work out the arguments for the next page from the caller's options
+// and where the last page left off.
+//
+void
+P4Iterator::BuildArgs()
+{
+    int		i;
+    StrBuf	*s;
+
+    args.Clear();
+    for( i = 0; i < opts.n; i++ )
+	args.Add()->Set( opts.v[ i ] );
+
+    args.Add()->Set( "-m" );
+    s = args.Add();
+    *s << pageSize;
+
+    switch( kind )
+    {
+    case I_CHANGES:
+	if( !last.Length() )
+	{
+	    for( i = 0; i < paths.n; i++ )
+		args.Add()->Set( paths.v[ i ] );
+	    break;
+	}
+
+	// Keep any lower bound; the upper one is just below the last
+	// change we've seen.
+	if( !paths.n )
+	{
+	    s = args.Add();
+	    s->Set( "//...@" );
+	    *s << last.Atoi() - 1;
+	}
+
+	for( i = 0; i < paths.n; i++ )
+	{
+	    const char *p = paths.v[ i ].Text();
+	    const char *rev = strpbrk( p, "@#" );
+	    const char *comma = rev ? strchr( rev, ',' ) : 0;
+
+	    s = args.Add();
+	    if( comma )
+		s->Set( p, comma + 1 - p );
+	    else if( rev )
+		s->Set( p, rev - p );
+	    else
+		s->Set( p );
+
+	    s->Append( "@" );
+	    *s << last.Atoi() - 1;
+	}
+	break;
+
+    case I_JOBS:
+    case I_FSTAT:
+	{
+	    StrBuf	expr;
+
+	    if( userExpr.Length() )
+		expr << "(" << userExpr << ")";
+
+	    if( last.Length() )
+	    {
+		if( expr.Length() )
+		    expr << " ";
+		expr << ( kind == I_JOBS ? "Job>" : "depotFile>" );
+		AppendEscaped( expr, last );
+	    }
+
+	    if( expr.Length() )
+	    {
+		args.Add()->Set( kind == I_JOBS ? "-e" : "-F" );
+		args.Add()->Set( expr );
+	    }
+
+	    for( i = 0; i < paths.n; i++ )
+		args.Add()->Set( paths.v[ i ] );
+	}
+	break;
+
+    case I_FILELOG:
+	for( i = 0; i < pending.n; i++ )
+	    args.Add()->Set( pending.v[ i ] );
+	break;
+    }
+}
+
+//
+// Look through a page to see where the next one starts. Returns 0 if
+// this was the last page.
+//
+int
+P4Iterator::Continue( BufferedClientUser *page )
+{
+    if( kind == I_FILELOG )
+    {
+	pending.Clear();
+	page->EachStat( FilelogRecord, this );
+	return pending.n;
+    }
+
+    // A short page is the last one
+    if( page->StatCount() < fetchSize )
+	return 0;
+
+    StrBuf	prev = last;
+    page->EachStat( LastRecord, this );
+
+    // Guard against looping if the server didn't move us on
+    if( !last.Length() || last == prev )
+	return 0;
+
+    return kind != I_CHANGES || last.Atoi() > 1;
+}
+
+void
+P4Iterator::LastRecord( StrDict *d, void *arg )
+{
+    P4Iterator	*it = (P4Iterator *) arg;
+    StrPtr	*v = d->GetVar( it->key );
+
+    if( v )
+	it->last.Set( *v );
+}
+
+//
+// A file that returned as many revisions as we asked for may have more;
+// ask for it again from the revision before the oldest one we've seen.
+//
+void
+P4Iterator::FilelogRecord( StrDict *d, void *arg )
+{
+    P4Iterator	*it = (P4Iterator *) arg;
+    StrPtr	*file = d->GetVar( "depotFile" );
+    StrPtr	*rev = 0;
+    StrPtr	*r;
+    StrBuf	key;
+    int		n;
+
+    if( !file )
+	return;
+
+    for( n = 0; ; n++ )
+    {
+	key.Clear();
+	key << "rev" << n;
+	if( !( r = d->GetVar( key ) ) )
+	    break;
+	rev = r;
+    }
+
+    if( n < it->fetchSize || !rev || rev->Atoi() <= 1 )
+	return;
+
+    StrBuf *s = it->pending.Add();
+    s->Set( *file );
+    s->Append( "#" );
+    *s << rev->Atoi() - 1;
+}
+
+void
+P4Iterator::Adapt( BufferedClientUser *page )
+{
+    double	bytes = page->Bytes();
+
+    if( fetchSeconds < FAST_PAGE && bytes * 2 <= MAX_BYTES &&
+	pageSize < MAX_PAGE )
+    {
+	pageSize *= 2;
+	if( pageSize > MAX_PAGE )
+	    pageSize = MAX_PAGE;
+    }
+    else if( ( fetchSeconds > SLOW_PAGE || bytes > MAX_BYTES ) &&
+	     pageSize > MIN_PAGE )
+    {
+	pageSize /= 2;
+	if( pageSize < MIN_PAGE )
+	    pageSize = MIN_PAGE;
+    }
+}
+
+BufferedClientUser *
+P4Iterator::NextPage( KeepAlive *alive )
+{
+    delete current;
+    current = 0;
+
+    if( !fetching )
+	return 0;
+
+    double	start = P4PerlSys::Now();
+    breaker.Reset( alive );
+    breaker.Join( thread );
+    waited += P4PerlSys::Now() - start;
+
+    current = fetching;
+    fetching = 0;
+    pages++;
+
+    // Set the next page going before handing this one over
+    if( !breaker.Stopped() && !current->ErrorCount() && Continue( current ) )
+    {
+	Adapt( current );
+	BuildArgs();
+	StartFetch();
+    }
+
+    return current;
+}
+
+void
+P4Iterator::StartFetch()
+{
+    fetching = new BufferedClientUser;
+    fetchSize = pageSize;
+
+    client->SetBreak( breaker.ForWorker() );
+    if( thread.Start( FetchThread, this ) )
+	return;
+
+    client->SetBreak( breaker.ForCaller() );
+    Fetch();
+}
+
+void
+P4Iterator::FetchThread( void *arg )
+{
+    ( (P4Iterator *) arg )->Fetch();
+}
+
+void
+P4Iterator::Fetch()
+{
+    double	start = P4PerlSys::Now();
+
+#if P4API_VERSION >= 513026
+    client->SetProg( prog.Text() );
+#endif
+    client->SetArgv( args.n, args.Argv() );
+    client->Run( cmd.Text(), fetching );
+
+    fetchSeconds = P4PerlSys::Now() - start;
+}
@@ -0,0 +1,150 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4iterator.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Page-at-a-time iteration over commands whose output can
+ * 		  be huge: changes, jobs, filelog and fstat. Each page is
+ * 		  fetched with -m on a connection of our own, and the
+ * 		  arguments for the next page are worked out from the
+ * 		  last records of the one before. While the caller works
+ * 		  through a page, the next one is fetched on a background
+ * 		  thread. The page size is adjusted as we go so that each
+ * 		  fetch takes between half a second and two seconds, and
+ * 		  no page grows beyond a few megabytes.
+ *
+ * 		  Continuation is by:
+ *
+ * 		  changes - the upper bound of each path becomes @N,
+ * 		            where N is one less than the last change seen.
+ * 		  jobs    - "Job>last" is added to the -e expression.
+ * 		  fstat   - "depotFile>last" is added to the -F filter.
+ * 		  filelog - every file that filled its quota is asked for
+ * 		            again, from the revision before its last one.
+ *
+ * 		  Must not use Perl in any way as pages are fetched on a
+ * 		  thread of their own.
+ *
+ ******************************************************************************/
+
+class BufferedClientUser;
+
+class P4Iterator
+{
+    public:
+		// Takes ownership of the client, which must be initialised
+		P4Iterator( ClientApi *client, const char *cmd, int argc,
+			    char * const *argv, const char *prog );
+		~P4Iterator();
+
+	// Is this a command we know how to continue?
+	static int	Supported( const char *cmd );
+
+	// If the arguments can't be iterated over, says why. Otherwise 0.
+	const char *	Problem()		{ return problem;	}
+
+	// The next page of output, or 0 when there are no more. The page
+	// belongs to the iterator and is valid until the next call. If
+	// alive (only called on this thread) says to stop while we wait
+	// for it, the page is cut short and is the last.
+	BufferedClientUser *	NextPage( KeepAlive *alive = 0 );
+
+	const char *	Command()		{ return cmd.Text();	}
+	int		Pages()			{ return pages;		}
+	int		PageSize()		{ return pageSize;	}
+	double		Waited()		{ return waited;	}
+
+    private:
+	enum Kind { I_CHANGES, I_JOBS, I_FILELOG, I_FSTAT };
+
+	// A list of arguments, and the char * array to pass them with
+	struct ArgList
+	{
+			ArgList()	{ v = 0; argv = 0; n = max = 0; }
+			~ArgList()	{ delete [] v; delete [] argv; }
+
+	    void	Clear()		{ n = 0; }
+	    StrBuf *	Add();
+	    char * const *Argv();
+
+	    StrBuf *	v;
+	    char **	argv;
+	    int		n;
+	    int		max;
+	};
+
+	void		Parse( int argc, char * const *argv );
+	void		BuildArgs();
+	int		Continue( BufferedClientUser *page );
+	void		Adapt( BufferedClientUser *page );
+
+	void		StartFetch();
+	void		Fetch();
+	static void	FetchThread( void *arg );
+
+	static void	LastRecord( StrDict *d, void *arg );
+	static void	FilelogRecord( StrDict *d, void *arg );
+
+    private:
+	ClientApi *	client;
+	StrBuf		cmd;
+	StrBuf		prog;
+	Kind		kind;
+	const char *	key;
+	const char *	problem;
+
+	// The caller's options (less -m, -e or -F) and paths, and the
+	// expression they gave with -e or -F.
+	ArgList		opts;
+	ArgList		paths;
+	StrBuf		userExpr;
+
+	// Where the next page starts: the last change, job or depot file
+	// seen (from the key field of the last record), or (filelog) the
+	// revisions still to come.
+	StrBuf		last;
+	ArgList		pending;
+
+	// The page being fetched, and the arguments it was run with
+	ArgList		args;
+	int		fetchSize;
+	double		fetchSeconds;
+	BufferedClientUser *fetching;
+	P4Thread	thread;
+	P4Breaker	breaker;
+
+	// The page the caller is working through
+	BufferedClientUser *current;
+
+	int		pageSize;
+	int		pages;
+	double		waited;
+};
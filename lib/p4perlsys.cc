@@ -0,0 +1,722 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4perlsys.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Thin portability layer for the few operating system
+ * 		  services P4Perl needs itself.
+ *
+ ******************************************************************************/
+
+#ifdef OS_NT
+# include <windows.h>
+# include <process.h>
+#else
+# include <pthread.h>
+# include <dirent.h>
+# include <sys/mman.h>
+# include <sys/resource.h>
+# include <sys/stat.h>
+# include <sys/time.h>
+# include <errno.h>
+# include <fcntl.h>
+# include <time.h>
+# include <unistd.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "p4perlsys.h"
+
+#ifdef OS_NT
+
+P4Mutex::P4Mutex()
+{
+    CRITICAL_SECTION *cs = new CRITICAL_SECTION;
+    InitializeCriticalSection( cs );
+    handle = cs;
+}
+
+P4Mutex::~P4Mutex()
+{
+    DeleteCriticalSection( (CRITICAL_SECTION *) handle );
+    delete (CRITICAL_SECTION *) handle;
+}
+
+void
+P4Mutex::Lock()
+{
+    EnterCriticalSection( (CRITICAL_SECTION *) handle );
+}
+
+void
+P4Mutex::Unlock()
+{
+    LeaveCriticalSection( (CRITICAL_SECTION *) handle );
+}
+
+void
+P4Mutex::AfterFork()
+{
+    // No fork() on Windows
+}
+
+#else
+
+//
+// Recursive, as critical sections are on Windows, so that a Perl callback
+// run while a lock is held can call back into us without deadlocking.
+//
+static void
+InitMutex( pthread_mutex_t *m )
+{
+    pthread_mutexattr_t	attr;
+
+    pthread_mutexattr_init( &attr );
+    pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( m, &attr );
+    pthread_mutexattr_destroy( &attr );
+}
+
+P4Mutex::P4Mutex()
+{
+    pthread_mutex_t *m = new pthread_mutex_t;
+    InitMutex( m );
+    handle = m;
+}
+
+P4Mutex::~P4Mutex()
+{
+    pthread_mutex_destroy( (pthread_mutex_t *) handle );
+    delete (pthread_mutex_t *) handle;
+}
+
+void
+P4Mutex::Lock()
+{
+    pthread_mutex_lock( (pthread_mutex_t *) handle );
+}
+
+void
+P4Mutex::Unlock()
+{
+    pthread_mutex_unlock( (pthread_mutex_t *) handle );
+}
+
+void
+P4Mutex::AfterFork()
+{
+    InitMutex( (pthread_mutex_t *) handle );
+}
+
+#endif
+
+//
+// Trampoline between the native thread entry point and our P4ThreadFunc.
+// A class only so that it can be a friend of P4Thread.
+//
+class P4ThreadStarter
+{
+    public:
+#ifdef OS_NT
+    static unsigned __stdcall Run( void *t )
+#else
+    static void * Run( void *t )
+#endif
+    {
+	P4Thread *thread = (P4Thread *) t;
+	thread->func( thread->arg );
+	thread->finished = 1;
+	return 0;
+    }
+};
+
+P4Thread::P4Thread()
+{
+    handle = 0;
+    func = 0;
+    arg = 0;
+    finished = 0;
+}
+
+P4Thread::~P4Thread()
+{
+    Join();
+}
+
+int
+P4Thread::Start( P4ThreadFunc f, void *a )
+{
+    if( handle )
+	return 0;
+
+    func = f;
+    arg = a;
+    finished = 0;
+
+#ifdef OS_NT
+    uintptr_t h = _beginthreadex( 0, 0, P4ThreadStarter::Run, this, 0, 0 );
+    handle = (void *) h;
+#else
+    pthread_t *t = new pthread_t;
+    if( pthread_create( t, 0, P4ThreadStarter::Run, this ) )
+	delete t;
+    else
+	handle = t;
+#endif
+    return handle != 0;
+}
+
+void
+P4Thread::Join()
+{
+    if( !handle )
+	return;
+
+#ifdef OS_NT
+    WaitForSingleObject( (HANDLE) handle, INFINITE );
+    CloseHandle( (HANDLE) handle );
+#else
+    pthread_join( *(pthread_t *) handle, 0 );
+    delete (pthread_t *) handle;
+#endif
+    handle = 0;
+}
+
+double
+P4PerlSys::Now()
+{
+#ifdef OS_NT
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+void
+P4PerlSys::Sleep( int ms )
+{
+#ifdef OS_NT
+    ::Sleep( ms );
+#else
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = ( ms % 1000 ) * 1000000L;
+    nanosleep( &ts, 0 );
+#endif
+}
+
+int
+P4PerlSys::GetPid()
+{
+#ifdef OS_NT
+    return (int) GetCurrentProcessId();
+#else
+    return (int) getpid();
+#endif
+}
+
+int
+P4PerlSys::Rename( const char *from, const char *to )
+{
+#ifdef OS_NT
+    return MoveFileEx( from, to, MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+    return rename( from, to ) == 0;
+#endif
+}
+
+int
+P4PerlSys::ReadLink( const char *path, char *buf, int len )
+{
+#ifdef OS_NT
+    return -1;
+#else
+    return (int) readlink( path, buf, len );
+#endif
+}
+
+FILE *
+P4PerlSys::OpenPrivate( const char *path )
+{
+#ifdef OS_NT
+    // Files under the user's profile are private to them already
+    return fopen( path, "wb" );
+#else
+    //
+    // Always a new file: one that's there already may have looser
+    // permissions, or be a link somewhere else, planted by someone else.
+    // So we take it away and try again, once.
+    //
+    int	fd = -1;
+
+    for( int attempt = 0; fd < 0 && attempt < 2; attempt++ )
+    {
+	fd = open( path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0600 );
+	if( fd < 0 && ( errno != EEXIST || unlink( path ) < 0 ) )
+	    return 0;
+    }
+
+    if( fd < 0 )
+	return 0;
+
+    FILE	*fp = fdopen( fd, "w" );
+    if( !fp )
+	close( fd );
+    return fp;
+#endif
+}
+
+P4MappedFile::P4MappedFile()
+{
+    data = 0;
+    size = 0;
+    handle = 0;
+}
+
+P4MappedFile::~P4MappedFile()
+{
+    Unmap();
+}
+
+int
+P4MappedFile::Map( const char *path )
+{
+    Unmap();
+
+#ifdef OS_NT
+    HANDLE f = CreateFile( path, GENERIC_READ, FILE_SHARE_READ, 0,
+			   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+    if( f == INVALID_HANDLE_VALUE )
+	return 0;
+
+    LARGE_INTEGER sz;
+    HANDLE m = 0;
+    if( GetFileSizeEx( f, &sz ) && sz.QuadPart )
+	m = CreateFileMapping( f, 0, PAGE_READONLY, 0, 0, 0 );
+    CloseHandle( f );
+    if( !m )
+	return 0;
+
+    data = (const char *) MapViewOfFile( m, FILE_MAP_READ, 0, 0, 0 );
+    if( !data )
+    {
+	CloseHandle( m );
+	return 0;
+    }
+    size = (size_t) sz.QuadPart;
+    handle = m;
+#else
+    int fd = open( path, O_RDONLY );
+    if( fd < 0 )
+	return 0;
+
+    struct stat st;
+    void *p = MAP_FAILED;
+    if( !fstat( fd, &st ) && st.st_size )
+	p = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( p == MAP_FAILED )
+	return 0;
+
+    data = (const char *) p;
+    size = st.st_size;
+#endif
+    return 1;
+}
+
+void
+P4MappedFile::Unmap()
+{
+    if( !data )
+	return;
+
+#ifdef OS_NT
+    UnmapViewOfFile( data );
+    CloseHandle( (HANDLE) handle );
+#else
+    munmap( (void *) data, size );
+#endif
+    data = 0;
+    size = 0;
+    handle = 0;
+}
+
+P4Dir::P4Dir()
+{
+    handle = 0;
+    name = 0;
+    type = D_OTHER;
+    size = 0;
+    modTime = 0;
+    first = 0;
+#ifdef OS_NT
+    data = new WIN32_FIND_DATA;
+#endif
+}
+
+P4Dir::~P4Dir()
+{
+    Close();
+#ifdef OS_NT
+    delete (WIN32_FIND_DATA *) data;
+#endif
+}
+
+#ifdef OS_NT
+
+int
+P4Dir::Open( const char *path )
+{
+    Close();
+
+    int		l = strlen( path );
+    char	*pattern = new char[ l + 3 ];
+
+    memcpy( pattern, path, l );
+    strcpy( pattern + l, "\\*" );
+
+    HANDLE h = FindFirstFile( pattern, (WIN32_FIND_DATA *) data );
+    delete [] pattern;
+
+    if( h == INVALID_HANDLE_VALUE )
+	return 0;
+
+    handle = h;
+    first = 1;
+    return 1;
+}
+
+void
+P4Dir::Close()
+{
+    if( handle )
+	FindClose( (HANDLE) handle );
+    handle = 0;
+}
+
+int
+P4Dir::Next()
+{
+    WIN32_FIND_DATA	*d = (WIN32_FIND_DATA *) data;
+
+    for( ;; )
+    {
+	if( !handle )
+	    return 0;
+
+	if( !first && !FindNextFile( (HANDLE) handle, d ) )
+	    return 0;
+	first = 0;
+
+	name = d->cFileName;
+	if( !strcmp( name, "." ) || !strcmp( name, ".." ) )
+	    continue;
+
+	if( d->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT )
+	    type = D_LINK;
+	else if( d->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+	    type = D_DIR;
+	else
+	    type = D_FILE;
+
+	size = ( (long long) d->nFileSizeHigh << 32 ) | d->nFileSizeLow;
+
+	// FILETIMEs are in 100ns units since 1601
+	long long t = ( (long long) d->ftLastWriteTime.dwHighDateTime << 32 ) |
+		      d->ftLastWriteTime.dwLowDateTime;
+	modTime = t / 10000000 - 11644473600LL;
+	return 1;
+    }
+}
+
+#else
+
+int
+P4Dir::Open( const char *path )
+{
+    Close();
+    handle = opendir( path );
+    return handle != 0;
+}
+
+void
+P4Dir::Close()
+{
+    if( handle )
+	closedir( (DIR *) handle );
+    handle = 0;
+}
+
+int
+P4Dir::Next()
+{
+    struct dirent	*e;
+    struct stat		st;
+
+    while( handle && ( e = readdir( (DIR *) handle ) ) )
+    {
+	name = e->d_name;
+	if( !strcmp( name, "." ) || !strcmp( name, ".." ) )
+	    continue;
+
+	// Relative to the directory, so there's no path to build
+	if( fstatat( dirfd( (DIR *) handle ), name, &st, 
+		     AT_SYMLINK_NOFOLLOW ) < 0 )
+	    continue;
+
+	if( S_ISLNK( st.st_mode ) )
+	    type = D_LINK;
+	else if( S_ISDIR( st.st_mode ) )
+	    type = D_DIR;
+	else if( S_ISREG( st.st_mode ) )
+	    type = D_FILE;
+	else
+	    type = D_OTHER;
+
+	size = st.st_size;
+	modTime = st.st_mtime;
+	return 1;
+    }
+    return 0;
+}
+
+#endif
+
+P4Mutex			P4Sockets::lock;
+P4Mutex			P4Sockets::window;
+P4Sockets::List		P4Sockets::known;
+int			P4Sockets::ownerPid = P4PerlSys::GetPid();
+
+P4Sockets::P4Sockets()
+{
+    inWindow = 0;
+}
+
+P4Sockets::~P4Sockets()
+{
+    if( inWindow )
+	window.Unlock();
+}
+
+P4Sockets::List::List()
+{
+    entries = 0;
+    count = 0;
+    max = 0;
+}
+
+P4Sockets::List::~List()
+{
+    delete [] entries;
+}
+
+void
+P4Sockets::List::Add( int fd, unsigned long long dev, unsigned long long ino )
+{
+    if( count == max )
+    {
+	int	m = max ? max * 2 : 16;
+	Entry	*n = new Entry[ m ];
+
+	for( int i = 0; i < count; i++ )
+	    n[ i ] = entries[ i ];
+
+	delete [] entries;
+	entries = n;
+	max = m;
+    }
+
+    Entry &e = entries[ count++ ];
+    e.fd = fd;
+    e.dev = dev;
+    e.ino = ino;
+}
+
+int
+P4Sockets::List::Has( const Entry &e )
+{
+    for( int i = 0; i < count; i++ )
+	if( entries[ i ].fd == e.fd && entries[ i ].dev == e.dev && 
+	    entries[ i ].ino == e.ino )
+	    return 1;
+    return 0;
+}
+
+#ifdef OS_NT
+
+void P4Sockets::Before()	{}
+void P4Sockets::After()		{}
+void P4Sockets::Detach()	{}
+
+#else
+
+static int
+IsSocket( int fd, struct stat *st )
+{
+    return fstat( fd, st ) == 0 && S_ISSOCK( st->st_mode );
+}
+
+//
+// Every socket we have open. Where there's a /proc, it lists just the
+// descriptors in use; otherwise we try each one we're allowed.
+//
+void
+P4Sockets::ListSockets( List &l )
+{
+    struct stat	st;
+    DIR		*d = opendir( "/proc/self/fd" );
+    int		fd;
+
+    if( d )
+    {
+	struct dirent	*e;
+
+	while( ( e = readdir( d ) ) )
+	{
+	    if( e->d_name[ 0 ] < '0' || e->d_name[ 0 ] > '9' )
+		continue;
+
+	    fd = atoi( e->d_name );
+	    if( fd != dirfd( d ) && IsSocket( fd, &st ) )
+		l.Add( fd, st.st_dev, st.st_ino );
+	}
+	closedir( d );
+	return;
+    }
+
+    struct rlimit	rl;
+    long		n = -1;
+
+    if( getrlimit( RLIMIT_NOFILE, &rl ) == 0 && rl.rlim_cur != RLIM_INFINITY )
+	n = (long) rl.rlim_cur;
+    if( n <= 0 )
+	n = sysconf( _SC_OPEN_MAX );
+    if( n <= 0 )
+	n = 1024;
+
+    for( fd = 0; fd < n; fd++ )
+	if( IsSocket( fd, &st ) )
+	    l.Add( fd, st.st_dev, st.st_ino );
+}
+
+//
+// The thread that held a lock may not have survived a fork
+//
+void
+P4Sockets::CheckFork()
+{
+    int	pid = getpid();
+
+    if( pid == ownerPid )
+	return;
+
+    lock.AfterFork();
+    window.AfterFork();
+    ownerPid = pid;
+}
+
+void
+P4Sockets::Before()
+{
+    CheckFork();
+
+    window.Lock();
+    inWindow = 1;
+
+    before.count = 0;
+    ListSockets( before );
+}
+
+void
+P4Sockets::After()
+{
+    struct stat	st;
+    List	now;
+    int		i, n;
+
+    if( !inWindow )
+	return;
+
+    ListSockets( now );
+
+    {
+	P4Lock	l( lock );
+
+	// Forget sockets that have been closed since, so the list only
+	// ever holds what's open now
+	for( i = n = 0; i < known.count; i++ )
+	{
+	    Entry &e = known.entries[ i ];
+	    if( IsSocket( e.fd, &st ) && st.st_dev == e.dev && 
+		st.st_ino == e.ino )
+		known.entries[ n++ ] = e;
+	}
+	known.count = n;
+
+	for( i = 0; i < now.count; i++ )
+	    if( !before.Has( now.entries[ i ] ) )
+		known.Add( now.entries[ i ].fd, now.entries[ i ].dev, 
+			   now.entries[ i ].ino );
+    }
+
+    inWindow = 0;
+    window.Unlock();
+}
+
+void
+P4Sockets::Detach()
+{
+    struct stat	st;
+
+    CheckFork();
+
+    P4Lock	l( lock );
+
+    int	null = open( "/dev/null", O_RDWR );
+    if( null < 0 )
+	return;
+
+    for( int i = 0; i < known.count; i++ )
+    {
+	Entry &e = known.entries[ i ];
+	if( IsSocket( e.fd, &st ) && st.st_dev == e.dev && 
+	    st.st_ino == e.ino )
+	    dup2( null, e.fd );
+    }
+
+    close( null );
+    known.count = 0;
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4perlsys.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Thin portability layer for the few operating system
+ * 		  services P4Perl needs itself: clocks, sleeping, process
+ * 		  ids, mutexes, native threads, memory-mapped files,
+ * 		  directory listings and inherited sockets. Nothing in here may
+ * 		  touch Perl data as it's used from non-Perl threads.
+ *
+ ******************************************************************************/
+
+//
+// A recursive mutex: the thread holding it may lock it again.
+//
+class P4Mutex
+{
+    public:
+		P4Mutex();
+		~P4Mutex();
+
+	void	Lock();
+	void	Unlock();
+
+	// Only for use in a newly forked child. Any lock held by a thread
+	// which didn't survive the fork is discarded.
+	void	AfterFork();
+
+    private:
+	void *	handle;
+};
+
+//
+// Scoped lock. Holds the mutex for the lifetime of the object.
+//
+class P4Lock
+{
+    public:
+		P4Lock( P4Mutex &m ) : mutex( m )	{ mutex.Lock();   }
+		~P4Lock()				{ mutex.Unlock(); }
+
+    private:
+	P4Mutex &	mutex;
+};
+
+typedef void (*P4ThreadFunc)( void *arg );
+
+class P4Thread
+{
+    public:
+		P4Thread();
+		~P4Thread();
+
+	// Returns 0 if the thread could not be started
+	int	Start( P4ThreadFunc func, void *arg );
+	void	Join();
+	int	IsRunning()		{ return handle != 0;	}
+
+	// Whether a thread that was started has returned. It still has
+	// to be joined.
+	int	IsFinished()		{ return finished;	}
+
+	// After a fork() the child has no threads, so we must forget
+	// about them without attempting to join them.
+	void	Forget()		{ handle = 0;		}
+
+    private:
+	void *		handle;
+	P4ThreadFunc	func;
+	void *		arg;
+	volatile int	finished;
+
+	friend class P4ThreadStarter;
+};
+
+//
+// A whole file mapped read-only into memory
+//
+class P4MappedFile
+{
+    public:
+		P4MappedFile();
+		~P4MappedFile();
+
+	// Returns 0 if the file could not be opened or mapped
+	int		Map( const char *path );
+	void		Unmap();
+
+	const char *	Data()			{ return data;		}
+	size_t		Size()			{ return size;		}
+
+    private:
+	const char *	data;
+	size_t		size;
+	void *		handle;
+};
+
+//
+// Reading a directory. Entries come back one at a time, without "." and
+// "..", along with their type, size and modification time (in seconds
+// since the epoch). Symbolic links are not followed.
+//
+class P4Dir
+{
+    public:
+	enum Type { D_FILE, D_DIR, D_LINK, D_OTHER };
+
+		P4Dir();
+		~P4Dir();
+
+	// Returns 0 if the directory could not be opened
+	int		Open( const char *path );
+	void		Close();
+
+	// Moves on to the next entry. Returns 0 at the end.
+	int		Next();
+
+	const char *	Name()			{ return name;		}
+	int		GetType()		{ return type;		}
+	long long	Size()			{ return size;		}
+	long long	ModTime()		{ return modTime;	}
+
+    private:
+	void *		handle;
+	const char *	name;
+	int		type;
+	long long	size;
+	long long	modTime;
+	int		first;
+#ifdef OS_NT
+	void *		data;
+#endif
+};
+
+//
+// The sockets of the connections we keep. A forked child inherits them
+// but mustn't send anything on them, as its parent is still using them.
+// Detach() swaps them all for /dev/null, after which the ClientApi 
+// objects can be closed and deleted as usual without the parent seeing
+// a thing. Sockets are known by their inode as well as their descriptor,
+// so any that have been closed since (and the descriptor reused) are
+// left alone. A no-op on Windows, which has no fork().
+//
+class P4Sockets
+{
+    public:
+			P4Sockets();
+			~P4Sockets();
+
+	// Around making a connection: any socket that appears in between
+	// is taken to be the connection's. Only one thread at a time may
+	// be between the two, so that it doesn't take another's socket.
+	void		Before();
+	void		After();
+
+	// In a newly forked child
+	static void	Detach();
+
+    private:
+	struct Entry
+	{
+	    int			fd;
+	    unsigned long long	dev;
+	    unsigned long long	ino;
+	};
+
+	class List
+	{
+	    public:
+				List();
+				~List();
+
+		void		Add( int fd, unsigned long long dev, 
+				     unsigned long long ino );
+		int		Has( const Entry &e );
+
+		Entry *		entries;
+		int		count;
+		int		max;
+	};
+
+	static void	ListSockets( List &l );
+	static void	CheckFork();
+
+	List		before;
+	int		inWindow;
+
+	static P4Mutex	lock;
+	static P4Mutex	window;
+	static List	known;
+	static int	ownerPid;
+};
+
+class P4PerlSys
+{
+    public:
+	// Seconds since an arbitrary point, with sub-second resolution
+	static double	Now();
+	static void	Sleep( int milliseconds );
+	static int	GetPid();
+
+	// Replaces 'to' if it exists. Returns 0 on failure.
+	static int	Rename( const char *from, const char *to );
+
+	// The target of a symbolic link. Returns its length, or -1.
+	static int	ReadLink( const char *path, char *buf, int len );
+
+	// Creates a new file for writing that only its owner can read,
+	// replacing any file (or link) of that name. Returns 0 on failure.
+	static FILE *	OpenPrivate( const char *path );
+};
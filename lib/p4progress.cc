@@ -0,0 +1,195 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4progress.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Progress tracking for long-running commands.
+ *
+ ******************************************************************************/
+
+#include <clientapi.h>
+#include "p4perlsys.h"
+#include "p4progress.h"
+
+P4ProgressStats::P4ProgressStats()
+{
+    interval = 1.0;
+    Start();
+}
+
+void
+P4ProgressStats::Start()
+{
+    start = lastReport = P4PerlSys::Now();
+    outputFiles = outputBytes = 0;
+    progressFiles = progressBytes = 0;
+    totalFiles = totalBytes = 0;
+    description.Clear();
+    nSamples = nextSample = 0;
+    Sample();
+}
+
+void
+P4ProgressStats::OutputFile( double size )
+{
+    outputFiles++;
+    outputBytes += size;
+}
+
+//
+// Both sources count the same files and bytes, but either may be missing
+// (older APIs have no progress indicators; tagged output may not include
+// sizes), so we report whichever has got further.
+//
+double
+P4ProgressStats::Files()
+{
+    return outputFiles > progressFiles ? outputFiles : progressFiles;
+}
+
+double
+P4ProgressStats::Bytes()
+{
+    return outputBytes > progressBytes ? outputBytes : progressBytes;
+}
+
+double
+P4ProgressStats::Elapsed()
+{
+    return P4PerlSys::Now() - start;
+}
+
+int
+P4ProgressStats::Due()
+{
+    double now = P4PerlSys::Now();
+    if( now - lastReport < interval )
+	return 0;
+
+    lastReport = now;
+    Sample();
+    return 1;
+}
+
+void
+P4ProgressStats::Sample()
+{
+    sampleTime[ nextSample ] = P4PerlSys::Now();
+    sampleBytes[ nextSample ] = Bytes();
+    nextSample = ( nextSample + 1 ) % SAMPLES;
+    if( nSamples < SAMPLES )
+	nSamples++;
+}
+
+//
+// The rate over the last few samples, so that a collapse in throughput
+// shows up quickly rather than being averaged away.
+//
+double
+P4ProgressStats::Rate()
+{
+    if( nSamples < 2 )
+	return AverageRate();
+
+    int	newest = ( nextSample + SAMPLES - 1 ) % SAMPLES;
+    int	oldest = ( nextSample + SAMPLES - nSamples ) % SAMPLES;
+    double t = sampleTime[ newest ] - sampleTime[ oldest ];
+
+    return t > 0 ? ( sampleBytes[ newest ] - sampleBytes[ oldest ] ) / t : 0;
+}
+
+double
+P4ProgressStats::AverageRate()
+{
+    double t = Elapsed();
+    return t > 0 ? Bytes() / t : 0;
+}
+
+#if P4API_VERSION >= 515073
+
+P4ClientProgress::P4ClientProgress( int t, P4ProgressStats *s,
+				    P4ProgressFunc f, void *a )
+{
+    type = t;
+    units = CPU_UNSPECIFIED;
+    last = 0;
+    stats = s;
+    func = f;
+    arg = a;
+}
+
+void
+P4ClientProgress::Description( const StrPtr *desc, int u )
+{
+    units = u;
+    last = 0;
+    if( desc )
+	stats->SetDescription( desc->Text() );
+}
+
+void
+P4ClientProgress::Total( long total )
+{
+    if( type == CPT_FILESTRANS || units == CPU_FILES )
+	stats->SetTotalFiles( total );
+}
+
+int
+P4ClientProgress::Update( long position )
+{
+    switch( units )
+    {
+    case CPU_FILES:
+	stats->FilesDone( position );
+	break;
+    case CPU_KBYTES:
+	stats->BytesDone( ( position - last ) * 1024.0 );
+	break;
+    case CPU_MBYTES:
+	stats->BytesDone( ( position - last ) * 1048576.0 );
+	break;
+    default:
+	if( type == CPT_FILESTRANS )
+	    stats->FilesDone( position );
+	break;
+    }
+    last = position;
+
+    func( arg );
+    return 0;
+}
+
+void
+P4ClientProgress::Done( int fail )
+{
+    func( arg );
+}
+
+#endif
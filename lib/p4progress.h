@@ -0,0 +1,124 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+/*******************************************************************************
+ * Name		: p4progress.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Progress tracking for long-running commands such as a
+ * 		  big sync or print. Counts files and bytes from both the
+ * 		  command's output and (with 2012.1 or later APIs) the
+ * 		  API's own progress indicators, keeps a rolling transfer
+ * 		  rate and says when it's time to report again.
+ *
+ ******************************************************************************/
+
+class P4ProgressStats
+{
+    public:
+		P4ProgressStats();
+
+	void	Start();
+	void	SetInterval( double seconds )	{ interval = seconds;	}
+
+	// From the command's output
+	void	OutputFile( double size );
+	void	OutputBytes( double n )		{ outputBytes += n;	}
+
+	// From the API's progress indicators
+	void	SetDescription( const char *d )	{ description = d;	}
+	void	SetTotalFiles( double n )	{ totalFiles = n;	}
+	void	SetTotalBytes( double n )	{ totalBytes = n;	}
+	void	FilesDone( double n )		{ progressFiles = n;	}
+	void	BytesDone( double n )		{ progressBytes += n;	}
+
+	// Returns true (and takes a sample for the rate) if a report is due
+	int	Due();
+	void	Sample();
+
+	// Figures for reporting
+	double	Files();
+	double	Bytes();
+	double	TotalFiles()			{ return totalFiles;	}
+	double	TotalBytes()			{ return totalBytes;	}
+	double	Elapsed();
+	double	Rate();				// Rolling bytes per second
+	double	AverageRate();
+	const StrPtr &	Description()		{ return description;	}
+
+    private:
+	enum { SAMPLES = 8 };
+
+	double	start;
+	double	interval;
+	double	lastReport;
+
+	double	outputFiles;
+	double	outputBytes;
+	double	progressFiles;
+	double	progressBytes;
+	double	totalFiles;
+	double	totalBytes;
+	StrBuf	description;
+
+	// Ring buffer of ( time, bytes ) samples for the rolling rate
+	double	sampleTime[ SAMPLES ];
+	double	sampleBytes[ SAMPLES ];
+	int	nSamples;
+	int	nextSample;
+};
+
+#if P4API_VERSION >= 515073
+
+//
+// ClientProgress implementation handed to the API by CreateProgress(). 
+// Feeds the stats and calls back whenever something changes.
+//
+typedef void (*P4ProgressFunc)( void *arg );
+
+class P4ClientProgress : public ClientProgress
+{
+    public:
+		P4ClientProgress( int type, P4ProgressStats *s,
+				  P4ProgressFunc f, void *arg );
+
+	void	Description( const StrPtr *desc, int units );
+	void	Total( long total );
+	int	Update( long position );
+	void	Done( int fail );
+
+    private:
+	int			type;
+	int			units;
+	long			last;
+	P4ProgressStats *	stats;
+	P4ProgressFunc		func;
+	void *			arg;
+};
+
+#endif
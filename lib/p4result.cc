@@ -35,6 +35,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * Description	: Ruby class for holding results of Perforce commands 
  *
  ******************************************************************************/
+#include <string.h>
 #include <clientapi.h>
 
 #ifdef OS_NT
@@ -53,28 +54,69 @@ extern "C"
 #endif
 
 #include "p4perldebug.h"
+#include "p4perlsys.h"
+#include "p4utf8.h"
+#include "p4breaker.h"
+#include "p4splitter.h"
+#include "p4ticketcache.h"
 #include "p4result.h"
 
 P4Result::P4Result()
 {
     merged = 0;
+    mergeOutput = 0;
+    utf8 = 0;
     debug  = 0;
+    limitHit = 0;
+    authFailed = 0;
+    records = 0;
+    maxRecords = 0;
+    bytes = 0;
+    maxBytes = 0;
+    pending = 0;
     output = newAV();
     errors = newAV();
     warnings = newAV();
+    messages = 0;
+    nMessages = 0;
+    maxMessages = 0;
+    nFormatted = 0;
+    nErrors = 0;
+    nWarnings = 0;
+    memset( genericCounts, 0, sizeof( genericCounts ) );
 }
 
 P4Result::~P4Result()
 {
     Clear();
+    delete [] messages;
 }
 
+//
+// Release our references to the result arrays. Callers may still hold
+// references to them (Run() returns a reference to the output array), so
+// they must not be emptied, just let go of.
+//
 void
 P4Result::Clear()
 {
-    av_undef( output );
-    av_undef( warnings );
-    av_undef( errors );
+    Flush();
+    SvREFCNT_dec( (SV *) output );
+    SvREFCNT_dec( (SV *) warnings );
+    SvREFCNT_dec( (SV *) errors );
+
+    for( int i = 0; i < nMessages; i++ )
+	delete messages[ i ].error;
+
+    nMessages = 0;
+    nFormatted = 0;
+    nErrors = 0;
+    nWarnings = 0;
+    limitHit = 0;
+    authFailed = 0;
+    records = 0;
+    bytes = 0;
+    memset( genericCounts, 0, sizeof( genericCounts ) );
 }
 
 void
@@ -97,7 +139,12 @@ P4Result::AddOutput( const char *msg )
     if( P4PERL_DEBUG_DATA )
 	printf( "[P4Result::AddOutput]: %s\n", msg );
 
-    av_push( output, newSVpv( msg, 0 ) );
+    int	len = strlen( msg );
+
+    Flush();
+    av_push( output, NewString( msg, len ) );
+    records++;
+    bytes += len;
 }
 
 void
@@ -106,15 +153,100 @@ P4Result::AddOutput( SV * out )
     if( P4PERL_DEBUG_DATA )
 	printf( "[P4Result::AddOutput]: (perl object)\n" );
 
+    Flush();
     av_push( output, out );
+    records++;
+    if( SvPOK( out ) )
+	bytes += SvCUR( out );
+}
+
+//
+// Create a string value. In UTF-8 mode, strings that hold well-formed
+// UTF-8 beyond plain ASCII come back with the UTF-8 flag already on, so
+// callers don't have to decode them again. Pure ASCII needs no flag, and
+// anything that isn't valid UTF-8 is left as bytes.
+//
+SV *
+P4Result::NewString( const char *p, int len )
+{
+    SV *sv = newSVpvn( p, len );
+
+    if( utf8 && P4Utf8::Scan( p, len ) == P4Utf8::U_VALID )
+	SvUTF8_on( sv );
+
+    return sv;
 }
 
+//
+// Add a chunk of file content (from 'p4 print' etc.). Normally each chunk
+// becomes a result element of its own. With output merging enabled, the
+// chunks are copied straight from the API's buffer into one growing
+// scalar, which is only added to the results once something else arrives
+// (or the results are fetched). That way a large file costs us one copy
+// and one scalar rather than a scalar per chunk.
+//
 void
-P4Result::AddError( Error *e )
+P4Result::AddText( const char *data, int length )
 {
-    StrBuf	m;
-    e->Fmt( &m );
+    if( P4PERL_DEBUG_DATA )
+	printf( "[P4Result::AddText]: %d bytes\n", length );
+
+    bytes += length;
+
+    if( !mergeOutput )
+    {
+	av_push( output, newSVpvn( data, length ) );
+	records++;
+	return;
+    }
+
+    if( !pending )
+    {
+	pending = newSVpvn( "", 0 );
+	records++;
+    }
+
+    // Grow by half as much again each time to keep reallocations rare
+    STRLEN	need = SvCUR( pending ) + length + 1;
+    if( SvLEN( pending ) < need )
+	SvGROW( pending, need + need / 2 );
 
+    sv_catpvn( pending, data, length );
+}
+
+void
+P4Result::Flush()
+{
+    if( !pending )
+	return;
+
+    SvPV_shrink_to_cur( pending );
+    av_push( output, pending );
+    pending = 0;
+}
+
+void
+P4Result::SetBudget( int r, double b )
+{
+    maxRecords = r > 0 ? r : 0;
+    maxBytes = b > 0 ? b : 0;
+}
+
+int
+P4Result::OverBudget()
+{
+    if( maxRecords && records >= maxRecords )
+	return B_RECORDS;
+
+    if( maxBytes && bytes >= maxBytes )
+	return B_BYTES;
+
+    return B_NONE;
+}
+
+void
+P4Result::AddError( Error *e )
+{
     int s;
     s = e->GetSeverity();
 
@@ -126,22 +258,146 @@ P4Result::AddError( Error *e )
 
     if ( s == E_EMPTY || s == E_INFO )
     {
+	StrBuf	m;
+	e->Fmt( &m );
 	AddOutput( m.Text() );
 	return;
     }
 
+    Flush();
+
     if( P4PERL_DEBUG_DATA )
-	printf( "[P4Result::AddError]: %s\n", m.Text() );
+	printf( "[P4Result::AddError]: severity %d, generic %d\n", 
+		s, e->GetGeneric() );
+
+    //
+    // Formatting a message costs far more than copying it, and scripts
+    // often only want to know how many of each kind there were, so we
+    // just keep a copy until the text is asked for.
+    //
+    if( nMessages == maxMessages )
+    {
+	int	 m = maxMessages ? maxMessages * 2 : 16;
+	Message	*nm = new Message[ m ];
+
+	for( int i = 0; i < nMessages; i++ )
+	    nm[ i ] = messages[ i ];
 
-    if ( s == E_WARN && !merged )
-	av_push( warnings, newSVpv( m.Text(), 0 ) );
+	delete [] messages;
+	messages = nm;
+	maxMessages = m;
+    }
+
+    Message &msg = messages[ nMessages++ ];
+    msg.error = new Error;
+    *msg.error = *e;
+    msg.warning = ( s == E_WARN && !merged );
+
+    if( msg.warning )
+	nWarnings++;
     else
-	av_push( errors, newSVpv( m.Text(), 0 ) );
+	nErrors++;
+
+    genericCounts[ e->GetGeneric() & 0xff ]++;
+
+    // Noted so that the command can be split up and run again
+    if( P4Splitter::IsLimitError( e ) )
+	limitHit = 1;
+
+    // ... or after logging in again
+    if( P4TicketCache::IsAuthError( e ) )
+	authFailed = 1;
+}
+
+//
+// Format any messages we haven't yet into the warnings and errors arrays
+//
+void
+P4Result::Format()
+{
+    for( ; nFormatted < nMessages; nFormatted++ )
+    {
+	Message &msg = messages[ nFormatted ];
+	StrBuf	m;
+
+	msg.error->Fmt( &m );
+	av_push( msg.warning ? warnings : errors, 
+		 NewString( m.Text(), m.Length() ) );
+    }
+}
+
+I32
+P4Result::MessageCount( int generic )
+{
+    if( generic < 0 )
+	return nMessages;
+
+    return generic < 256 ? genericCounts[ generic ] : 0;
+}
+
+AV *
+P4Result::GetMessages( int generic, int code, int text )
+{
+    AV *	av = newAV();
+
+    for( int i = 0; i < nMessages; i++ )
+    {
+	Error	*e = messages[ i ].error;
+	ErrorId	*id = e->GetId( 0 );
+
+	if( generic >= 0 && e->GetGeneric() != generic )
+	    continue;
+
+	if( code && ( !id || id->UniqueCode() != code ) )
+	    continue;
+
+	av_push( av, newRV_noinc( (SV *) MessageHash( e, text ) ) );
+    }
+    return av;
+}
+
+HV *
+P4Result::MessageHash( Error *e, int text )
+{
+    HV *	hv = newHV();
+    ErrorId *	id = e->GetId( 0 );
+    StrDict *	dict = e->GetDict();
+
+    hv_store( hv, "severity", 8, newSViv( e->GetSeverity() ), 0 );
+    hv_store( hv, "generic", 7, newSViv( e->GetGeneric() ), 0 );
+
+    if( id )
+    {
+	hv_store( hv, "code", 4, newSViv( id->UniqueCode() ), 0 );
+	hv_store( hv, "subsystem", 9, newSViv( id->Subsystem() ), 0 );
+	hv_store( hv, "subcode", 7, newSViv( id->SubCode() ), 0 );
+    }
+
+    if( dict )
+    {
+	HV *	args = newHV();
+	StrRef	var, val;
+
+	for( int i = 0; dict->GetVar( i, var, val ); i++ )
+	    hv_store( args, var.Text(), var.Length(), 
+		      NewString( val.Text(), val.Length() ), 0 );
+
+	hv_store( hv, "args", 4, newRV_noinc( (SV *) args ), 0 );
+    }
+
+    if( text )
+    {
+	StrBuf	m;
+	e->Fmt( &m );
+	hv_store( hv, "text", 4, NewString( m.Text(), m.Length() ), 0 );
+    }
+    return hv;
 }
 
 I32
 P4Result::OutputCount()
 {
+    Flush();
     return av_len( output ) + 1;
 }
 
@@ -149,12 +405,12 @@ P4Result::OutputCount()
 I32
 P4Result::ErrorCount()
 {
-    return av_len( errors ) + 1;
+    return nErrors;
 }
 
 I32
 P4Result::WarningCount()
 {
-    return av_len( warnings ) + 1;
+    return nWarnings;
 }
 
@@ -45,18 +45,56 @@ class P4Result
     // Setting
     void	AddOutput( const char *msg );
     void	AddOutput( SV * out );
+    void	AddText( const char *data, int length );
     void	AddError( Error *e );
 
-    // Getting
-    AV *	GetOutput()	{ return output;	}
-    AV *	GetErrors()	{ return errors;	}
-    AV *	GetWarnings()	{ return warnings;	}
+    // Output merging: consecutive text/binary chunks are collected into
+    // a single scalar instead of one scalar per chunk.
+    void	SetMergeOutput( int m )	{ mergeOutput = m;	}
+    int		IsMergeOutput()		{ return mergeOutput;	}
+
+    // UTF-8 mode: text from the server is flagged as UTF-8 where it
+    // contains any. File content (AddText()) is never flagged.
+    void	SetUtf8( int u )	{ utf8 = u;		}
+    int		IsUtf8()		{ return utf8;		}
+    SV *	NewString( const char *p, int len );
+
+    // Getting. Warnings and errors are kept as Error objects and only
+    // formatted when they're asked for.
+    AV *	GetOutput()	{ Flush(); return output;	}
+    AV *	GetErrors()	{ Format(); return errors;	}
+    AV *	GetWarnings()	{ Format(); return warnings;	}
+
+    // Structured access to the warnings and errors. Messages can be
+    // picked out by generic code (EV_EMPTY etc.) and/or unique code
+    // without formatting them. A generic of -1 means any.
+    I32		MessageCount( int generic = -1 );
+    AV *	GetMessages( int generic, int code, int text );
 
     // Testing
     I32		OutputCount();
     I32		ErrorCount();
     I32		WarningCount();
 
+    // Whether the server refused the command for going over the 
+    // maxresults or maxscanrows limits
+    int		LimitHit()		{ return limitHit;	}
+
+    // Whether it was refused because we need to log in
+    int		AuthFailed()		{ return authFailed;	}
+
+    // Output budget. Records and bytes received are counted, and
+    // OverBudget() says which limit (if any) has been reached: 
+    // B_RECORDS or B_BYTES. Tagged output isn't a string, so its size
+    // is added by the caller. Zero means no limit; limits survive Reset().
+    enum { B_NONE, B_RECORDS, B_BYTES };
+
+    void	SetBudget( int records, double bytes );
+    int		MaxRecords()		{ return maxRecords;	}
+    double	MaxBytes()		{ return maxBytes;	}
+    void	AddBytes( double b )	{ bytes += b;		}
+    int		OverBudget();
+
     // Clear previous results
     void	Reset(int merge=0);
 
@@ -65,11 +103,37 @@ class P4Result
 
     private:
     void	Clear();
+    void	Flush();
+    void	Format();
+    HV *	MessageHash( Error *e, int text );
 
     private:
+    struct Message
+    {
+	Error *	error;
+	int	warning;
+    };
+
     int		merged;
+    int		mergeOutput;
+    int		utf8;
     int		debug;
+    int		limitHit;
+    int		authFailed;
+    int		records;
+    int		maxRecords;
+    double	bytes;
+    double	maxBytes;
+    SV *	pending;
     AV *	output;
     AV *	warnings;
     AV *	errors;
+
+    Message *	messages;
+    int		nMessages;
+    int		maxMessages;
+    int		nFormatted;
+    int		nErrors;
+    int		nWarnings;
+    int		genericCounts[ 256 ];
 };
@@ -0,0 +1,273 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4router.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Choosing a replica for read-only commands. Must not use
+ * 		  Perl in any way.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <clientapi.h>
+#include "p4router.h"
+
+//
+// Weight given to the latest timing in each replica's moving average,
+// the longest we'll leave a failed replica alone for, and how often to 
+// ask a replica that was behind whether it's caught up yet.
+//
+static const double LATENCY_WEIGHT = 0.3;
+static const double MAX_BACKOFF = 60.0;
+static const double RECHECK_INTERVAL = 0.25;
+
+P4Router::P4Router()
+{
+    replicas = 0;
+    nReplicas = 0;
+    maxReplicas = 0;
+    lagWindow = 10.0;
+    lastWrite = 0;
+}
+
+P4Router::~P4Router()
+{
+    Disconnect();
+    delete [] replicas;
+}
+
+void
+P4Router::AddReplica( const char *port )
+{
+    if( nReplicas == maxReplicas )
+    {
+	maxReplicas = maxReplicas ? maxReplicas * 2 : 4;
+	Replica *n = new Replica[ maxReplicas ];
+	for( int i = 0; i < nReplicas; i++ )
+	{
+	    n[ i ] = replicas[ i ];
+	}
+	delete [] replicas;
+	replicas = n;
+    }
+
+    Replica &r = replicas[ nReplicas++ ];
+    r.port.Set( port );
+    r.client = 0;
+    r.probe = 0;
+    r.latency = 0;
+    r.commands = 0;
+    r.failures = 0;
+    r.downUntil = 0;
+    r.sync = SYNC_YES;
+    r.checkedAt = 0;
+}
+
+void
+P4Router::Disconnect()
+{
+    for( int i = 0; i < nReplicas; i++ )
+    {
+	Error	e;
+	if( replicas[ i ].client )
+	{
+	    replicas[ i ].client->Final( &e );
+	    delete replicas[ i ].client;
+	}
+	if( replicas[ i ].probe )
+	{
+	    replicas[ i ].probe->Final( &e );
+	    delete replicas[ i ].probe;
+	}
+	replicas[ i ].client = 0;
+	replicas[ i ].probe = 0;
+    }
+}
+
+int
+P4Router::IsUsable( Replica &r, double now )
+{
+    if( r.downUntil > now )
+	return 0;
+
+    switch( r.sync )
+    {
+    case SYNC_BEHIND:
+	return now - r.checkedAt >= RECHECK_INTERVAL;
+    case SYNC_NO_INFO:
+	return now - lastWrite >= lagWindow;
+    default:
+	return 1;
+    }
+}
+
+//
+// Replicas we've not timed yet are tried first, so that all of them get
+// measured; after that it's whichever has been quickest recently.
+//
+int
+P4Router::Pick( double now )
+{
+    int	best = -1;
+
+    for( int i = 0; i < nReplicas; i++ )
+    {
+	Replica &r = replicas[ i ];
+	if( !IsUsable( r, now ) )
+	    continue;
+
+	if( best < 0 )
+	    best = i;
+	else if( !r.commands && replicas[ best ].commands )
+	    best = i;
+	else if( r.commands && replicas[ best ].commands && 
+		 r.latency < replicas[ best ].latency )
+	    best = i;
+    }
+    return best;
+}
+
+void
+P4Router::Success( int i, double seconds )
+{
+    Replica &r = replicas[ i ];
+
+    r.latency = r.commands ? 
+		r.latency + LATENCY_WEIGHT * ( seconds - r.latency ) : seconds;
+    r.commands++;
+    r.failures = 0;
+    r.downUntil = 0;
+}
+
+//
+// Back off exponentially from a replica that keeps failing. Its 
+// connections are left for the caller to replace.
+//
+void
+P4Router::Failure( int i, double now )
+{
+    Replica &r = replicas[ i ];
+    double	wait = 1.0;
+
+    for( int n = 0; n < r.failures && wait < MAX_BACKOFF; n++ )
+	wait *= 2;
+
+    r.failures++;
+    r.downUntil = now + ( wait < MAX_BACKOFF ? wait : MAX_BACKOFF );
+}
+
+void
+P4Router::NoteWrite( double now )
+{
+    lastWrite = now;
+    for( int i = 0; i < nReplicas; i++ )
+	replicas[ i ].sync = SYNC_UNKNOWN;
+}
+
+int
+P4Router::NeedsSyncCheck( int i )
+{
+    return replicas[ i ].sync == SYNC_UNKNOWN || 
+	   replicas[ i ].sync == SYNC_BEHIND;
+}
+
+//
+// Once the lag window has passed, a replica that can't report its
+// position is trusted again.
+//
+void
+P4Router::SyncResult( int i, int synced, double now )
+{
+    Replica &r = replicas[ i ];
+
+    r.checkedAt = now;
+    if( synced > 0 )
+	r.sync = SYNC_YES;
+    else if( synced < 0 )
+	r.sync = SYNC_NO_INFO;
+    else
+	r.sync = SYNC_BEHIND;
+}
+
+int
+P4Router::IsSynced( int i, double now )
+{
+    int	s = replicas[ i ].sync;
+
+    return s == SYNC_YES || 
+	   ( s == SYNC_NO_INFO && now - lastWrite >= lagWindow );
+}
+
+P4RouterUser::P4RouterUser()
+{
+    failed = 0;
+    seen = 0;
+    replica[ 0 ] = replica[ 1 ] = 0;
+    master[ 0 ] = master[ 1 ] = 0;
+}
+
+//
+// Servers have reported the journal numbers as both ...JournalNumber and
+// ...JournalCounter, so either will do.
+//
+void
+P4RouterUser::OutputStat( StrDict *values )
+{
+    static const char *fields[][ 2 ] = { 
+	{ "replicaJournalNumber", "replicaJournalCounter" },
+	{ "replicaJournalSequence", 0 },
+	{ "masterJournalNumber", "masterJournalCounter" },
+	{ "masterJournalSequence", 0 }
+    };
+    long long	*to[] = { replica, replica + 1, master, master + 1 };
+
+    for( int i = 0; i < 4; i++ )
+    {
+	StrPtr *v = values->GetVar( fields[ i ][ 0 ] );
+	if( !v && fields[ i ][ 1 ] )
+	    v = values->GetVar( fields[ i ][ 1 ] );
+	if( !v )
+	    continue;
+	*to[ i ] = atoll( v->Text() );
+	seen |= 1 << i;
+    }
+}
+
+int
+P4RouterUser::Synced()
+{
+    if( failed || seen != 0x0f )
+	return -1;
+
+    if( replica[ 0 ] != master[ 0 ] )
+	return replica[ 0 ] > master[ 0 ];
+    return replica[ 1 ] >= master[ 1 ];
+}
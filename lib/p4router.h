@@ -0,0 +1,134 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4router.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Routing of read-only commands to a set of replicas. 
+ * 		  Keeps a moving average of how long each replica takes to
+ * 		  answer, backs off from those that fail, and after a 
+ * 		  write holds reads on the primary until a replica has 
+ * 		  shown it's caught up. Must not use Perl in any way.
+ *
+ ******************************************************************************/
+
+class P4Router
+{
+    public:
+		P4Router();
+		~P4Router();
+
+	void		AddReplica( const char *port );
+	int		Count()			{ return nReplicas;	}
+	const StrPtr &	Port( int i )		{ return replicas[ i ].port; }
+
+	// How long after a write to wait for replicas that can't tell us
+	// whether they've caught up, in seconds.
+	void		SetLagWindow( double s ) { lagWindow = s;	}
+	double		LagWindow()		{ return lagWindow;	}
+
+	// Connections to each replica, made by the caller when first
+	// needed. The probe is a tagged one for checking replication.
+	ClientApi *	Client( int i )		{ return replicas[ i ].client; }
+	ClientApi *	Probe( int i )		{ return replicas[ i ].probe; }
+	void		SetClient( int i, ClientApi *c ) 
+			{ replicas[ i ].client = c; }
+	void		SetProbe( int i, ClientApi *c )
+			{ replicas[ i ].probe = c; }
+
+	void		Disconnect();
+
+	// The replica to send a read to, or -1 for the primary
+	int		Pick( double now );
+
+	// Results of using a replica
+	void		Success( int i, double seconds );
+	void		Failure( int i, double now );
+
+	// Read-your-writes. After a write, each replica must pass a sync
+	// check (or the lag window must pass) before it's used again.
+	void		NoteWrite( double now );
+	int		NeedsSyncCheck( int i );
+	void		SyncResult( int i, int synced, double now );
+
+	// For ReplicaStats()
+	double		Latency( int i )	{ return replicas[ i ].latency; }
+	int		Commands( int i )	{ return replicas[ i ].commands; }
+	int		Failures( int i )	{ return replicas[ i ].failures; }
+	int		IsHealthy( int i, double now )
+			{ return replicas[ i ].downUntil <= now; }
+	int		IsSynced( int i, double now );
+
+    private:
+	enum SyncState { SYNC_YES, SYNC_UNKNOWN, SYNC_BEHIND, SYNC_NO_INFO };
+
+	struct Replica
+	{
+	    StrBuf	port;
+	    ClientApi *	client;
+	    ClientApi *	probe;
+	    double	latency;	// Moving average, in seconds
+	    int		commands;
+	    int		failures;	// In a row
+	    double	downUntil;
+	    int		sync;
+	    double	checkedAt;
+	};
+
+	int		IsUsable( Replica &r, double now );
+
+    private:
+	Replica *	replicas;
+	int		nReplicas;
+	int		maxReplicas;
+	double		lagWindow;
+	double		lastWrite;
+};
+
+//
+// Captures the journal positions reported by 'pull -lj' on a replica
+//
+class P4RouterUser : public ClientUser
+{
+    public:
+		P4RouterUser();
+
+	void	HandleError( Error *e )			{ failed = 1;	}
+	void	OutputStat( StrDict *values );
+
+	// 1 if caught up, 0 if behind, -1 if it couldn't say
+	int	Synced();
+
+    private:
+	int		failed;
+	int		seen;
+	long long	replica[ 2 ];
+	long long	master[ 2 ];
+};
@@ -0,0 +1,629 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4scanner.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Parallel comparison of a workspace with the have list.
+ * 		  Must not use Perl in any way as the workers run on
+ * 		  threads of their own.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <clientapi.h>
+#include <md5.h>
+#include "p4perlsys.h"
+#include "p4arena.h"
+#include "p4scanner.h"
+
+#ifdef OS_NT
+# define SCAN_SEP	'\\'
+# define PathCompare	_stricmp
+#else
+# define SCAN_SEP	'/'
+# define PathCompare	strcmp
+#endif
+
+//
+// The keywords that are expanded in +k files. +ko files only have $Id$
+// and $Header$ expanded.
+//
+static const char *keywords[] = {
+    "Id", "Header", "Date", "DateUTC", "DateTime", "DateTimeUTC",
+    "DateTimeTZ", "Change", "File", "Revision", "Author", 0
+};
+
+//
+// For sorting paths, and Expected entries, which start with their path
+//
+static int
+ComparePaths( const void *a, const void *b )
+{
+    return PathCompare( *(const char **) a, *(const char **) b );
+}
+
+//
+// MD5::Update() takes a StrPtr, so large files go in slices
+//
+static void
+Update( MD5 &md5, const char *p, long long len )
+{
+    const long long	slice = 0x10000000;
+    StrRef		r;
+
+    for( ; len > 0; p += slice, len -= slice )
+    {
+	r.Set( (char *) p, (int)( len < slice ? len : slice ) );
+	md5.Update( r );
+    }
+}
+
+//
+// If p is at the start of an expanded keyword ("$Id: ... $"), returns
+// its length and the length of the keyword's name. Otherwise 0.
+//
+static int
+Keyword( const char *p, const char *e, int idOnly, int &nameLen )
+{
+    const char	*q = p + 1;
+
+    while( q < e && isalpha( (unsigned char) *q ) )
+	q++;
+
+    nameLen = q - p - 1;
+    if( !nameLen || q >= e || *q != ':' )
+	return 0;
+
+    int	k;
+    for( k = 0; keywords[ k ]; k++ )
+    {
+	if( idOnly && k > 1 )
+	    return 0;
+	if( (int) strlen( keywords[ k ] ) == nameLen && 
+	    !strncmp( keywords[ k ], p + 1, nameLen ) )
+	    break;
+    }
+    if( !keywords[ k ] )
+	return 0;
+
+    for( q++; q < e && *q != '$' && *q != '\n'; q++ )
+	;
+
+    return q < e && *q == '$' ? q + 1 - p : 0;
+}
+
+P4Scanner::P4Scanner()
+{
+    since = 0;
+    crlf = 0;
+    translated = 0;
+    expected = 0;
+    nExpected = 0;
+    maxExpected = 0;
+    dirs = 0;
+    nDirs = 0;
+    maxDirs = 0;
+    busy = 0;
+    toHash = 0;
+    nToHash = 0;
+    next = 0;
+    hashed = 0;
+    walkers = 0;
+    nWalkers = 0;
+    nFound = 0;
+    memset( lists, 0, sizeof( lists ) );
+}
+
+P4Scanner::~P4Scanner()
+{
+    for( int i = 0; i < nWalkers; i++ )
+	delete [] walkers[ i ].found;
+    for( int s = 0; s < S_COUNT; s++ )
+	delete [] lists[ s ].paths;
+
+    delete [] walkers;
+    delete [] expected;
+    delete [] dirs;
+    delete [] toHash;
+}
+
+void
+P4Scanner::SetRoot( const char *r )
+{
+    int	l = strlen( r );
+
+    // No trailing separator, unless that's all there is
+    while( l > 1 && ( r[ l - 1 ] == '/' || r[ l - 1 ] == SCAN_SEP ) )
+	l--;
+    root.Set( r, l );
+}
+
+void
+P4Scanner::AddFstat( StrDict *values, int opened )
+{
+    StrPtr	*path = values->GetVar( "clientFile" );
+    StrPtr	*type = values->GetVar( "headType" );
+    StrPtr	*size = values->GetVar( "fileSize" );
+    StrPtr	*digest = values->GetVar( "digest" );
+
+    if( !path )
+	return;
+
+    if( nExpected == maxExpected )
+    {
+	maxExpected = maxExpected ? maxExpected * 2 : 1024;
+	Expected *n = new Expected[ maxExpected ];
+	if( nExpected )
+	    memcpy( n, expected, nExpected * sizeof( Expected ) );
+	delete [] expected;
+	expected = n;
+    }
+
+    Expected &e = expected[ nExpected++ ];
+    e.path = arena.Dup( path->Text(), path->Length() );
+    e.size = size ? size->Atoi64() : -1;
+    e.digest[ 0 ] = 0;
+    e.flags = 0;
+    e.seen = 0;
+    e.state = S_SAME;
+    e.localSize = 0;
+
+    if( digest && digest->Length() == 32 )
+	memcpy( e.digest, digest->Text(), 33 );
+
+    // Opened files may be anything, so there's nothing to compare
+    if( opened || values->GetVar( "action" ) )
+    {
+	e.flags |= F_OPENED;
+	return;
+    }
+
+    if( !type )
+	return;
+
+    //
+    // The base type says whether it's text, the modifiers whether 
+    // keywords are expanded. The old ktext and kxtext types do both.
+    //
+    const char	*t = type->Text();
+    const char	*plus = strchr( t, '+' );
+    StrBuf	base;
+
+    base.Set( t, plus ? plus - t : type->Length() );
+
+    if( strstr( base.Text(), "text" ) )
+	e.flags |= F_TEXT;
+    if( base.Text()[ 0 ] == 'k' )
+	e.flags |= F_KEYWORDS;
+    if( strstr( base.Text(), "unicode" ) || strstr( base.Text(), "utf8" ) )
+	e.flags |= translated ? F_UNCHECKED : F_TEXT;
+    if( strstr( base.Text(), "utf16" ) )
+	e.flags |= F_UNCHECKED;
+    if( base == "symlink" )
+	e.flags |= F_SYMLINK;
+
+    for( const char *m = plus; m && *m; m++ )
+	if( *m == 'k' )
+	    e.flags |= m[ 1 ] == 'o' ? F_KEYID : F_KEYWORDS;
+}
+
+void
+P4Scanner::PushDir( const char *dir )
+{
+    P4Lock	l( lock );
+
+    if( nDirs == maxDirs )
+    {
+	maxDirs = maxDirs ? maxDirs * 2 : 256;
+	const char **n = new const char *[ maxDirs ];
+	if( nDirs )
+	    memcpy( n, dirs, nDirs * sizeof( const char * ) );
+	delete [] dirs;
+	dirs = n;
+    }
+    dirs[ nDirs++ ] = dir;
+}
+
+void
+P4Scanner::AddResult( int state, const char *path )
+{
+    List	&l = lists[ state ];
+
+    if( l.n == l.max )
+    {
+	l.max = l.max ? l.max * 2 : 64;
+	const char **n = new const char *[ l.max ];
+	if( l.n )
+	    memcpy( n, l.paths, l.n * sizeof( const char * ) );
+	delete [] l.paths;
+	l.paths = n;
+    }
+    l.paths[ l.n++ ] = path;
+}
+
+//
+// Walk the tree, then sort out what we've found. Everything that's
+// left to be hashed is shared out between the threads again. This
+// thread is one of the workers each time, so the scan gets done even
+// if no threads can be started.
+//
+void
+P4Scanner::Run( int threads )
+{
+    int		i, j;
+
+    if( threads < 1 )
+	threads = 1;
+
+    // Sorted, with any duplicates (from the opened list) merged
+    qsort( expected, nExpected, sizeof( Expected ), ComparePaths );
+    for( i = 0, j = 0; i < nExpected; i++ )
+    {
+	if( j && !PathCompare( expected[ j - 1 ].path, expected[ i ].path ) )
+	{
+	    expected[ j - 1 ].flags |= expected[ i ].flags & F_OPENED;
+	    continue;
+	}
+	expected[ j++ ] = expected[ i ];
+    }
+    nExpected = j;
+
+    P4Thread	*workers = new P4Thread[ threads ];
+
+    walkers = new Walker[ threads ];
+    nWalkers = threads;
+    for( i = 0; i < threads; i++ )
+    {
+	walkers[ i ].scanner = this;
+	walkers[ i ].found = 0;
+	walkers[ i ].n = 0;
+	walkers[ i ].max = 0;
+    }
+
+    busy = 0;
+    PushDir( root.Text() );
+
+    for( i = 1; i < threads; i++ )
+	workers[ i ].Start( WalkThread, &walkers[ i ] );
+    Walk( &walkers[ 0 ] );
+    for( i = 1; i < threads; i++ )
+	workers[ i ].Join();
+
+    for( i = 0; i < threads; i++ )
+    {
+	nFound += walkers[ i ].n;
+	for( j = 0; j < walkers[ i ].n; j++ )
+	    Match( walkers[ i ].found[ j ] );
+    }
+
+    for( i = 0; i < nExpected; i++ )
+	if( !expected[ i ].seen && !( expected[ i ].flags & F_OPENED ) )
+	    AddResult( S_MISSING, expected[ i ].path );
+
+    next = 0;
+    for( i = 1; i < threads && i < nToHash; i++ )
+	workers[ i ].Start( HashThread, this );
+    Hash();
+    for( i = 1; i < threads && i < nToHash; i++ )
+	workers[ i ].Join();
+
+    for( i = 0; i < nToHash; i++ )
+	if( toHash[ i ]->state != S_SAME )
+	    AddResult( toHash[ i ]->state, toHash[ i ]->path );
+
+    delete [] workers;
+
+    for( i = 0; i < S_COUNT; i++ )
+	if( lists[ i ].n )
+	    qsort( lists[ i ].paths, lists[ i ].n, sizeof( const char * ), 
+		   ComparePaths );
+}
+
+void
+P4Scanner::WalkThread( void *arg )
+{
+    Walker	*w = (Walker *) arg;
+    w->scanner->Walk( w );
+}
+
+void
+P4Scanner::HashThread( void *arg )
+{
+    ( (P4Scanner *) arg )->Hash();
+}
+
+//
+// Read directories until there are none left. When the list is empty 
+// but others are still reading, they may yet add more, so we wait.
+//
+void
+P4Scanner::Walk( Walker *w )
+{
+    P4Dir	d;
+
+    for( ;; )
+    {
+	const char	*dir = 0;
+	{
+	    P4Lock	l( lock );
+	    if( nDirs )
+	    {
+		dir = dirs[ --nDirs ];
+		busy++;
+	    }
+	    else if( !busy )
+		return;
+	}
+
+	if( !dir )
+	{
+	    P4PerlSys::Sleep( 1 );
+	    continue;
+	}
+
+	int	dl = strlen( dir );
+	int	sep = dl && ( dir[ dl - 1 ] == '/' || dir[ dl - 1 ] == SCAN_SEP );
+
+	for( int ok = d.Open( dir ); ok && d.Next(); )
+	{
+	    int		type = d.GetType();
+
+	    if( type == P4Dir::D_OTHER )
+		continue;
+
+	    int		nl = strlen( d.Name() );
+	    char	*p = w->arena.Alloc( dl + nl + 2 );
+
+	    memcpy( p, dir, dl );
+	    if( !sep )
+		p[ dl ] = SCAN_SEP;
+	    memcpy( p + dl + !sep, d.Name(), nl + 1 );
+
+	    if( type == P4Dir::D_DIR )
+	    {
+		PushDir( p );
+		continue;
+	    }
+
+	    if( w->n == w->max )
+	    {
+		w->max = w->max ? w->max * 2 : 1024;
+		Found *n = new Found[ w->max ];
+		if( w->n )
+		    memcpy( n, w->found, w->n * sizeof( Found ) );
+		delete [] w->found;
+		w->found = n;
+	    }
+
+	    Found &f = w->found[ w->n++ ];
+	    f.path = p;
+	    f.size = d.Size();
+	    f.modTime = d.ModTime();
+	    f.link = ( type == P4Dir::D_LINK );
+	}
+	d.Close();
+
+	P4Lock	l( lock );
+	busy--;
+    }
+}
+
+//
+// Decide what we can about a file from its size and time, and queue it
+// to be hashed if that's not enough.
+//
+void
+P4Scanner::Match( Found &f )
+{
+    Expected	key;
+    key.path = f.path;
+
+    Expected	*e = (Expected *) bsearch( &key, expected, nExpected, 
+					   sizeof( Expected ), 
+					   ComparePaths );
+    if( !e )
+    {
+	AddResult( S_EXTRA, f.path );
+	return;
+    }
+
+    e->seen = 1;
+    e->localSize = f.size;
+
+    if( e->flags & F_OPENED )
+	return;
+
+    if( e->flags & F_UNCHECKED || !e->digest[ 0 ] )
+    {
+	AddResult( S_UNCHECKED, e->path );
+	return;
+    }
+
+    if( f.link != !!( e->flags & F_SYMLINK ) )
+    {
+	AddResult( S_MODIFIED, e->path );
+	return;
+    }
+
+    // Unless something changes the content on the way to disk, a file 
+    // of the wrong size can't be the same.
+    int	exact = !( e->flags & F_SYMLINK ) && 
+		( !( e->flags & F_TEXT ) ||
+		  !( crlf || e->flags & ( F_KEYWORDS | F_KEYID ) ) );
+
+    if( exact && f.size != e->size )
+    {
+	AddResult( S_MODIFIED, e->path );
+	return;
+    }
+
+    if( since && f.modTime <= since )
+	return;
+
+    if( !toHash )
+	toHash = new Expected *[ nExpected ];
+    toHash[ nToHash++ ] = e;
+}
+
+void
+P4Scanner::Hash()
+{
+    StrBuf	digest;
+
+    for( ;; )
+    {
+	Expected	*e;
+	{
+	    P4Lock	l( lock );
+	    if( next >= nToHash )
+		return;
+	    e = toHash[ next++ ];
+	    hashed++;
+	}
+
+	if( !Digest( *e, digest ) )
+	    e->state = S_UNCHECKED;
+	else
+	{
+	    const char *a = digest.Text(), *b = e->digest;
+	    while( *a && toupper( (unsigned char) *a ) == 
+			 toupper( (unsigned char) *b ) )
+		a++, b++;
+	    e->state = *a || *b ? S_MODIFIED : S_SAME;
+	}
+    }
+}
+
+//
+// The MD5 digest of a file's content as the server would see it: text 
+// files without their CRs or expanded keywords, and symlinks as the 
+// path they point to. Returns 0 if the file can't be read.
+//
+int
+P4Scanner::Digest( Expected &e, StrBuf &digest )
+{
+    MD5		md5;
+
+    if( e.flags & F_SYMLINK )
+    {
+	char	buf[ 4096 ];
+	int	l = P4PerlSys::ReadLink( e.path, buf, sizeof( buf ) );
+	if( l < 0 )
+	    return 0;
+	Update( md5, buf, l );
+	md5.Final( digest );
+	return 1;
+    }
+
+    P4MappedFile	f;
+
+    if( !f.Map( e.path ) )
+    {
+	if( e.localSize )
+	    return 0;
+
+	// An empty file, which can't be mapped
+	md5.Final( digest );
+	return 1;
+    }
+
+    const char	*p = f.Data();
+    const char	*end = p + f.Size();
+    int		text = ( e.flags & F_TEXT );
+    int		keys = text && ( e.flags & ( F_KEYWORDS | F_KEYID ) );
+    int		idOnly = !( e.flags & F_KEYWORDS );
+    int		cr = text && crlf;
+
+    if( !keys && !cr )
+    {
+	Update( md5, p, end - p );
+	md5.Final( digest );
+	return 1;
+    }
+
+    const char	*span = p;
+    int		n, nameLen;
+
+    while( p < end )
+    {
+	if( cr && *p == '\r' && p + 1 < end && p[ 1 ] == '\n' )
+	{
+	    Update( md5, span, p - span );
+	    span = ++p;
+	    continue;
+	}
+
+	if( keys && *p == '$' && ( n = Keyword( p, end, idOnly, nameLen ) ) )
+	{
+	    Update( md5, span, p - span + 1 + nameLen );
+	    Update( md5, "$", 1 );
+	    p += n;
+	    span = p;
+	    continue;
+	}
+	p++;
+    }
+    Update( md5, span, p - span );
+    md5.Final( digest );
+    return 1;
+}
+
+P4ScanUser::P4ScanUser( P4Scanner *scanner, int opened )
+{
+    this->scanner = scanner;
+    this->opened = opened;
+    failed = 0;
+}
+
+//
+// Warnings such as "file(s) not on client" just mean there's nothing
+// to compare
+//
+void
+P4ScanUser::HandleError( Error *e )
+{
+    if( e->IsInfo() || e->IsWarning() || failed )
+	return;
+
+    error = *e;
+    failed = 1;
+}
+
+void
+P4ScanUser::OutputStat( StrDict *values )
+{
+    if( StrPtr *r = values->GetVar( "clientRoot" ) )
+	clientRoot.Set( r );
+
+    scanner->AddFstat( values, opened );
+}
@@ -0,0 +1,193 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4scanner.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Comparison of a workspace with what the server thinks
+ * 		  it holds. The files we have are loaded from fstat, then
+ * 		  the client root is walked by a pool of threads. Files
+ * 		  whose size or modification time leave any doubt are 
+ * 		  hashed, also in parallel, and their MD5 digests 
+ * 		  compared with the server's. Must not use Perl in any
+ * 		  way.
+ *
+ ******************************************************************************/
+
+class P4Scanner
+{
+    public:
+	enum State
+	{
+	    S_SAME,
+	    S_MODIFIED,		// Content differs from the have revision
+	    S_MISSING,		// In the have list but not on disk
+	    S_EXTRA,		// On disk but not in the have list
+	    S_UNCHECKED,	// Can't be compared locally (utf16 etc.)
+	    S_COUNT
+	};
+
+		P4Scanner();
+		~P4Scanner();
+
+	void		SetRoot( const char *root );
+	const StrPtr &	Root()			{ return root;		}
+
+	// Files not modified since this time (and the right size) are 
+	// assumed to be unchanged without being hashed. 0 hashes them all.
+	void		SetSince( long long t )	{ since = t;		}
+
+	// Whether text files have CRLF line endings locally, and whether
+	// unicode files are translated to another charset.
+	void		SetCrLf( int c )	{ crlf = c;		}
+	void		SetTranslated( int t )	{ translated = t;	}
+
+	// The have revisions from 'fstat -Ol', and opened files from 
+	// 'fstat -Ro', which are left out of the comparison.
+	void		AddFstat( StrDict *values, int opened );
+
+	void		Run( int threads );
+
+	int		Count( int state )	{ return lists[ state ].n; }
+	const char *	Path( int state, int i )
+			{ return lists[ state ].paths[ i ]; }
+
+	int		Files()			{ return nFound;	}
+	int		Hashed()		{ return hashed;	}
+
+    private:
+	enum Flags
+	{
+	    F_TEXT	= 0x01,
+	    F_KEYWORDS	= 0x02,		// +k: all keywords
+	    F_KEYID	= 0x04,		// +ko: just $Id$ and $Header$
+	    F_SYMLINK	= 0x08,
+	    F_UNCHECKED	= 0x10,
+	    F_OPENED	= 0x20
+	};
+
+	struct Expected
+	{
+	    const char *	path;
+	    long long		size;
+	    char		digest[ 33 ];
+	    int			flags;
+	    int			seen;
+	    int			state;
+	    long long		localSize;
+	};
+
+	struct Found
+	{
+	    const char *	path;
+	    long long		size;
+	    long long		modTime;
+	    int			link;
+	};
+
+	struct Walker
+	{
+	    P4Scanner *		scanner;
+	    P4Arena		arena;		// Paths of what we find
+	    Found *		found;
+	    int			n;
+	    int			max;
+	};
+
+	struct List
+	{
+	    const char **	paths;
+	    int			n;
+	    int			max;
+	};
+
+	static void	WalkThread( void *arg );
+	static void	HashThread( void *arg );
+	void		Walk( Walker *w );
+	void		Hash();
+	void		Match( Found &f );
+	int		Digest( Expected &e, StrBuf &digest );
+	void		AddResult( int state, const char *path );
+	void		PushDir( const char *dir );
+
+    private:
+	StrBuf		root;
+	long long	since;
+	int		crlf;
+	int		translated;
+
+	P4Arena		arena;
+	Expected *	expected;
+	int		nExpected;
+	int		maxExpected;
+
+	// Directories waiting to be read, and how many are being read
+	P4Mutex		lock;
+	const char **	dirs;
+	int		nDirs;
+	int		maxDirs;
+	int		busy;
+
+	// Files to be hashed
+	Expected **	toHash;
+	int		nToHash;
+	int		next;
+	int		hashed;
+
+	Walker *	walkers;
+	int		nWalkers;
+	int		nFound;
+	List		lists[ S_COUNT ];
+};
+
+//
+// Feeds fstat output to a scanner
+//
+class P4ScanUser : public ClientUser
+{
+    public:
+		P4ScanUser( P4Scanner *scanner, int opened );
+
+	void	HandleError( Error *e );
+	void	OutputStat( StrDict *values );
+
+	int	Failed()			{ return failed;	}
+	Error *	GetError()			{ return &error;	}
+
+	// From 'info', when no root is given
+	const StrPtr &	ClientRoot()		{ return clientRoot;	}
+
+    private:
+	P4Scanner *	scanner;
+	int		opened;
+	StrBuf		clientRoot;
+	Error		error;
+	int		failed;
+};
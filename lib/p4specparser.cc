@@ -0,0 +1,130 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4specparser.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Multi-threaded parsing of batches of forms. Must not use
+ * 		  Perl in any way as the workers run on threads of their own.
+ *
+ ******************************************************************************/
+
+#include <clientapi.h>
+#include <spec.h>
+#include "p4perlsys.h"
+#include "p4specparser.h"
+
+P4SpecParser::P4SpecParser( const StrPtr &specDef, int count, 
+			    const char * const *texts )
+{
+    this->specDef.Set( specDef );
+    this->count = count;
+    next = 0;
+
+    forms = new Form[ count ];
+    for( int i = 0; i < count; i++ )
+    {
+	forms[ i ].text = texts[ i ];
+	forms[ i ].data = 0;
+    }
+}
+
+P4SpecParser::~P4SpecParser()
+{
+    for( int i = 0; i < count; i++ )
+	delete forms[ i ].data;
+    delete [] forms;
+}
+
+StrDict *
+P4SpecParser::Dict( int i )
+{
+    if( !forms[ i ].data || forms[ i ].error.Test() )
+	return 0;
+    return forms[ i ].data->Dict();
+}
+
+//
+// Share the forms out between the threads. This thread is one of the
+// workers, so we get through them even if no threads can be started.
+//
+void
+P4SpecParser::Run( int threads )
+{
+    if( threads > count )
+	threads = count;
+    if( threads < 1 )
+	threads = 1;
+
+    P4Thread	*workers = new P4Thread[ threads ];
+    int		i;
+
+    next = 0;
+    for( i = 1; i < threads; i++ )
+	workers[ i ].Start( WorkerThread, this );
+
+    Parse();
+
+    for( i = 1; i < threads; i++ )
+	workers[ i ].Join();
+
+    delete [] workers;
+}
+
+void
+P4SpecParser::WorkerThread( void *arg )
+{
+    ( (P4SpecParser *) arg )->Parse();
+}
+
+//
+// The Spec keeps some state while it parses, so each worker compiles its
+// own copy of the specdef rather than sharing one.
+//
+void
+P4SpecParser::Parse()
+{
+    Spec	s( specDef.Text(), "" );
+
+    for( ;; )
+    {
+	int	i;
+	{
+	    P4Lock	l( lock );
+	    if( next >= count )
+		return;
+	    i = next++;
+	}
+
+	Form	&f = forms[ i ];
+	f.data = new SpecDataTable;
+	s.ParseNoValid( f.text, f.data, &f.error );
+    }
+}
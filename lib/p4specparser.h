@@ -0,0 +1,76 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4specparser.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Parsing of many forms of the same type at once, on a
+ * 		  pool of native threads. Each worker compiles the specdef
+ * 		  once and then parses forms until there are none left.
+ * 		  The parsed tables are left for the caller to convert to
+ * 		  Perl data on the interpreter's thread. Must not use Perl
+ * 		  in any way.
+ *
+ ******************************************************************************/
+
+class P4SpecParser
+{
+    public:
+		// The forms must stay put until the parser is destroyed
+		P4SpecParser( const StrPtr &specDef, int count,
+			      const char * const *forms );
+		~P4SpecParser();
+
+	void		Run( int threads );
+
+	// The parsed form, or 0 if it couldn't be parsed.
+	StrDict *	Dict( int i );
+	Error *		GetError( int i )	{ return &forms[ i ].error; }
+
+    private:
+	struct Form
+	{
+	    const char *	text;
+	    SpecDataTable *	data;
+	    Error		error;
+	};
+
+	static void	WorkerThread( void *arg );
+	void		Parse();
+
+    private:
+	StrBuf		specDef;
+	Form *		forms;
+	int		count;
+
+	// The next form to be picked up by a worker
+	P4Mutex		lock;
+	int		next;
+};
@@ -0,0 +1,167 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4specsaver.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Saving forms in bulk over a pool of connections. Must not
+ * 		  use Perl in any way as the workers run on threads of their
+ * 		  own.
+ *
+ ******************************************************************************/
+
+#include <clientapi.h>
+#include "p4perlsys.h"
+#include "p4breaker.h"
+#include "bufferedclientuser.h"
+#include "p4specsaver.h"
+
+P4SpecSaver::P4SpecSaver( const char *type, int count, const StrBuf *forms )
+{
+    this->type.Set( type );
+    this->count = count;
+    next = 0;
+
+    output = new BufferedClientUser *[ count ];
+    done = new int[ count ];
+    for( int i = 0; i < count; i++ )
+    {
+	output[ i ] = new BufferedClientUser;
+	output[ i ]->SetInput( forms[ i ] );
+	done[ i ] = 0;
+    }
+}
+
+P4SpecSaver::~P4SpecSaver()
+{
+    for( int i = 0; i < count; i++ )
+	delete output[ i ];
+    delete [] output;
+    delete [] done;
+}
+
+int
+P4SpecSaver::Failed( int i )
+{
+    return !done[ i ] || output[ i ]->ErrorCount();
+}
+
+void
+P4SpecSaver::Messages( int i, StrBuf *buf )
+{
+    output[ i ]->Messages( buf );
+    if( done[ i ] )
+	return;
+
+    if( buf->Length() )
+	buf->Append( "\n" );
+    buf->Append( "The command was stopped before this form was saved." );
+}
+
+void
+P4SpecSaver::Replay( int i, ClientUser *ui )
+{
+    output[ i ]->Replay( ui );
+}
+
+//
+// The first worker runs on this thread, so there's always at least one
+// even if no more threads can be started.
+//
+void
+P4SpecSaver::Run( ClientApi **clients, int n, const char *prog,
+		  KeepAlive *alive )
+{
+    this->prog.Set( prog );
+    next = 0;
+    breaker.Reset( alive );
+
+    if( n > count )
+	n = count;
+    if( n < 1 )
+	return;
+
+    Worker	*workers = new Worker[ n ];
+    int		i;
+
+    for( i = 0; i < n; i++ )
+    {
+	workers[ i ].saver = this;
+	workers[ i ].client = clients[ i ];
+	clients[ i ]->SetBreak( i ? breaker.ForWorker() 
+				  : breaker.ForCaller() );
+    }
+
+    for( i = 1; i < n; i++ )
+	workers[ i ].thread.Start( WorkerThread, &workers[ i ] );
+
+    Save( clients[ 0 ] );
+
+    for( i = 1; i < n; i++ )
+	breaker.Join( workers[ i ].thread );
+
+    for( i = 0; i < n; i++ )
+	clients[ i ]->SetBreak( 0 );
+
+    delete [] workers;
+}
+
+void
+P4SpecSaver::WorkerThread( void *arg )
+{
+    Worker *w = (Worker *) arg;
+    w->saver->Save( w->client );
+}
+
+void
+P4SpecSaver::Save( ClientApi *client )
+{
+    char * const argv[] = { (char *) "-i" };
+
+    for( ;; )
+    {
+	int	i;
+	{
+	    P4Lock	l( lock );
+	    if( next >= count || breaker.Stopped() )
+		return;
+	    i = next++;
+	}
+
+#if P4API_VERSION >= 513026
+	client->SetProg( prog.Text() );
+#endif
+	client->SetArgv( 1, argv );
+	client->Run( type.Text(), output[ i ] );
+
+	// If we were stopped part way through, we can't say
+	done[ i ] = !breaker.Stopped();
+    }
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4specsaver.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Saving many forms of the same type ("p4 job -i" for
+ * 		  each of thousands of jobs, say) over a pool of
+ * 		  connections. The forms are formatted by the caller; here
+ * 		  each worker thread takes the next form and sends it on
+ * 		  its own connection, capturing the output for replaying
+ * 		  in form order afterwards. Must not use Perl in any way.
+ *
+ ******************************************************************************/
+
+class BufferedClientUser;
+
+class P4SpecSaver
+{
+    public:
+		P4SpecSaver( const char *type, int count, const StrBuf *forms );
+		~P4SpecSaver();
+
+	// Save every form, sharing them out between the connections,
+	// which must be initialised already. Stops as soon as alive (if 
+	// given; only called on this thread) says to.
+	void	Run( ClientApi **clients, int n, const char *prog,
+		     KeepAlive *alive = 0 );
+
+	int	Count()			{ return count;		}
+
+	// Forms not saved because we were stopped have failed too
+	int	Failed( int i );
+
+	// The messages for a form, and then the output itself
+	void	Messages( int i, StrBuf *buf );
+	void	Replay( int i, ClientUser *ui );
+
+    private:
+	struct Worker
+	{
+	    P4SpecSaver *	saver;
+	    ClientApi *		client;
+	    P4Thread		thread;
+	};
+
+	static void	WorkerThread( void *arg );
+	void		Save( ClientApi *client );
+
+    private:
+	StrBuf			type;
+	StrBuf			prog;
+	BufferedClientUser **	output;
+	int *			done;
+	int			count;
+
+	// The next form to be picked up by a worker
+	P4Mutex			lock;
+	int			next;
+
+	P4Breaker		breaker;
+};
@@ -0,0 +1,495 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4splitter.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Running a command that's too big for the server's 
+ * 		  limits in pieces. Must not use Perl in any way as the
+ * 		  workers run on threads of their own.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include <clientapi.h>
+#include "p4perlsys.h"
+#include "p4breaker.h"
+#include "bufferedclientuser.h"
+#include "p4batch.h"
+#include "p4splitter.h"
+
+//
+// Commands whose output is a list of records for each file, so running
+// them on parts of a path gives the same results as the whole.
+//
+static const char *splittableCommands[] = {
+    "files", "filelog", "fstat", "have", "integrated", "opened", "print",
+    "sizes", "verify",
+    0
+};
+
+//
+// Captures the output of a piece. The limit error is held back, as are
+// the "no such file(s)" warnings from subdirectories that don't match,
+// which the whole command wouldn't have given.
+//
+class P4SplitUser : public BufferedClientUser
+{
+    public:
+		P4SplitUser()		{ limitHit = 0;		}
+
+	void	HandleError( Error *e );
+
+	int	LimitHit()		{ return limitHit;	}
+	void	AddLimitError()	{ BufferedClientUser::HandleError( &limit ); }
+
+    private:
+	int	limitHit;
+	Error	limit;
+};
+
+void
+P4SplitUser::HandleError( Error *e )
+{
+    if( P4Splitter::IsLimitError( e ) )
+    {
+	limitHit = 1;
+	limit = *e;
+	return;
+    }
+
+    if( e->GetGeneric() == EV_EMPTY )
+	return;
+
+    BufferedClientUser::HandleError( e );
+}
+
+//
+// Collects the directories listed by 'dirs', tagged or not. Warnings
+// (no subdirectories) don't matter, but if 'dirs' itself fails - by 
+// going over the limits too, say - we don't know what's there.
+//
+class P4DirsUser : public ClientUser
+{
+    public:
+		P4DirsUser()		{ failed = 0;		}
+
+	void	HandleError( Error *e )
+		{
+		    if( e->GetSeverity() >= E_FAILED )
+			failed = 1;
+		}
+	void	OutputInfo( char level, const_char *data )
+		{ dirs << data << "\n";					}
+	void	OutputStat( StrDict *values )
+		{
+		    StrPtr *d = values->GetVar( "dir" );
+		    if( d ) dirs << *d << "\n";
+		}
+
+	StrBuf	dirs;
+	int	failed;
+};
+
+P4Splitter::P4Splitter( const char *cmd, int argc, char * const *argv )
+{
+    this->cmd = cmd;
+    pieces = 0;
+    nPieces = 0;
+    maxPieces = 0;
+    replayed = 0;
+    prog = 0;
+    maxResults = maxScanRows = 0;
+    splits = 0;
+    commands = 0;
+    next = 0;
+
+    nOpts = 0;
+    while( nOpts < argc && argv[ nOpts ][ 0 ] == '-' )
+    {
+	if( !strcmp( argv[ nOpts ], "--" ) )
+	{
+	    nOpts++;
+	    break;
+	}
+	if( P4Batch::TakesValue( cmd, argv[ nOpts ] ) && nOpts + 1 < argc )
+	    nOpts++;
+	nOpts++;
+    }
+
+    opts = new char *[ nOpts + 1 ];
+    for( int i = 0; i < nOpts; i++ )
+	opts[ i ] = argv[ i ];
+
+    //
+    // Several paths are first tried one at a time. A single path has
+    // already been tried, so it's split straight away if it can be.
+    //
+    StrBuf	prefix, rev;
+
+    if( argc - nOpts > 1 )
+    {
+	for( int i = nOpts; i < argc; i++ )
+	    Add( argv[ i ], P_PENDING );
+	splits++;
+    }
+    else if( argc - nOpts == 1 && SplitPath( argv[ nOpts ], prefix, rev ) )
+    {
+	Add( argv[ nOpts ], P_EXPAND );
+    }
+}
+
+P4Splitter::~P4Splitter()
+{
+    for( int i = 0; i < nPieces; i++ )
+    {
+	delete pieces[ i ]->output;
+	delete pieces[ i ];
+    }
+    delete [] pieces;
+    delete [] opts;
+}
+
+int
+P4Splitter::IsLimitError( Error *e )
+{
+    StrDict	*d;
+
+    if( e->GetSeverity() < E_FAILED || !( d = e->GetDict() ) )
+	return 0;
+
+    return d->GetVar( "maxResults" ) || d->GetVar( "maxScanRows" );
+}
+
+int
+P4Splitter::IsSplittable( const char *cmd )
+{
+    for( const char **c = splittableCommands; *c; c++ )
+	if( !strcmp( cmd, *c ) )
+	    return 1;
+    return 0;
+}
+
+//
+// Paths that can be split end in a "..." directory wildcard, perhaps
+// followed by a revision. Returns the part before the "..." (which may
+// be empty for a relative path) and the revision.
+//
+int
+P4Splitter::SplitPath( const char *path, StrBuf &prefix, StrBuf &rev )
+{
+    const char	*r = path + strcspn( path, "@#" );
+    int		len = r - path;
+
+    if( len < 3 || strncmp( r - 3, "...", 3 ) )
+	return 0;
+    if( len > 3 && r[ -4 ] != '/' )
+	return 0;
+    if( memchr( path, '*', len ) || strstr( path, "..." ) != r - 3 )
+	return 0;
+
+    prefix.Set( path, len - 3 );
+    rev.Set( r );
+    return 1;
+}
+
+void
+P4Splitter::Add( const char *path, int state )
+{
+    Piece	*p = new Piece;
+    p->path.Set( path );
+    p->state = state;
+    p->noSplit = 0;
+    p->output = 0;
+    Append( p );
+}
+
+void
+P4Splitter::Append( Piece *p )
+{
+    if( nPieces == maxPieces )
+    {
+	maxPieces = maxPieces ? maxPieces * 2 : 16;
+	Piece **n = new Piece *[ maxPieces ];
+	if( nPieces )
+	    memcpy( n, pieces, nPieces * sizeof( Piece * ) );
+	delete [] pieces;
+	pieces = n;
+    }
+    pieces[ nPieces++ ] = p;
+}
+
+void
+P4Splitter::Run( ClientApi **clients, int n, ClientUser *ui,
+		 const char *prog, int maxResults, int maxScanRows,
+		 KeepAlive *alive )
+{
+    this->prog = prog;
+    this->maxResults = maxResults;
+    this->maxScanRows = maxScanRows;
+    breaker.Reset( alive );
+
+    //
+    // In rounds: run what's pending, hand on whatever's complete at the
+    // front of the list, and replace the pieces that had to be split 
+    // with their subdirectories for the next round.
+    //
+    do
+    {
+	int	w = n < nPieces - replayed ? n : nPieces - replayed;
+	int	i;
+
+	if( w < 1 )
+	    w = 1;
+
+	Worker	*workers = new Worker[ w ];
+
+	next = replayed;
+	for( i = 0; i < w; i++ )
+	{
+	    workers[ i ].splitter = this;
+	    workers[ i ].client = clients[ i ];
+	    clients[ i ]->SetBreak( i ? breaker.ForWorker() 
+				      : breaker.ForCaller() );
+	}
+
+	for( i = 1; i < w; i++ )
+	    workers[ i ].thread.Start( WorkerThread, &workers[ i ] );
+
+	RunPieces( clients[ 0 ] );
+
+	for( i = 1; i < w; i++ )
+	    breaker.Join( workers[ i ].thread );
+
+	for( i = 0; i < w; i++ )
+	    clients[ i ]->SetBreak( 0 );
+
+	delete [] workers;
+
+	for( ; replayed < nPieces; replayed++ )
+	{
+	    Piece *p = pieces[ replayed ];
+	    if( p->state != P_DONE )
+		break;
+	    p->output->Replay( ui );
+	    delete p->output;
+	    p->output = 0;
+	}
+    }
+    while( breaker.Check() && NextRound() );
+}
+
+void
+P4Splitter::WorkerThread( void *arg )
+{
+    Worker *w = (Worker *) arg;
+    w->splitter->RunPieces( w->client );
+}
+
+void
+P4Splitter::RunPieces( ClientApi *client )
+{
+    while( !breaker.Stopped() )
+    {
+	Piece	*p = 0;
+	{
+	    P4Lock	l( lock );
+	    while( next < nPieces && !p )
+	    {
+		int s = pieces[ next ]->state;
+		if( s == P_PENDING || s == P_EXPAND )
+		    p = pieces[ next ];
+		next++;
+	    }
+	}
+
+	if( !p )
+	    return;
+
+	RunPiece( client, *p );
+    }
+}
+
+void
+P4Splitter::RunPiece( ClientApi *client, Piece &p )
+{
+    if( p.state == P_EXPAND )
+    {
+	Expand( client, p );
+	return;
+    }
+
+    char	**argv = new char *[ nOpts + 1 ];
+
+    memcpy( argv, opts, nOpts * sizeof( char * ) );
+    argv[ nOpts ] = p.path.Text();
+    p.output = new P4SplitUser;
+
+    if( maxResults  )	client->SetVar( "maxResults",  maxResults  );
+    if( maxScanRows )	client->SetVar( "maxScanRows", maxScanRows );
+
+#if P4API_VERSION >= 513026
+    client->SetProg( prog );
+#endif
+    client->SetArgv( nOpts + 1, argv );
+    client->Run( cmd, p.output );
+    delete [] argv;
+
+    {
+	P4Lock	l( lock );
+	commands++;
+    }
+
+    // Cut short, so whatever it got is all there is
+    if( breaker.Stopped() )
+    {
+	p.state = P_DONE;
+	return;
+    }
+
+    StrBuf	prefix, rev;
+
+    if( p.output->LimitHit() && !p.noSplit && 
+	SplitPath( p.path.Text(), prefix, rev ) && Expand( client, p ) )
+    {
+	delete p.output;
+	p.output = 0;
+	return;
+    }
+
+    if( p.output->LimitHit() )
+	p.output->AddLimitError();
+
+    p.state = P_DONE;
+}
+
+//
+// Split a path into the files directly in its directory and a path for
+// each subdirectory. Subdirectories holding only deleted files are 
+// included, as some commands report those too. Returns 0 if it can't be
+// split, in which case the piece is to be run whole, and its limit
+// error reported.
+//
+int
+P4Splitter::Expand( ClientApi *client, Piece &p )
+{
+    StrBuf	prefix, rev, files;
+    P4DirsUser	u;
+
+    SplitPath( p.path.Text(), prefix, rev );
+    files << prefix << "*" << rev;
+
+    char	*args[] = { (char *) "-D", files.Text() };
+
+#if P4API_VERSION >= 513026
+    client->SetProg( prog );
+#endif
+    client->SetArgv( 2, args );
+    client->Run( "dirs", &u );
+
+    P4Lock	l( lock );
+    commands++;
+
+    // Splitting into anything less than all of the subdirectories would
+    // lose results, so that's not splitting at all
+    p.children.Clear();
+    if( u.failed || breaker.Stopped() )
+    {
+	p.noSplit = 1;
+	p.state = P_PENDING;
+	return 0;
+    }
+
+    // There are no files directly under //
+    if( prefix != "//" )
+	p.children << files << "\n";
+
+    for( char *d = u.dirs.Text(); *d; )
+    {
+	char *e = strchr( d, '\n' );
+	p.children.Append( d, e - d );
+	p.children << "/..." << rev << "\n";
+	d = e + 1;
+    }
+
+    if( !p.children.Length() )
+    {
+	// Nothing to split it into, so run it whole and report the error
+	p.noSplit = 1;
+	p.state = P_PENDING;
+	return 0;
+    }
+
+    splits++;
+    p.state = P_SPLIT;
+    return 1;
+}
+
+//
+// Returns 0 when there's nothing left to run
+//
+int
+P4Splitter::NextRound()
+{
+    int	old = nPieces;
+    int	more = 0;
+    int	i;
+
+    Piece	**list = pieces;
+
+    pieces = 0;
+    nPieces = 0;
+    maxPieces = 0;
+
+    for( i = 0; i < old; i++ )
+    {
+	Piece	*p = list[ i ];
+
+	if( p->state != P_SPLIT )
+	{
+	    Append( p );
+	    more |= p->state != P_DONE;
+	    continue;
+	}
+
+	for( char *c = p->children.Text(); *c; )
+	{
+	    char *e = strchr( c, '\n' );
+	    *e = 0;
+	    Add( c, P_PENDING );
+	    c = e + 1;
+	}
+	more = 1;
+	delete p;
+    }
+
+    delete [] list;
+    return more;
+}
@@ -0,0 +1,132 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4splitter.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Running a command that went over maxresults or 
+ * 		  maxscanrows in pieces. Each path argument is run on its
+ * 		  own, and paths ending in ... which are still too big 
+ * 		  are split into their subdirectories (found with 'dirs')
+ * 		  and so on down until every piece fits. Pieces are run 
+ * 		  on one or more connections, and their output is handed
+ * 		  on in path order as soon as it's complete. Must not use
+ * 		  Perl in any way.
+ *
+ ******************************************************************************/
+
+class P4SplitUser;
+
+class P4Splitter
+{
+    public:
+		P4Splitter( const char *cmd, int argc, char * const *argv );
+		~P4Splitter();
+
+	// Whether an error is the server refusing a command because it
+	// would go over the maxresults or maxscanrows limits
+	static int	IsLimitError( Error *e );
+
+	// Whether a command's output can be put together from pieces
+	static int	IsSplittable( const char *cmd );
+
+	// 0 if there are no paths to split
+	int		CanSplit()		{ return nPieces > 0;	}
+
+	// Runs the pieces on the connections given, which must be 
+	// initialised already, passing the output on to ui on this 
+	// thread. Returns when it's all done, or as soon as alive (if 
+	// given) says to stop. alive is only ever called on this thread.
+	void		Run( ClientApi **clients, int n, ClientUser *ui,
+			     const char *prog, int maxResults, 
+			     int maxScanRows, KeepAlive *alive = 0 );
+
+	// How many paths had to be split, and how many commands it took
+	int		Splits()		{ return splits;	}
+	int		Commands()		{ return commands;	}
+
+    private:
+	enum PieceState
+	{
+	    P_PENDING,		// To be run
+	    P_EXPAND,		// To be split into subdirectories
+	    P_SPLIT,		// Split; its children replace it
+	    P_DONE
+	};
+
+	struct Piece
+	{
+	    StrBuf		path;
+	    int			state;
+	    int			noSplit;	// Report the limit error
+	    P4SplitUser *	output;
+	    StrBuf		children;	// One per line
+	};
+
+	struct Worker
+	{
+	    P4Splitter *	splitter;
+	    ClientApi *		client;
+	    P4Thread		thread;
+	};
+
+	static int	SplitPath( const char *path, StrBuf &prefix, 
+				   StrBuf &rev );
+	static void	WorkerThread( void *arg );
+	void		RunPieces( ClientApi *client );
+	void		RunPiece( ClientApi *client, Piece &p );
+	int		Expand( ClientApi *client, Piece &p );
+	int		NextRound();
+	void		Add( const char *path, int state );
+	void		Append( Piece *p );
+
+    private:
+	const char *	cmd;
+	char **		opts;
+	int		nOpts;
+
+	Piece **	pieces;
+	int		nPieces;
+	int		maxPieces;
+	int		replayed;
+
+	const char *	prog;
+	int		maxResults;
+	int		maxScanRows;
+
+	int		splits;
+	int		commands;
+
+	// The next piece to be picked up by a worker
+	P4Mutex		lock;
+	int		next;
+
+	P4Breaker	breaker;
+};
@@ -0,0 +1,795 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4textdiff.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: In-memory diffs of batches of texts. Must not use Perl
+ * 		  in any way as the workers run on threads of their own.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include <clientapi.h>
+#include "p4perlsys.h"
+#include "p4arena.h"
+#include "p4textdiff.h"
+
+//
+// One side of a comparison: the text split into lines, and the id of
+// each line's equivalence class. Lines which compare equal (allowing
+// for the whitespace flags) get the same id, so the diff itself only
+// ever compares integers.
+//
+struct DiffSide
+{
+		DiffSide()	{ start = 0; ids = 0; changed = 0; }
+		~DiffSide()	
+		{ 
+		    delete [] start; 
+		    delete [] ids; 
+		    delete [] changed; 
+		}
+
+    void	Split( const char *t, int l );
+    const char *Line( int i )		{ return text + start[ i ];	   }
+    int		Length( int i )		{ return start[ i + 1 ] - start[ i ]; }
+
+    const char *text;
+    int		len;
+    int		n;
+    int *	start;		// start[ n ] is the end of the text
+    int *	ids;
+    char *	changed;
+};
+
+void
+DiffSide::Split( const char *t, int l )
+{
+    const char	*p, *e = t + l;
+
+    text = t;
+    len = l;
+
+    for( n = 0, p = t; p < e; n++ )
+    {
+	const char *nl = (const char *) memchr( p, '\n', e - p );
+	p = nl ? nl + 1 : e;
+    }
+
+    start = new int[ n + 1 ];
+    ids = new int[ n ];
+    changed = new char[ n ];
+    memset( changed, 0, n );
+
+    int	i = 0;
+    for( p = t; p < e; i++ )
+    {
+	const char *nl = (const char *) memchr( p, '\n', e - p );
+	start[ i ] = p - t;
+	p = nl ? nl + 1 : e;
+    }
+    start[ n ] = l;
+}
+
+//
+// The comparison of one pair of texts
+//
+class DiffEngine
+{
+    public:
+		DiffEngine( int ignore );
+		~DiffEngine();
+
+	void	Run( const char *l, int ll, const char *r, int rl );
+
+	DiffSide	a;
+	DiffSide	b;
+
+    private:
+	void	Classify();
+	void	Key( DiffSide &s, int i, StrBuf &buf, 
+		     const char *&key, int &len );
+	void	Compare( int aLo, int aHi, int bLo, int bHi );
+	int	Bisect( int aLo, int aHi, int bLo, int bHi, int &x, int &y );
+
+    private:
+	int		ignore;
+	int *		v1;
+	int *		v2;
+	P4Arena		arena;		// Normalised keys
+};
+
+DiffEngine::DiffEngine( int ignore )
+{
+    this->ignore = ignore;
+    v1 = v2 = 0;
+}
+
+DiffEngine::~DiffEngine()
+{
+    delete [] v1;
+    delete [] v2;
+}
+
+void
+DiffEngine::Run( const char *l, int ll, const char *r, int rl )
+{
+    a.Split( l, ll );
+    b.Split( r, rl );
+    Classify();
+
+    int vLen = 2 * ( ( a.n + b.n + 1 ) / 2 ) + 2;
+    v1 = new int[ vLen ];
+    v2 = new int[ vLen ];
+
+    Compare( 0, a.n, 0, b.n );
+}
+
+//
+// The text that decides whether two lines are the same. Without any of
+// the whitespace flags, that's the whole line including its newline,
+// and it's used where it lies. Otherwise it's built in the buffer.
+//
+void
+DiffEngine::Key( DiffSide &s, int i, StrBuf &buf, const char *&key, int &len )
+{
+    const char	*p = s.Line( i );
+    const char	*e = p + s.Length( i );
+
+    if( ignore != P4TextDiff::I_NONE )
+    {
+	// All the other modes ignore the line ending
+	if( e > p && e[ -1 ] == '\n' ) e--;
+	if( e > p && e[ -1 ] == '\r' ) e--;
+    }
+
+    if( ignore == P4TextDiff::I_NONE || ignore == P4TextDiff::I_ENDINGS )
+    {
+	key = p;
+	len = e - p;
+	return;
+    }
+
+    int	space = 0;
+
+    buf.Clear();
+    for( ; p < e; p++ )
+    {
+	if( *p == ' ' || *p == '\t' || *p == '\r' || *p == '\f' )
+	{
+	    space = 1;
+	    continue;
+	}
+
+	// -db reduces runs of whitespace to one, but only between words
+	if( space && ignore == P4TextDiff::I_SPACE && buf.Length() )
+	    buf.Extend( ' ' );
+	space = 0;
+	buf.Extend( *p );
+    }
+
+    key = buf.Text();
+    len = buf.Length();
+}
+
+//
+// Give each line an id, shared by all lines with the same key, using an
+// open hash table of the keys seen so far. Keys built in a buffer are
+// copied to the arena as they're added to the table.
+//
+void
+DiffEngine::Classify()
+{
+    int		total = a.n + b.n;
+    int		size = 16;
+
+    while( size < total * 2 )
+	size *= 2;
+
+    struct Slot { unsigned int hash; int id; };
+
+    Slot	*table = new Slot[ size ];
+    const char	**keys = new const char *[ total ];
+    int		*lens = new int[ total ];
+    int		nIds = 0;
+    StrBuf	buf;
+
+    for( int i = 0; i < size; i++ )
+	table[ i ].id = -1;
+
+    for( int side = 0; side < 2; side++ )
+    {
+	DiffSide &s = side ? b : a;
+
+	for( int i = 0; i < s.n; i++ )
+	{
+	    const char	*key;
+	    int		len;
+
+	    Key( s, i, buf, key, len );
+
+	    // FNV-1a
+	    unsigned int	h = 2166136261U;
+	    for( int j = 0; j < len; j++ )
+		h = ( h ^ (unsigned char) key[ j ] ) * 16777619U;
+
+	    int	slot = h & ( size - 1 );
+	    for( ;; slot = ( slot + 1 ) & ( size - 1 ) )
+	    {
+		Slot &t = table[ slot ];
+
+		if( t.id < 0 )
+		{
+		    if( key == buf.Text() )
+			key = arena.Dup( key, len );
+		    t.hash = h;
+		    t.id = nIds;
+		    keys[ nIds ] = key;
+		    lens[ nIds++ ] = len;
+		    break;
+		}
+
+		if( t.hash == h && lens[ t.id ] == len && 
+		    !memcmp( keys[ t.id ], key, len ) )
+		    break;
+	    }
+	    s.ids[ i ] = table[ slot ].id;
+	}
+    }
+
+    delete [] table;
+    delete [] keys;
+    delete [] lens;
+}
+
+//
+// Mark the lines that differ between a[ aLo, aHi ) and b[ bLo, bHi ).
+// Common lines at either end are stripped, and what's left is split at
+// the middle of a shortest edit script and each half compared in turn.
+//
+void
+DiffEngine::Compare( int aLo, int aHi, int bLo, int bHi )
+{
+    while( aLo < aHi && bLo < bHi && a.ids[ aLo ] == b.ids[ bLo ] )
+	aLo++, bLo++;
+    while( aLo < aHi && bLo < bHi && a.ids[ aHi - 1 ] == b.ids[ bHi - 1 ] )
+	aHi--, bHi--;
+
+    int	x, y;
+
+    if( aLo == aHi || bLo == bHi || !Bisect( aLo, aHi, bLo, bHi, x, y ) )
+    {
+	memset( a.changed + aLo, 1, aHi - aLo );
+	memset( b.changed + bLo, 1, bHi - bLo );
+	return;
+    }
+
+    Compare( aLo, aLo + x, bLo, bLo + y );
+    Compare( aLo + x, aHi, bLo + y, bHi );
+}
+
+//
+// Find the middle snake: run the search forwards from the start and
+// backwards from the end until the two paths overlap. Returns the point
+// (relative to aLo and bLo) to split at, or 0 if the two have nothing
+// useful in common.
+//
+int
+DiffEngine::Bisect( int aLo, int aHi, int bLo, int bHi, int &x, int &y )
+{
+    const int	*A = a.ids + aLo;
+    const int	*B = b.ids + bLo;
+    int		N = aHi - aLo;
+    int		M = bHi - bLo;
+    int		maxD = ( N + M + 1 ) / 2;
+    int		off = maxD;
+    int		vLen = 2 * maxD + 2;
+    int		delta = N - M;
+    int		front = ( delta & 1 );
+    int		k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+
+    for( int i = 0; i < vLen; i++ )
+	v1[ i ] = v2[ i ] = -1;
+    v1[ off + 1 ] = 0;
+    v2[ off + 1 ] = 0;
+
+    for( int d = 0; d < maxD; d++ )
+    {
+	int	k, x1, y1, x2, y2;
+
+	// Forward path
+	for( k = -d + k1start; k <= d - k1end; k += 2 )
+	{
+	    int	ko = off + k;
+
+	    if( k == -d || ( k != d && v1[ ko - 1 ] < v1[ ko + 1 ] ) )
+		x1 = v1[ ko + 1 ];
+	    else
+		x1 = v1[ ko - 1 ] + 1;
+	    y1 = x1 - k;
+
+	    while( x1 < N && y1 < M && A[ x1 ] == B[ y1 ] )
+		x1++, y1++;
+	    v1[ ko ] = x1;
+
+	    if( x1 > N )
+		k1end += 2;
+	    else if( y1 > M )
+		k1start += 2;
+	    else if( front )
+	    {
+		int	k2o = off + delta - k;
+		if( k2o >= 0 && k2o < vLen && v2[ k2o ] != -1 &&
+		    x1 >= N - v2[ k2o ] )
+		{
+		    x = x1;
+		    y = y1;
+		    return ( x || y ) && ( x < N || y < M );
+		}
+	    }
+	}
+
+	// Reverse path
+	for( k = -d + k2start; k <= d - k2end; k += 2 )
+	{
+	    int	ko = off + k;
+
+	    if( k == -d || ( k != d && v2[ ko - 1 ] < v2[ ko + 1 ] ) )
+		x2 = v2[ ko + 1 ];
+	    else
+		x2 = v2[ ko - 1 ] + 1;
+	    y2 = x2 - k;
+
+	    while( x2 < N && y2 < M && A[ N - x2 - 1 ] == B[ M - y2 - 1 ] )
+		x2++, y2++;
+	    v2[ ko ] = x2;
+
+	    if( x2 > N )
+		k2end += 2;
+	    else if( y2 > M )
+		k2start += 2;
+	    else if( !front )
+	    {
+		int	k1o = off + delta - k;
+		if( k1o >= 0 && k1o < vLen && v1[ k1o ] != -1 )
+		{
+		    x1 = v1[ k1o ];
+		    y1 = off + x1 - k1o;
+		    if( x1 >= N - x2 )
+		    {
+			x = x1;
+			y = y1;
+			return ( x || y ) && ( x < N || y < M );
+		    }
+		}
+	    }
+	}
+    }
+
+    return 0;
+}
+
+//
+// Output formatting
+//
+
+static void
+AppendLine( StrBuf &o, const char *prefix, DiffSide &s, int i )
+{
+    int	l = s.Length( i );
+
+    o.Append( prefix );
+    o.Append( s.Line( i ), l );
+    if( !l || s.Line( i )[ l - 1 ] != '\n' )
+	o.Append( "\n\\ No newline at end of file\n" );
+}
+
+static void
+AppendRawLine( StrBuf &o, DiffSide &s, int i )
+{
+    int	l = s.Length( i );
+
+    o.Append( s.Line( i ), l );
+    if( !l || s.Line( i )[ l - 1 ] != '\n' )
+	o.Append( "\n" );
+}
+
+// "start,end" as in normal and context diffs, from a 0-based start
+static void
+AppendRange( StrBuf &o, int start, int count )
+{
+    if( count > 1 )
+	o << ( start + 1 ) << "," << ( start + count );
+    else if( count == 1 )
+	o << ( start + 1 );
+    else
+	o << start;
+}
+
+// "start,count" as in unified diffs
+static void
+AppendUnifiedRange( StrBuf &o, int start, int count )
+{
+    if( count == 1 )
+	o << ( start + 1 );
+    else
+	o << ( count ? start + 1 : start ) << "," << count;
+}
+
+P4TextDiff::P4TextDiff()
+{
+    pairs = 0;
+    count = 0;
+    max = 0;
+    style = S_NORMAL;
+    ignore = I_NONE;
+    context = 3;
+    format = 1;
+    next = 0;
+}
+
+P4TextDiff::~P4TextDiff()
+{
+    for( int i = 0; i < count; i++ )
+	delete [] pairs[ i ].hunks;
+    delete [] pairs;
+}
+
+int
+P4TextDiff::SetFlags( const char *flags, StrBuf *error )
+{
+    for( const char *f = flags; f && *f; f++ )
+    {
+	switch( *f )
+	{
+	case 'n': style = S_RCS;	break;
+	case 's': style = S_SUMMARY;	break;
+	case 'l': ignore = I_ENDINGS;	break;
+	case 'b': ignore = I_SPACE;	break;
+	case 'w': ignore = I_ALLSPACE;	break;
+
+	case 'c':
+	case 'u':
+	    style = *f == 'c' ? S_CONTEXT : S_UNIFIED;
+	    if( f[ 1 ] >= '0' && f[ 1 ] <= '9' )
+	    {
+		for( context = 0; f[ 1 ] >= '0' && f[ 1 ] <= '9'; f++ )
+		    context = context * 10 + f[ 1 ] - '0';
+	    }
+	    break;
+
+	case '-':
+	case 'd':
+	    break;
+
+	default:
+	    error->Set( "Unknown diff flag '" );
+	    error->Extend( *f );
+	    error->Append( "'" );
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+void
+P4TextDiff::Add( const char *left, int leftLen, 
+		 const char *right, int rightLen )
+{
+    if( count == max )
+    {
+	max = max ? max * 2 : 16;
+	Pair *n = new Pair[ max ];
+	for( int i = 0; i < count; i++ )
+	{
+	    n[ i ].left = pairs[ i ].left;
+	    n[ i ].leftLen = pairs[ i ].leftLen;
+	    n[ i ].right = pairs[ i ].right;
+	    n[ i ].rightLen = pairs[ i ].rightLen;
+	    n[ i ].hunks = pairs[ i ].hunks;
+	    n[ i ].nHunks = pairs[ i ].nHunks;
+	}
+	delete [] pairs;
+	pairs = n;
+    }
+
+    Pair &p = pairs[ count++ ];
+    p.left = left;
+    p.leftLen = leftLen;
+    p.right = right;
+    p.rightLen = rightLen;
+    p.hunks = 0;
+    p.nHunks = 0;
+}
+
+P4TextDiff::Hunk
+P4TextDiff::GetHunk( int i, int h )
+{
+    Hunk r = pairs[ i ].hunks[ h ];
+
+    r.leftStart += r.leftCount ? 1 : 0;
+    r.rightStart += r.rightCount ? 1 : 0;
+    return r;
+}
+
+//
+// Share the pairs out between the threads. This thread is one of the
+// workers, so we get through them even if no threads can be started.
+//
+void
+P4TextDiff::Run( int threads )
+{
+    if( threads > count )
+	threads = count;
+    if( threads < 1 )
+	threads = 1;
+
+    P4Thread	*workers = new P4Thread[ threads ];
+    int		i;
+
+    next = 0;
+    for( i = 1; i < threads; i++ )
+	workers[ i ].Start( WorkerThread, this );
+
+    Work();
+
+    for( i = 1; i < threads; i++ )
+	workers[ i ].Join();
+
+    delete [] workers;
+}
+
+void
+P4TextDiff::WorkerThread( void *arg )
+{
+    ( (P4TextDiff *) arg )->Work();
+}
+
+void
+P4TextDiff::Work()
+{
+    for( ;; )
+    {
+	int	i;
+	{
+	    P4Lock	l( lock );
+	    if( next >= count )
+		return;
+	    i = next++;
+	}
+
+	Compare( pairs[ i ] );
+    }
+}
+
+void
+P4TextDiff::Compare( Pair &p )
+{
+    DiffEngine	e( ignore );
+    DiffSide	&a = e.a;
+    DiffSide	&b = e.b;
+
+    e.Run( p.left, p.leftLen, p.right, p.rightLen );
+
+    //
+    // Collect the runs of changed lines into hunks
+    //
+    int	i = 0, j = 0, max = 0;
+
+    while( i < a.n || j < b.n )
+    {
+	if( i < a.n && j < b.n && !a.changed[ i ] && !b.changed[ j ] )
+	{
+	    i++, j++;
+	    continue;
+	}
+
+	int	si = i, sj = j;
+	while( i < a.n && a.changed[ i ] ) i++;
+	while( j < b.n && b.changed[ j ] ) j++;
+
+	if( i == si && j == sj )
+	    break;
+
+	if( p.nHunks == max )
+	{
+	    max = max ? max * 2 : 8;
+	    Hunk *n = new Hunk[ max ];
+	    if( p.nHunks )
+		memcpy( n, p.hunks, p.nHunks * sizeof( Hunk ) );
+	    delete [] p.hunks;
+	    p.hunks = n;
+	}
+
+	Hunk &h = p.hunks[ p.nHunks++ ];
+	h.leftStart = si;
+	h.leftCount = i - si;
+	h.rightStart = sj;
+	h.rightCount = j - sj;
+    }
+
+    if( !format )
+	return;
+
+    StrBuf	&o = p.output;
+    Hunk	*hs = p.hunks;
+    int		n = p.nHunks;
+    int		g, k, l;
+
+    switch( style )
+    {
+    case S_NORMAL:
+	for( g = 0; g < n; g++ )
+	{
+	    Hunk &h = hs[ g ];
+	    AppendRange( o, h.leftStart, h.leftCount );
+	    o.Extend( !h.leftCount ? 'a' : !h.rightCount ? 'd' : 'c' );
+	    AppendRange( o, h.rightStart, h.rightCount );
+	    o.Append( "\n" );
+
+	    for( l = 0; l < h.leftCount; l++ )
+		AppendLine( o, "< ", a, h.leftStart + l );
+	    if( h.leftCount && h.rightCount )
+		o.Append( "---\n" );
+	    for( l = 0; l < h.rightCount; l++ )
+		AppendLine( o, "> ", b, h.rightStart + l );
+	}
+	break;
+
+    case S_RCS:
+	for( g = 0; g < n; g++ )
+	{
+	    Hunk &h = hs[ g ];
+	    if( h.leftCount )
+		o << "d" << ( h.leftStart + 1 ) << " " << h.leftCount << "\n";
+	    if( h.rightCount )
+	    {
+		o << "a" << ( h.leftStart + h.leftCount ) << " " 
+		  << h.rightCount << "\n";
+		for( l = 0; l < h.rightCount; l++ )
+		    AppendRawLine( o, b, h.rightStart + l );
+	    }
+	}
+	break;
+
+    case S_SUMMARY:
+	{
+	    int	adds = 0, addLines = 0, dels = 0, delLines = 0;
+	    int	chgs = 0, chgLeft = 0, chgRight = 0;
+
+	    for( g = 0; g < n; g++ )
+	    {
+		Hunk &h = hs[ g ];
+		if( !h.leftCount )
+		    adds++, addLines += h.rightCount;
+		else if( !h.rightCount )
+		    dels++, delLines += h.leftCount;
+		else
+		    chgs++, chgLeft += h.leftCount, chgRight += h.rightCount;
+	    }
+
+	    o << "add " << adds << " chunks " << addLines << " lines\n";
+	    o << "deleted " << dels << " chunks " << delLines << " lines\n";
+	    o << "changed " << chgs << " chunks " << chgLeft << " / " 
+	      << chgRight << " lines\n";
+	}
+	break;
+
+    case S_CONTEXT:
+    case S_UNIFIED:
+	//
+	// Hunks whose context would touch or overlap are output as one
+	//
+	for( g = 0; g < n; g = k )
+	{
+	    for( k = g + 1; k < n; k++ )
+		if( hs[ k ].leftStart - ( hs[ k - 1 ].leftStart + 
+		    hs[ k - 1 ].leftCount ) > 2 * context )
+		    break;
+
+	    Hunk	&first = hs[ g ];
+	    Hunk	&last = hs[ k - 1 ];
+	    int		before = first.leftStart < context 
+				? first.leftStart : context;
+	    int		aEnd = last.leftStart + last.leftCount;
+	    int		after = a.n - aEnd < context ? a.n - aEnd : context;
+	    int		aFrom = first.leftStart - before;
+	    int		aTo = aEnd + after;
+	    int		bFrom = first.rightStart - before;
+	    int		bTo = last.rightStart + last.rightCount + after;
+	    int		h, x;
+
+	    if( style == S_UNIFIED )
+	    {
+		o.Append( "@@ -" );
+		AppendUnifiedRange( o, aFrom, aTo - aFrom );
+		o.Append( " +" );
+		AppendUnifiedRange( o, bFrom, bTo - bFrom );
+		o.Append( " @@\n" );
+
+		for( x = aFrom, h = g; h < k; h++ )
+		{
+		    for( ; x < hs[ h ].leftStart; x++ )
+			AppendLine( o, " ", a, x );
+		    for( l = 0; l < hs[ h ].leftCount; l++ )
+			AppendLine( o, "-", a, x++ );
+		    for( l = 0; l < hs[ h ].rightCount; l++ )
+			AppendLine( o, "+", b, hs[ h ].rightStart + l );
+		}
+		for( ; x < aTo; x++ )
+		    AppendLine( o, " ", a, x );
+		continue;
+	    }
+
+	    int	anyLeft = 0, anyRight = 0;
+	    for( h = g; h < k; h++ )
+	    {
+		anyLeft |= hs[ h ].leftCount;
+		anyRight |= hs[ h ].rightCount;
+	    }
+
+	    o.Append( "***************\n*** " );
+	    AppendRange( o, aFrom, aTo - aFrom );
+	    o.Append( " ****\n" );
+	    if( anyLeft )
+	    {
+		for( x = aFrom, h = g; h < k; h++ )
+		{
+		    for( ; x < hs[ h ].leftStart; x++ )
+			AppendLine( o, "  ", a, x );
+		    for( l = 0; l < hs[ h ].leftCount; l++ )
+			AppendLine( o, hs[ h ].rightCount ? "! " : "- ", 
+				    a, x++ );
+		}
+		for( ; x < aTo; x++ )
+		    AppendLine( o, "  ", a, x );
+	    }
+
+	    o.Append( "--- " );
+	    AppendRange( o, bFrom, bTo - bFrom );
+	    o.Append( " ----\n" );
+	    if( anyRight )
+	    {
+		for( x = bFrom, h = g; h < k; h++ )
+		{
+		    for( ; x < hs[ h ].rightStart; x++ )
+			AppendLine( o, "  ", b, x );
+		    for( l = 0; l < hs[ h ].rightCount; l++ )
+			AppendLine( o, hs[ h ].leftCount ? "! " : "+ ", 
+				    b, x++ );
+		}
+		for( ; x < bTo; x++ )
+		    AppendLine( o, "  ", b, x );
+	    }
+	}
+	break;
+    }
+}
@@ -0,0 +1,111 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4textdiff.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Line-by-line comparison of texts held in memory. The
+ * 		  API's Diff class only works on files, so this is a
+ * 		  diff of our own (Myers' O(ND) algorithm in linear 
+ * 		  space) which produces the same formats as 'p4 diff'.
+ * 		  Batches of pairs are shared out between a pool of
+ * 		  native threads. Must not use Perl in any way.
+ *
+ ******************************************************************************/
+
+class P4TextDiff
+{
+    public:
+	enum Style { S_NORMAL, S_RCS, S_CONTEXT, S_UNIFIED, S_SUMMARY };
+	enum Ignore { I_NONE, I_ENDINGS, I_SPACE, I_ALLSPACE };
+
+	// A run of changed lines. Starts are line numbers from 1. Where a
+	// count is zero, the start is the line on that side after which
+	// the lines were added or deleted, so 0 means at the top.
+	struct Hunk
+	{
+	    int	leftStart;
+	    int	leftCount;
+	    int	rightStart;
+	    int	rightCount;
+	};
+
+		P4TextDiff();
+		~P4TextDiff();
+
+	// Flags as for 'p4 diff -d': n (RCS), c[N] (context), u[N]
+	// (unified) or s (summary), and b, w or l to ignore changes in
+	// whitespace, all whitespace, or line endings. Returns 0 with
+	// an error message if there's one we don't know.
+	int		SetFlags( const char *flags, StrBuf *error );
+
+	// Whether to format the output as text or just find the hunks
+	void		SetFormat( int f )	{ format = f;		}
+
+	// The texts must stay put until the diff is destroyed
+	void		Add( const char *left, int leftLen, 
+			     const char *right, int rightLen );
+	void		Run( int threads );
+
+	int		Count()			{ return count;		}
+	const StrPtr &	Output( int i )		{ return pairs[ i ].output; }
+	int		HunkCount( int i )	{ return pairs[ i ].nHunks; }
+	Hunk		GetHunk( int i, int h );
+
+    private:
+	struct Pair
+	{
+	    const char *	left;
+	    int			leftLen;
+	    const char *	right;
+	    int			rightLen;
+	    StrBuf		output;
+	    Hunk *		hunks;		// Starting from 0 here
+	    int			nHunks;
+	};
+
+	static void	WorkerThread( void *arg );
+	void		Work();
+	void		Compare( Pair &p );
+
+    private:
+	Pair *		pairs;
+	int		count;
+	int		max;
+
+	int		style;
+	int		ignore;
+	int		context;
+	int		format;
+
+	// The next pair to be picked up by a worker
+	P4Mutex		lock;
+	int		next;
+};
@@ -0,0 +1,268 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4ticketcache.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Caching of login tickets. Must not use Perl in any way.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <clientapi.h>
+#include <msgserver.h>
+#include "p4perlsys.h"
+#include "p4ticketcache.h"
+
+P4Mutex		P4TicketCache::lock;
+StrBufDict	P4TicketCache::tickets;
+
+//
+// The same form as the p4tickets file: "port=user:ticket"
+//
+void
+P4TicketCache::Key( const StrPtr &port, const StrPtr &user, StrBuf &key )
+{
+    key.Clear();
+    key << port << "=" << user;
+}
+
+int
+P4TicketCache::Find( const StrPtr &port, const StrPtr &user, 
+		     const char *file, StrBuf &ticket )
+{
+    StrBuf	key;
+    P4Lock	l( lock );
+
+    Key( port, user, key );
+
+    StrPtr	*t = tickets.GetVar( key );
+    if( t && t->Length() )
+    {
+	ticket.Set( *t );
+	return 1;
+    }
+
+    if( !file || !ReadFile( file, key, ticket ) )
+	return 0;
+
+    tickets.SetVar( key, ticket );
+    return 1;
+}
+
+void
+P4TicketCache::Store( const StrPtr &port, const StrPtr &user, 
+		      const char *file, const StrPtr &ticket )
+{
+    StrBuf	key;
+    P4Lock	l( lock );
+
+    Key( port, user, key );
+    tickets.SetVar( key, ticket );
+    if( file )
+	UpdateFile( file, key, &ticket );
+}
+
+void
+P4TicketCache::Forget( const StrPtr &port, const StrPtr &user, 
+		       const char *file )
+{
+    StrBuf	key;
+    P4Lock	l( lock );
+
+    Key( port, user, key );
+    tickets.SetVar( key, StrRef( "" ) );
+    if( file )
+	UpdateFile( file, key, 0 );
+}
+
+//
+// The server's ways of saying that the password or ticket we sent is no
+// good. Other configuration errors (no such client, an expired password
+// and so on) won't be fixed by logging in again.
+//
+static const ErrorId *authErrors[] = {
+    &MsgServer::BadPassword,
+    &MsgServer::BadPassword0,
+    &MsgServer::BadPassword1,
+    &MsgServer::LoginExpired,
+    0
+};
+
+int
+P4TicketCache::IsAuthError( Error *e )
+{
+    ErrorId	*id;
+
+    if( e->GetSeverity() < E_FAILED || !( id = e->GetId( 0 ) ) )
+	return 0;
+
+    for( const ErrorId **a = authErrors; *a; a++ )
+	if( id->UniqueCode() == (*a)->UniqueCode() )
+	    return 1;
+
+    return 0;
+}
+
+int
+P4TicketCache::ReadFile( const char *file, const StrPtr &key, 
+			 StrBuf &ticket )
+{
+    FILE	*fp = fopen( file, "r" );
+    char	line[ 1024 ];
+    int		found = 0;
+
+    if( !fp )
+	return 0;
+
+    while( fgets( line, sizeof( line ), fp ) )
+    {
+	char *t = strrchr( line, ':' );
+	if( !t || t - line != key.Length() || 
+	    strncmp( line, key.Text(), key.Length() ) )
+	    continue;
+
+	ticket.Set( t + 1, strcspn( t + 1, "\r\n" ) );
+	found = ticket.Length() > 0;
+    }
+
+    fclose( fp );
+    return found;
+}
+
+//
+// Rewrite the file with the entry for key replaced (or removed if there's
+// no ticket). It's written to a temporary file that only we can read and
+// renamed into place, so other processes never see half of it.
+//
+void
+P4TicketCache::UpdateFile( const char *file, const StrPtr &key, 
+			   const StrPtr *ticket )
+{
+    StrBuf	tmp;
+    char	line[ 1024 ];
+    FILE	*in = fopen( file, "r" );
+    FILE	*out;
+
+    tmp << file << "." << P4PerlSys::GetPid();
+    if( !( out = P4PerlSys::OpenPrivate( tmp.Text() ) ) )
+    {
+	if( in ) fclose( in );
+	return;
+    }
+
+    while( in && fgets( line, sizeof( line ), in ) )
+    {
+	char *t = strrchr( line, ':' );
+	if( t && t - line == key.Length() && 
+	    !strncmp( line, key.Text(), key.Length() ) )
+	    continue;
+	fputs( line, out );
+    }
+
+    if( ticket )
+	fprintf( out, "%s:%s\n", key.Text(), ticket->Text() );
+
+    int	ok = !ferror( out );
+    if( fclose( out ) )
+	ok = 0;
+    if( in )
+	fclose( in );
+
+    if( !ok || !P4PerlSys::Rename( tmp.Text(), file ) )
+	remove( tmp.Text() );
+}
+
+P4LoginUser::P4LoginUser( ClientUser *to, const StrPtr &password )
+{
+    this->to = to;
+    this->password.Set( password );
+    failed = 0;
+}
+
+void
+P4LoginUser::HandleError( Error *e )
+{
+    if( e->Test() && !e->IsInfo() && !e->IsWarning() )
+	failed = 1;
+    to->HandleError( e );
+}
+
+void
+P4LoginUser::OutputInfo( char level, const_char *data )
+{
+    if( !IsTicket( data, strlen( data ) ) )
+	to->OutputInfo( level, data );
+}
+
+void
+P4LoginUser::OutputText( const_char *data, int length )
+{
+    if( !IsTicket( data, length ) )
+	to->OutputText( data, length );
+}
+
+void
+P4LoginUser::OutputStat( StrDict *values )
+{
+    StrRef	var, val;
+
+    for( int i = 0; values->GetVar( i, var, val ); i++ )
+	IsTicket( val.Text(), val.Length() );
+    to->OutputStat( values );
+}
+
+void
+P4LoginUser::Prompt( const StrPtr &msg, StrBuf &rsp, int noEcho, Error *e )
+{
+    rsp.Set( password );
+}
+
+//
+// Tickets are 32 hex digits, on a line of their own
+//
+int
+P4LoginUser::IsTicket( const char *data, int length )
+{
+    while( length && isspace( (unsigned char) data[ length - 1 ] ) )
+	length--;
+
+    if( length != 32 )
+	return 0;
+
+    for( int i = 0; i < length; i++ )
+	if( !isxdigit( (unsigned char) data[ i ] ) )
+	    return 0;
+
+    ticket.Set( data, length );
+    return 1;
+}
@@ -0,0 +1,101 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4ticketcache.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: Tickets from 'p4 login -p', kept for the life of the
+ * 		  process (and so inherited by children) and optionally 
+ * 		  in a file of our own, keyed by server and user. New
+ * 		  connections use a cached ticket instead of logging in
+ * 		  again. Must not use Perl in any way.
+ *
+ ******************************************************************************/
+
+class P4TicketCache
+{
+    public:
+	// A ticket for the user on the server, from memory or else from 
+	// the file (which may be null). Returns 0 if we don't have one.
+	static int	Find( const StrPtr &port, const StrPtr &user, 
+			      const char *file, StrBuf &ticket );
+
+	static void	Store( const StrPtr &port, const StrPtr &user, 
+			       const char *file, const StrPtr &ticket );
+
+	// When the server no longer accepts a ticket
+	static void	Forget( const StrPtr &port, const StrPtr &user, 
+				const char *file );
+
+	static void	AfterFork()		{ lock.AfterFork();	}
+
+	// Whether an error means we need to log in (again): the server
+	// rejected our password or ticket before running the command.
+	static int	IsAuthError( Error *e );
+
+    private:
+	static void	Key( const StrPtr &port, const StrPtr &user, 
+			     StrBuf &key );
+	static int	ReadFile( const char *file, const StrPtr &key, 
+				  StrBuf &ticket );
+	static void	UpdateFile( const char *file, const StrPtr &key, 
+				    const StrPtr *ticket );
+
+	static P4Mutex		lock;
+	static StrBufDict	tickets;
+};
+
+//
+// Runs 'login -p', answering the password prompt and picking the ticket
+// out of the output. Everything else is passed on.
+//
+class P4LoginUser : public ClientUser
+{
+    public:
+		P4LoginUser( ClientUser *to, const StrPtr &password );
+
+	void	HandleError( Error *e );
+	void	OutputInfo( char level, const_char *data );
+	void	OutputText( const_char *data, int length );
+	void	OutputStat( StrDict *values );
+	void	Prompt( const StrPtr &msg, StrBuf &rsp, int noEcho, Error *e );
+
+	int		Failed()		{ return failed;	}
+	const StrPtr &	Ticket()		{ return ticket;	}
+
+    private:
+	int	IsTicket( const char *data, int length );
+
+    private:
+	ClientUser *	to;
+	StrBuf		password;
+	StrBuf		ticket;
+	int		failed;
+};
@@ -0,0 +1,129 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4utf8.cc
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: UTF-8 validation for values coming back from unicode
+ * 		  servers.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include "p4utf8.h"
+
+//
+// Length of the run of ASCII at the start of the buffer. Eight bytes are
+// tested at once by masking off everything but their top bits; memcpy()
+// keeps that safe on platforms that don't like unaligned loads, and the
+// compiler turns it into a single load where they don't mind.
+//
+int
+P4Utf8::AsciiPrefix( const unsigned char *p, int len )
+{
+    const unsigned long long	high = 0x8080808080808080ULL;
+    unsigned long long		w;
+    int				i = 0;
+
+    for( ; i + 8 <= len; i += 8 )
+    {
+	memcpy( &w, p + i, 8 );
+	if( w & high )
+	    break;
+    }
+
+    for( ; i < len && p[ i ] < 0x80; i++ )
+	;
+
+    return i;
+}
+
+int
+P4Utf8::IsAscii( const char *p, int len )
+{
+    return AsciiPrefix( (const unsigned char *) p, len ) == len;
+}
+
+//
+// Classify the buffer. Overlong forms, surrogates and anything beyond
+// U+10FFFF are rejected, as Perl's strict UTF-8 decoding would.
+//
+int
+P4Utf8::Scan( const char *s, int len )
+{
+    const unsigned char	*p = (const unsigned char *) s;
+    int			i = AsciiPrefix( p, len );
+    int			ascii = ( i == len );
+
+    while( i < len )
+    {
+	unsigned char	c = p[ i ];
+
+	if( c < 0x80 )
+	{
+	    i += AsciiPrefix( p + i, len - i );
+	    continue;
+	}
+
+	int		n;
+	unsigned char	lo = 0x80, hi = 0xbf;
+
+	if( c >= 0xc2 && c <= 0xdf )
+	    n = 1;
+	else if( c >= 0xe0 && c <= 0xef )
+	{
+	    n = 2;
+	    if( c == 0xe0 ) lo = 0xa0;		// overlong
+	    if( c == 0xed ) hi = 0x9f;		// surrogates
+	}
+	else if( c >= 0xf0 && c <= 0xf4 )
+	{
+	    n = 3;
+	    if( c == 0xf0 ) lo = 0x90;		// overlong
+	    if( c == 0xf4 ) hi = 0x8f;		// beyond U+10FFFF
+	}
+	else
+	    return U_INVALID;
+
+	if( len - i - 1 < n )
+	    return U_INVALID;
+
+	if( p[ i + 1 ] < lo || p[ i + 1 ] > hi )
+	    return U_INVALID;
+
+	for( int j = 2; j <= n; j++ )
+	    if( ( p[ i + j ] & 0xc0 ) != 0x80 )
+		return U_INVALID;
+
+	i += n + 1;
+    }
+
+    return ascii ? U_ASCII : U_VALID;
+}
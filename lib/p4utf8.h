@@ -0,0 +1,57 @@
+/*******************************************************************************
+
+Copyright (c) 2026, the P4Perl contributors.  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL PERFORCE SOFTWARE, INC. BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/*******************************************************************************
+ * Name		: p4utf8.h
+ *
+ * Author	: The P4Perl contributors
+ *
+ * Description	: UTF-8 validation for values coming back from unicode
+ * 		  servers. Most values are plain ASCII, so the scan
+ * 		  checks a machine word at a time until it finds a byte
+ * 		  with the top bit set, and only then decodes sequences
+ * 		  one by one. Must not use Perl in any way.
+ *
+ ******************************************************************************/
+
+class P4Utf8
+{
+    public:
+	enum Result
+	{
+	    U_ASCII,		// No bytes above 0x7f
+	    U_VALID,		// Well-formed UTF-8 with some multibyte chars
+	    U_INVALID		// Not UTF-8 at all
+	};
+
+	static int	Scan( const char *p, int len );
+	static int	IsAscii( const char *p, int len );
+
+    private:
+	static int	AsciiPrefix( const unsigned char *p, int len );
+};
@@ -52,10 +52,99 @@ extern "C"
 # undef Error
 #endif
 #include "p4result.h"
+#include "p4arena.h"
+#include "p4filter.h"
+#include "p4aggregate.h"
+#include "p4fieldtypes.h"
+#include "p4intern.h"
 #include "p4perldebug.h"
+#include "p4perlsys.h"
+#include "p4breaker.h"
+#include "p4batch.h"
+#include "bufferedclientuser.h"
+#include "p4iterator.h"
+#include "p4index.h"
+#include "p4specparser.h"
+#include "p4specsaver.h"
+#include "p4textdiff.h"
+#include "p4scanner.h"
+#include "p4fanout.h"
+#include "p4router.h"
+#include "p4splitter.h"
+#include "p4ticketcache.h"
+#include "p4progress.h"
 #include "perlclientuser.h"
 #include "perlclientapi.h"
 
+//
+// Commands which only read from the server, and which are therefore safe
+// to run a second time if the connection drops part way through.
+//
+static const char *readOnlyCommands[] = {
+    "annotate", "branches", "changes", "changelists", "clients", "counters",
+    "depots", "describe", "diff2", "dirs", "filelog", "files", "fixes",
+    "fstat", "groups", "have", "info", "interchanges", "jobs", "labels",
+    "opened", "print", "sizes", "users", "where", "workspaces",
+    0
+};
+
+//
+// Commands with a form, for which -o means fetching it. Other commands
+// use -o for other things: 'integrate -o' and 'resolve -o' both write.
+//
+static const char *specCommands[] = {
+    "branch", "change", "client", "depot", "group", "job", "label", 
+    "ldap", "protect", "remote", "server", "spec", "stream", "triggers",
+    "typemap", "user", "workspace",
+    0
+};
+
+static int
+IsReadOnlyCommand( const char *cmd, int argc, char * const *argv )
+{
+    const char **c;
+
+    // Fetching a form never changes anything
+    if( argc && !strcmp( argv[ 0 ], "-o" ) )
+	for( c = specCommands; *c; c++ )
+	    if( !strcmp( cmd, *c ) )
+		return 1;
+
+    for( c = readOnlyCommands; *c; c++ )
+	if( !strcmp( cmd, *c ) )
+	    return 1;
+
+    return 0;
+}
+
+//
+// ClientUser that discards everything. Used for keepalive traffic, which
+// runs on a thread of its own and so must stay well away from Perl.
+//
+class NullClientUser : public ClientUser
+{
+    public:
+	void	HandleError( Error *e )				{}
+	void	OutputText( const_char *data, int length )	{}
+	void	OutputInfo( char level, const_char *data )	{}
+	void	OutputStat( StrDict *values )			{}
+	void	OutputBinary( const_char *data, int length )	{}
+};
+
+//
+// Initialise a connection, noting its socket so that a child process
+// can let go of it without disturbing us (see CheckFork()).
+//
+static void
+InitConnection( ClientApi *c, Error *e )
+{
+    P4Sockets	s;
+
+    s.Before();
+    c->Init( e );
+    s.After();
+}
+
 PerlClientApi::PerlClientApi()
 {
     Enviro	env;
@@ -65,35 +154,152 @@ PerlClientApi::PerlClientApi()
     initCount 	= 0;
     debug	= 0;
     compatFlags	= 0;
+    utf8Values	= 0;
     maxResults	= 0;
     maxScanRows = 0;
     server2	= 0;
     prog	= "P4Perl script";
 
+    reconnectAttempts	= 0;
+    reconnectMaxWait	= 0;
+    keepAliveInterval	= 0;
+    keepAlivePending	= 0;
+    keepAliveStop	= 0;
+    lastActivity	= P4PerlSys::Now();
+    ownerPid		= P4PerlSys::GetPid();
+    connectOnUse	= 0;
+    filter		= 0;
+    aggregate		= 0;
+    batchFiles		= 0;
+    batchBytes		= 0;
+    batchConnections	= 1;
+    batchClients	= 0;
+    batchClientCount	= 0;
+    batchClientMax	= 0;
+    lastBatch		= 0;
+    index		= 0;
+    router		= 0;
+    splitConnections	= 0;
+    splitCount		= 0;
+    ticketCache		= 0;
+    passwordSaved	= 0;
+
     if( char *c = env.Get( "P4CHARSET" ) )
 	SetCharset( c );
 }
 
 PerlClientApi::~PerlClientApi()
 {
+    CheckFork( 0 );
+    SetKeepAlive( 0 );
     Disconnect();
+    delete filter;
+    delete aggregate;
+    delete lastBatch;
+    delete index;
+    delete router;
+    delete [] batchClients;
     delete ui;
     delete client;
 }
 
+//
+// Make a copy of this object for use in a new Perl interpreter (i.e. when
+// a Perl thread is created). We must not share our ClientApi, so the copy
+// gets one of its own with the same settings. If we were connected, the
+// copy will connect when it's first used in the new thread. Note that
+// this is called from within perl_clone(), so any SVs created here belong
+// to the new interpreter.
+//
+PerlClientApi *
+PerlClientApi::Clone()
+{
+    PerlClientApi *	c = new PerlClientApi;
+    StrRef		var, val;
+    int			i;
+
+    ApplySettings( c->client );
+
+    for( i = 0; protocols.GetVar( i, var, val ); i++ )
+	c->protocols.SetVar( var.Text(), val.Text() );
+    for( i = 0; specDict.GetVar( i, var, val ); i++ )
+	c->specDict.SetVar( var.Text(), val );
+
+    c->prog		= prog;
+    c->mode		= mode;
+    c->server2		= server2;
+    c->compatFlags	= compatFlags;
+    c->maxResults	= maxResults;
+    c->maxScanRows	= maxScanRows;
+    c->reconnectAttempts	= reconnectAttempts;
+    c->reconnectMaxWait	= reconnectMaxWait;
+    c->connectOnUse	= initCount || connectOnUse;
+    c->ticketCache	= ticketCache;
+    c->ticketFile	= ticketFile;
+    c->loginPassword	= loginPassword;
+    c->passwordSaved	= passwordSaved;
+
+    if( router )
+    {
+	c->router = new P4Router;
+	c->router->SetLagWindow( router->LagWindow() );
+	for( i = 0; i < router->Count(); i++ )
+	    c->router->AddReplica( router->Port( i ).Text() );
+    }
+
+    // Starting a thread inside perl_clone() isn't safe, so the copy's
+    // keepalive thread waits for its first command
+    c->keepAliveInterval = keepAliveInterval;
+    c->keepAlivePending	 = keepAliveInterval > 0;
+
+    c->SetDebugLevel( debug );
+    c->MergeOutput( ui->GetResults().IsMergeOutput() );
+    c->TypedValues( ui->IsTypedValues() );
+    c->ui->FieldTypes().CopyOverrides( ui->FieldTypes() );
+    c->InternValues( ui->Interner().GetMode() );
+    c->SetTimeLimit( ui->TimeLimit() );
+    c->SetBudget( ui->GetResults().MaxRecords(), 
+		  ui->GetResults().MaxBytes() );
+    c->SetCancelOnSignal( ui->IsCancelOnSignal() );
+    return c;
+}
+
+int
+PerlClientApi::IsConnected()
+{
+    if( connectOnUse )
+    {
+	connectOnUse = 0;
+	Connect();
+    }
+    return initCount;
+}
+
 SV *
 PerlClientApi::Connect()
 {
     Error	e;
 
+    CheckFork();
+    connectOnUse = 0;
     if( initCount )
 	return &PL_sv_yes;
 
-    client->Init( &e );
+    if( ticketCache )
+	UseCachedTicket();
+
+    {
+	P4Lock	l( apiLock );
+	InitConnection( client, &e );
+	if( !e.Test() )
+	{
+	    initCount++;
+	    lastActivity = P4PerlSys::Now();
+	}
+    }
+
     if( e.Test() )
 	ui->HandleError( &e );
-    else
-	initCount++;
 
     return initCount ? &PL_sv_yes : &PL_sv_no;
 }
@@ -101,12 +307,19 @@ PerlClientApi::Connect()
 SV *
 PerlClientApi::Disconnect()
 {
+    CheckFork( 0 );
+    DisconnectBatchClients();
+    if( router )
+	router->Disconnect();
     if( !initCount )
 	return &PL_sv_yes;
 
     Error e;
-    client->Final( &e );
-    initCount--;
+    {
+	P4Lock	l( apiLock );
+	client->Final( &e );
+	initCount--;
+    }
 
     if( e.Test() ) 
 	ui->HandleError( &e );
@@ -116,7 +329,14 @@ PerlClientApi::Disconnect()
 SV *
 PerlClientApi::Dropped()
 {
-    return newSViv( client->Dropped() );
+    return newSViv( IsDropped() );
+}
+
+int
+PerlClientApi::IsDropped()
+{
+    P4Lock	l( apiLock );
+    return client->Dropped();
 }
 
 void
@@ -130,7 +350,7 @@ PerlClientApi::SetApiLevel( int level )
 {
     StrBuf	l;
     l << level;
-    client->SetProtocol( "api", l.Text() );
+    SetProtocol( "api", l.Text() );
 }
 
 SV *
@@ -142,8 +362,12 @@ PerlClientApi::SetCharset( const char *c )
 	warn( "Unknown charset ignored. Check your code or P4CHARSET." );
 	return &PL_sv_undef;
     }
-    client->SetTrans( cs, cs, cs, cs );
-    client->SetCharset( c );
+    {
+	P4Lock	l( apiLock );
+	client->SetTrans( cs, cs, cs, cs );
+	client->SetCharset( c );
+    }
+    UpdateUtf8();
     return &PL_sv_yes;
 }
 
@@ -151,6 +375,7 @@ PerlClientApi::SetCharset( const char *c )
 SV *
 PerlClientApi::GetCharset()
 {
+    P4Lock	l( apiLock );
     const StrPtr &c = client->GetCharset();
     return newSVpv( c.Text(), c.Length() );
 }
@@ -158,6 +383,7 @@ PerlClientApi::GetCharset()
 SV *
 PerlClientApi::GetClient()
 {
+    P4Lock	l( apiLock );
     const StrPtr &c = client->GetClient();
     return newSVpv( c.Text(), c.Length() );
 }
@@ -166,6 +392,7 @@ PerlClientApi::GetClient()
 SV *
 PerlClientApi::GetCwd()
 {
+    P4Lock	l( apiLock );
     const StrPtr &c = client->GetCwd();
     return newSVpv( c.Text(), c.Length() );
 }
@@ -174,6 +401,7 @@ PerlClientApi::GetCwd()
 SV *
 PerlClientApi::GetHost()
 {
+    P4Lock	l( apiLock );
     const StrPtr &c = client->GetHost();
     return newSVpv( c.Text(), c.Length() );
 }
@@ -182,6 +410,7 @@ PerlClientApi::GetHost()
 SV *
 PerlClientApi::GetLanguage()
 {
+    P4Lock	l( apiLock );
     const StrPtr &c = client->GetLanguage();
     return newSVpv( c.Text(), c.Length() );
 }
@@ -190,6 +419,7 @@ PerlClientApi::GetLanguage()
 SV *
 PerlClientApi::GetPassword()
 {
+    P4Lock	l( apiLock );
     const StrPtr &c = client->GetPassword();
     return newSVpv( c.Text(), c.Length() );
 }
@@ -198,6 +428,7 @@ PerlClientApi::GetPassword()
 SV *
 PerlClientApi::GetPort()
 {
+    P4Lock	l( apiLock );
     const StrPtr &c = client->GetPort();
     return newSVpv( c.Text(), c.Length() );
 }
@@ -205,14 +436,77 @@ PerlClientApi::GetPort()
 SV *
 PerlClientApi::GetUser()
 {
+    P4Lock	l( apiLock );
     const StrPtr &c = client->GetUser();
     return newSVpv( c.Text(), c.Length() );
 }
-
+
+//
+// The keepalive thread may be using the connection, so settings are only
+// changed (or read: the API fills some in on demand) under apiLock.
+//
+void
+PerlClientApi::SetClient( const char *c )
+{
+    P4Lock	l( apiLock );
+    client->SetClient( c );
+}
+
+void
+PerlClientApi::SetCwd( const char *c )
+{
+    P4Lock	l( apiLock );
+    client->SetCwd( c );
+}
+
+void
+PerlClientApi::SetHost( const char *c )
+{
+    P4Lock	l( apiLock );
+    client->SetHost( c );
+}
+
+void
+PerlClientApi::SetLanguage( const char *c )
+{
+    P4Lock	l( apiLock );
+    client->SetLanguage( c );
+}
+
+void
+PerlClientApi::SetPassword( const char *c )
+{
+    P4Lock	l( apiLock );
+    client->SetPassword( c );
+    loginPassword.Clear();
+    passwordSaved = 0;
+}
+
+void
+PerlClientApi::SetPort( const char *c )
+{
+    P4Lock	l( apiLock );
+    client->SetPort( c );
+}
+
+void
+PerlClientApi::SetUser( const char *c )
+{
+    P4Lock	l( apiLock );
+    client->SetUser( c );
+}
+
 void
 PerlClientApi::SetProtocol( const char *p, const char *v )
 {
-    client->SetProtocol( p, v );
+    {
+	P4Lock	l( apiLock );
+	client->SetProtocol( p, v );
+    }
+
+    // Remember it so that it can be replayed on a new connection
+    protocols.SetVar( p, v );
+
     if( !strcmp( p, "tag" ) )
 	mode |= PROTO_TAG;
     else if( !strcmp( p, "specstring" ) )
@@ -222,6 +516,7 @@ PerlClientApi::SetProtocol( const char *p, const char *v )
 StrPtr *
 PerlClientApi::GetProtocol( const char *v )
 {
+    P4Lock	l( apiLock );
     return client->GetProtocol( v );
 }
 
@@ -270,6 +565,18 @@ PerlClientApi::MergeErrors( int merge )
 }
 
 
+SV *
+PerlClientApi::MergeOutput( int merge )
+{
+    P4Result &	r = ui->GetResults();
+
+    if( merge >= 0 )
+	r.SetMergeOutput( merge );
+
+    return newSViv( r.IsMergeOutput() );
+}
+
+
 SV *
 PerlClientApi::GetFirstOutput()
 {
@@ -278,6 +585,121 @@ PerlClientApi::GetFirstOutput()
     return s ? *s : 0;
 }
 
+SV *
+PerlClientApi::TypedValues( int typed )
+{
+    if( typed >= 0 )
+	ui->SetTypedValues( typed );
+
+    return newSViv( ui->IsTypedValues() );
+}
+
+SV *
+PerlClientApi::Utf8Values( int utf8 )
+{
+    if( utf8 >= 0 )
+    {
+	utf8Values = utf8;
+	UpdateUtf8();
+    }
+
+    return newSViv( utf8Values );
+}
+
+//
+// Values only need flagging when the API hands us UTF-8, which is when
+// the charset is utf8 (or a variant such as utf8-bom). That's also when
+// there's no translation at all: the API passes the server's UTF-8
+// straight through, and we just flag it rather than have it decoded.
+//
+void
+PerlClientApi::UpdateUtf8()
+{
+    int	u;
+    {
+	P4Lock	l( apiLock );
+	const StrPtr &cs = client->GetCharset();
+	u = utf8Values && !strncmp( cs.Text(), "utf8", 4 );
+    }
+
+    if( P4PERL_DEBUG_FLOW )
+	printf( "[PerlClientApi::UpdateUtf8]: UTF-8 values %s\n",
+		u ? "enabled" : "disabled" );
+
+    ui->GetResults().SetUtf8( u );
+}
+
+//
+// Interning of short repetitive values: 0 for off, 1 for copies sharing
+// a string buffer, 2 for shared read-only scalars.
+//
+SV *
+PerlClientApi::InternValues( int mode )
+{
+    P4Interner &	i = ui->Interner();
+
+    if( mode >= 0 )
+	i.SetMode( mode > P4Interner::I_SHARED ? P4Interner::I_SHARED : mode );
+
+    return newSViv( i.GetMode() );
+}
+
+//
+// Progress reporting. The callback is called with a hash of statistics
+// at most every 'interval' seconds while a command runs, and at the end.
+//
+void
+PerlClientApi::SetProgress( SV *cb, double interval )
+{
+    ui->SetProgress( cb, interval );
+}
+
+HV *
+PerlClientApi::GetProgressStats()
+{
+    return ui->ProgressHash( 1 );
+}
+
+HV *
+PerlClientApi::GetInternStats()
+{
+    P4Interner &	i = ui->Interner();
+    HV *		hv = newHV();
+
+    hv_store( hv, "lookups", 7, newSViv( i.Lookups() ), 0 );
+    hv_store( hv, "hits", 4, newSViv( i.Hits() ), 0 );
+    hv_store( hv, "entries", 7, newSViv( i.Entries() ), 0 );
+    hv_store( hv, "hitRate", 7, 
+	      newSVnv( i.Lookups() ? (NV) i.Hits() / i.Lookups() : 0 ), 0 );
+    return hv;
+}
+
+//
+// Override the type of a field, for one command or (if cmd is null) for
+// all of them. The type is "int", "num" or "string".
+//
+SV *
+PerlClientApi::SetFieldType( const char *field, const char *type, 
+			     const char *cmd )
+{
+    P4FieldTypes::Type	t;
+
+    if( !strcmp( type, "int" ) )
+	t = P4FieldTypes::T_INT;
+    else if( !strcmp( type, "num" ) )
+	t = P4FieldTypes::T_NUM;
+    else if( !strcmp( type, "string" ) )
+	t = P4FieldTypes::T_STRING;
+    else
+    {
+	warn( "Unknown field type '%s': use int, num or string", type );
+	return &PL_sv_undef;
+    }
+
+    ui->FieldTypes().Set( field, t, cmd );
+    return &PL_sv_yes;
+}
+
 AV *
 PerlClientApi::GetOutput()
 {
@@ -314,6 +736,18 @@ PerlClientApi::GetErrorCount()
     return ui->GetResults().ErrorCount();
 }
 
+I32
+PerlClientApi::GetMessageCount( int generic )
+{
+    return ui->GetResults().MessageCount( generic );
+}
+
+AV *
+PerlClientApi::GetMessages( int generic, int code, int text )
+{
+    return ui->GetResults().GetMessages( generic, code, text );
+}
+
 void
 PerlClientApi::SetDebugLevel( int l )
 {
@@ -325,125 +759,2068 @@ PerlClientApi::SetDebugLevel( int l )
 	p4debug.SetLevel( DT_RPC, 0 );
 }
 
+//
+// Set a filter for the tagged output of the next command. Records which
+// don't match are dropped before they're converted into Perl hashes.
+//
 SV *
-PerlClientApi::Run( const char *cmd, int argc, char * const *argv )
+PerlClientApi::SetFilter( const char *expr )
 {
-    ui->Reset( compatFlags & CPT_MERGED );
+    delete filter;
+    filter = 0;
 
-    RunCmd( cmd, ui, argc, argv );
+    if( !expr || !*expr )
+	return &PL_sv_yes;
 
-    // 
-    // Save the specdef for this command...
-    //
-    if( ui->LastSpecDef().Length() )
-	specDict.SetVar( cmd, ui->LastSpecDef() );
+    StrBuf	msg;
+    filter = new P4Filter;
+    if( !filter->Compile( expr, msg ) )
+    {
+	warn( "%s", msg.Text() );
+	delete filter;
+	filter = 0;
+	return &PL_sv_undef;
+    }
+    return &PL_sv_yes;
+}
 
-    return newRV( (SV*) GetOutput() );
+I32
+PerlClientApi::GetFilteredCount()
+{
+    return ui->FilteredCount();
 }
 
 //
-// RunCmd is a private function to work around an obscure protocol
-// bug in 2000.[12] servers. Running a "p4 -Ztag client -o" messes up the
-// protocol so if they're running this command then we disconnect and
-// reconnect to refresh it. For efficiency, we only do this if the 
-// server2 protocol is either 9 or 10 as other versions aren't affected.
+// Aggregate the tagged output of the next command. The spec is a hash:
 //
-void
-PerlClientApi::RunCmd( const char *cmd, ClientUser *ui, int argc, char * const *argv )
+//   group     => field name(s) to group by. "field:N" keeps only the
+//                first N levels of a depot path.
+//   sum/min/max => numeric field name(s) to summarise
+//   order     => column to sort on: "count", "sum(field)" etc., or in
+//                record mode a field name. Descending unless ascending
+//                is true.
+//   top       => keep only this many rows
+//
+// With no group and no sum/min/max, but a top and an order, the top
+// records themselves are returned instead.
+//
+static int
+AggregateFields( HV *spec, const char *key, 
+		 P4Aggregate *a, int group, P4Aggregate::Function f )
 {
-    // If maxresults or maxscanrows is set, enforce them now
-    if( maxResults  )	client->SetVar( "maxResults",  maxResults  );
-    if( maxScanRows )	client->SetVar( "maxScanRows", maxScanRows );
-
-#if P4API_VERSION >= 513026
-    // SetProg first introduced in 2004.2. [ 513026 = ( 2004 << 8 | 2 ) ]
-    client->SetProg( prog.Text() );
-#endif
-    client->SetArgv( argc, argv );
-    client->Run( cmd, ui );
+    SV **	svp = hv_fetch( spec, key, strlen( key ), 0 );
+    AV *	av = 0;
+    I32		n = 0;
 
-    // Have to request server2 protocol *after* a command has been run. I
-    // don't know why, but that's the way it is.
+    if( !svp || !SvOK( *svp ) )
+	return 1;
 
-    if ( ! server2 )
+    if( SvROK( *svp ) )
     {
-	StrPtr *pv = client->GetProtocol( "server2" );
-	if ( pv )
-	    server2 = pv->Atoi();
+	if( SvTYPE( SvRV( *svp ) ) != SVt_PVAV )
+	{
+	    warn( "Aggregate %s must be a field name or an array of them", key );
+	    return 0;
+	}
+	av = (AV *) SvRV( *svp );
+	n = av_len( av ) + 1;
     }
 
-    if ( IsTagged() && StrRef( cmd ) == "client" && 
-	 server2 >= 9    && server2 <= 10  )
+    for( I32 i = 0; i < ( av ? n : 1 ); i++ )
     {
-	if ( argc && ( StrRef( argv[ 0 ] ) == "-o" ) )
+	SV *sv = *svp;
+	if( av )
 	{
-	    if ( P4PERL_DEBUG_FLOW )
-		printf( "[P4::Run]: Resetting to avoid obscure 2000.[12] protocol bug\n" );
+	    SV **e = av_fetch( av, i, 0 );
+	    if( !e || !SvOK( *e ) ) continue;
+	    sv = *e;
+	}
 
-	    Error e;
-	    client->Final( &e );
-	    client->Init( &e );
+	StrBuf	field;
+	field = SvPV_nolen( sv );
 
-	    // Pass any errors down to the UI, so they'll get picked up.
-	    if ( e.Test() ) 
-		ui->HandleError( &e );
+	if( !group )
+	{
+	    a->AddColumn( f, field.Text() );
+	    continue;
+	}
+
+	int	depth = 0;
+	char	*colon = strrchr( field.Text(), ':' );
+	if( colon && colon[ 1 ] )
+	{
+	    depth = atoi( colon + 1 );
+	    if( depth <= 0 )
+	    {
+		warn( "Bad depot path depth in aggregate group '%s'", 
+			field.Text() );
+		return 0;
+	    }
+	    field.SetLength( colon - field.Text() );
+	    field.Terminate();
 	}
+	a->AddGroup( field.Text(), depth );
     }
+    return 1;
 }
 
-//
-// Convert a spec in string form into a hash and return a reference to that
-// hash.
-//
 SV *
-PerlClientApi::ParseSpec( const char *type, const char *form )
+PerlClientApi::SetAggregate( HV *spec )
 {
-    if( P4PERL_DEBUG_FORMS )
-	printf( "[ParseSpec]: Parsing a %s spec. Form is:\n%s\n", 
-		type, form );
+    static const char *known[] = { 
+	"group", "sum", "min", "max", "order", "ascending", "top", 0 
+    };
 
-    if( !IsParseForms() )
+    delete aggregate;
+    aggregate = 0;
+
+    if( !spec )
+	return &PL_sv_yes;
+
+    HE *	he;
+    hv_iterinit( spec );
+    while( ( he = hv_iternext( spec ) ) )
     {
-	warn( "P4::ParseSpec() requires ParseForms mode" );
-	return &PL_sv_undef;
-    }
+	I32	len;
+	char	*k = hv_iterkey( he, &len );
+	int	i;
 
-    StrPtr	*specDef = FetchSpecDef( type );
+	for( i = 0; known[ i ] && strcmp( known[ i ], k ); i++ )
+	    ;
 
-    if ( !specDef )
+	if( !known[ i ] )
+	{
+	    warn( "Unknown aggregate option '%s'", k );
+	    return &PL_sv_undef;
+	}
+    }
+
+    P4Aggregate *a = new P4Aggregate;
+    if( !AggregateFields( spec, "group", a, 1, P4Aggregate::A_SUM ) ||
+	!AggregateFields( spec, "sum", a, 0, P4Aggregate::A_SUM ) ||
+	!AggregateFields( spec, "min", a, 0, P4Aggregate::A_MIN ) ||
+	!AggregateFields( spec, "max", a, 0, P4Aggregate::A_MAX ) )
     {
-	StrBuf m;
-	m = "P4::ParseSpec(): No spec definition for ";
-	m.Append( type );
-	m.Append( " objects." );
-	warn( m.Text() );
+	delete a;
 	return &PL_sv_undef;
     }
 
-    // Got a specdef so now we can attempt to parse it.
-    
-    SpecDataTable	specData;
-    Spec		s( specDef->Text(), "" );
-    Error		e;
+    SV **svp;
+    if( ( svp = hv_fetch( spec, "top", 3, 0 ) ) && SvOK( *svp ) )
+	a->SetTop( SvIV( *svp ) );
 
-    s.ParseNoValid( form, &specData, &e );
-    if ( e.Test() )
+    if( ( svp = hv_fetch( spec, "order", 5, 0 ) ) && SvOK( *svp ) )
     {
-	//
-	// Report the error through the UI interface
-	//
-	ui->HandleError( &e );
-	return &PL_sv_undef;
-    }
+	SV **asc = hv_fetch( spec, "ascending", 9, 0 );
+	const char *order = SvPV_nolen( *svp );
 
-    // Now we've parsed it, convert it into a hash. We do that via 
+	if( !a->SetOrder( order, asc && SvTRUE( *asc ) ) )
+	{
+	    warn( "Can't order by '%s': no such aggregate column", order );
+	    delete a;
+	    return &PL_sv_undef;
+	}
+    }
+
+    aggregate = a;
+    return &PL_sv_yes;
+}
+
+SV *
+PerlClientApi::Run( const char *cmd, int argc, char * const *argv )
+{
+    char **	fargv = 0;
+    StrBuf	serverFilter;
+
+    if( keepAlivePending )
+	SetKeepAlive( keepAliveInterval );
+
+    ui->Reset( compatFlags & CPT_MERGED );
+    ui->SetCommand( cmd );
+
+    //
+    // Filters apply to one command only. If it's an fstat, and the user
+    // hasn't supplied a -F of their own, let the server do as much of
+    // the filtering as it can too.
+    //
+    if( filter )
+    {
+	ui->SetFilter( filter );
+
+	int	userFilter = 0;
+	for( int i = 0; i < argc; i++ )
+	    if( !strcmp( argv[ i ], "-F" ) )
+		userFilter = 1;
+
+	if( !strcmp( cmd, "fstat" ) && !userFilter && 
+	    filter->ServerFilter( serverFilter ) )
+	{
+	    if( P4PERL_DEBUG_CMDS )
+		printf( "[P4::Run]: Server filter is %s\n", serverFilter.Text() );
+
+	    fargv = new char *[ argc + 2 ];
+	    fargv[ 0 ] = (char *) "-F";
+	    fargv[ 1 ] = serverFilter.Text();
+	    for( int i = 0; i < argc; i++ )
+		fargv[ i + 2 ] = argv[ i ];
+
+	    argc += 2;
+	    argv = fargv;
+	}
+    }
+
+    if( aggregate )
+	ui->SetAggregate( aggregate );
+
+    int	batched = RunBatched( cmd, argc, argv );
+    int	routed = !batched && RunRouted( cmd, argc, argv );
+    if( !batched && !routed )
+	RunCmd( cmd, ui, argc, argv );
+
+    // Reads must not go to a replica that hasn't seen this yet
+    if( router && !IsReadOnlyCommand( cmd, argc, argv ) )
+	router->NoteWrite( P4PerlSys::Now() );
+
+    // Stopped commands are never retried
+    int	stopped = Stopped( cmd );
+
+    //
+    // In managed mode, a connection that was dropped while the command
+    // was running is re-established straight away. Read-only commands
+    // are then run again, once, so the caller never sees the failure.
+    // Batched commands aren't retried as some batches will have worked.
+    //
+    if( reconnectAttempts && initCount && IsDropped() && !batched &&
+	!routed && !stopped )
+    {
+	if( P4PERL_DEBUG_FLOW )
+	    printf( "[P4::Run]: Connection dropped running \"%s\"\n", cmd );
+
+	if( Reconnect() && IsReadOnlyCommand( cmd, argc, argv ) )
+	{
+	    ui->Reset( compatFlags & CPT_MERGED, 1 );
+	    if( aggregate ) aggregate->Reset();
+	    RunCmd( cmd, ui, argc, argv );
+	    stopped = Stopped( cmd );
+	}
+    }
+
+    //
+    // With ticket caching, a command refused because our ticket has 
+    // expired (or we never had one) is run again after logging in.
+    //
+    if( ticketCache && !batched && !routed && !stopped &&
+	ui->GetResults().AuthFailed() && !GetOutputCount() &&
+	HasLoginPassword() &&
+	strcmp( cmd, "login" ) && strcmp( cmd, "logout" ) )
+    {
+	NullClientUser	quiet;
+
+	if( P4PERL_DEBUG_FLOW )
+	    printf( "[P4::Run]: Logging in again to run \"%s\"\n", cmd );
+
+	{
+	    P4Lock	l( apiLock );
+	    P4TicketCache::Forget( client->GetPort(), client->GetUser(), 
+				   TicketFile() );
+	}
+	if( LoginNow( &quiet ) )
+	{
+	    ui->Reset( compatFlags & CPT_MERGED, 1 );
+	    if( aggregate ) aggregate->Reset();
+	    RunCmd( cmd, ui, argc, argv );
+	    stopped = Stopped( cmd );
+	}
+    }
+
+    splitCount = 0;
+    if( splitConnections && !stopped && ui->GetResults().LimitHit() )
+    {
+	RunSplit( cmd, argc, argv );
+	Stopped( cmd );
+    }
+
+    if( ui->HasProgress() )
+	ui->ReportProgress( 1 );
+
+    if( aggregate )
+    {
+	ui->AggregateResults();
+	ui->SetAggregate( 0 );
+	delete aggregate;
+	aggregate = 0;
+    }
+
+    if( filter )
+    {
+	ui->SetFilter( 0 );
+	delete filter;
+	filter = 0;
+	delete [] fargv;
+    }
+
+    // 
+    // Save the specdef for this command...
+    //
+    if( ui->LastSpecDef().Length() )
+	specDict.SetVar( cmd, ui->LastSpecDef() );
+
+    return newRV( (SV*) GetOutput() );
+}
+
+//
+// Limits on each command. A command still running after 'seconds', or
+// whose output goes over 'records' records or 'bytes' bytes, is stopped
+// and returns what it had so far. Zero means no limit.
+//
+void
+PerlClientApi::SetTimeLimit( double seconds )
+{
+    ui->SetTimeLimit( seconds > 0 ? seconds : 0 );
+}
+
+void
+PerlClientApi::SetBudget( int records, double bytes )
+{
+    ui->GetResults().SetBudget( records, bytes );
+}
+
+//
+// With this on, a signal that has a Perl handler stops the command it
+// arrives during. The handler then runs as soon as Run() returns.
+//
+void
+PerlClientApi::SetCancelOnSignal( int enable )
+{
+    ui->SetCancelOnSignal( enable );
+}
+
+//
+// Stop the command that's running: from a progress or input callback,
+// say. CancelAll() stops every command running in the process, and just
+// bumps a counter, so it's safe to call from any thread.
+//
+void
+PerlClientApi::Cancel()
+{
+    ui->Cancel();
+}
+
+void
+PerlClientApi::CancelAll()
+{
+    PerlClientUser::CancelAll();
+}
+
+//
+// Why the last command was stopped ("cancelled", "signal", "time", 
+// "records" or "bytes"), or 0 if it wasn't.
+//
+const char *
+PerlClientApi::Cancelled()
+{
+    return ui->StopName();
+}
+
+//
+// RunCmd is a private function to work around an obscure protocol
+// bug in 2000.[12] servers. Running a "p4 -Ztag client -o" messes up the
+// protocol so if they're running this command then we disconnect and
+// reconnect to refresh it. For efficiency, we only do this if the 
+// server2 protocol is either 9 or 10 as other versions aren't affected.
+//
+void
+PerlClientApi::RunCmd( const char *cmd, ClientUser *ui, int argc, char * const *argv )
+{
+    CheckFork();
+
+    // In managed mode, don't even try to use a connection we know is dead.
+    if( reconnectAttempts && initCount && IsDropped() )
+	Reconnect();
+
+    P4Lock	l( apiLock );
+
+    // If maxresults or maxscanrows is set, enforce them now
+    if( maxResults  )	client->SetVar( "maxResults",  maxResults  );
+    if( maxScanRows )	client->SetVar( "maxScanRows", maxScanRows );
+
+#if P4API_VERSION >= 513026
+    // SetProg first introduced in 2004.2. [ 513026 = ( 2004 << 8 | 2 ) ]
+    client->SetProg( prog.Text() );
+#endif
+    client->SetArgv( argc, argv );
+
+    // Our own UI can stop the command part way through
+    int	breakable = ( ui == this->ui );
+    if( breakable )
+	client->SetBreak( this->ui );
+
+    client->Run( cmd, ui );
+
+    if( breakable )
+	client->SetBreak( 0 );
+
+    // Have to request server2 protocol *after* a command has been run. I
+    // don't know why, but that's the way it is.
+
+    if ( ! server2 )
+    {
+	StrPtr *pv = client->GetProtocol( "server2" );
+	if ( pv )
+	    server2 = pv->Atoi();
+    }
+
+    if ( IsTagged() && StrRef( cmd ) == "client" && 
+	 server2 >= 9    && server2 <= 10  )
+    {
+	if ( argc && ( StrRef( argv[ 0 ] ) == "-o" ) )
+	{
+	    if ( P4PERL_DEBUG_FLOW )
+		printf( "[P4::Run]: Resetting to avoid obscure 2000.[12] protocol bug\n" );
+
+	    Error e;
+	    client->Final( &e );
+	    InitConnection( client, &e );
+
+	    // Pass any errors down to the UI, so they'll get picked up.
+	    if ( e.Test() ) 
+		ui->HandleError( &e );
+	}
+    }
+
+    lastActivity = P4PerlSys::Now();
+}
+
+//
+// Argument batching. Commands with more than 'files' file arguments, or
+// whose file arguments add up to more than 'bytes', are split into a
+// series of smaller commands, each given the original options. With more
+// than one connection, the batches are run in parallel on connections of
+// their own and their output replayed in order. Zero disables a limit.
+//
+void
+PerlClientApi::SetBatching( int files, int bytes, int connections )
+{
+    batchFiles = files > 0 ? files : 0;
+    batchBytes = bytes > 0 ? bytes : 0;
+    batchConnections = connections > 1 ? connections : 1;
+
+    if( batchClientCount > batchConnections )
+	DisconnectBatchClients();
+}
+
+//
+// Returns 0 if the command doesn't need splitting, and should be run
+// the usual way.
+//
+int
+PerlClientApi::RunBatched( const char *cmd, int argc, char * const *argv )
+{
+    delete lastBatch;
+    lastBatch = 0;
+
+    if( !batchFiles && !batchBytes )
+	return 0;
+
+    P4Batch *b = new P4Batch( cmd, argc, argv, batchFiles, batchBytes );
+    if( b->Count() < 2 )
+    {
+	delete b;
+	return 0;
+    }
+    lastBatch = b;
+
+    if( P4PERL_DEBUG_CMDS )
+	printf( "[P4::Run]: Running \"%s\" in %d batches\n", cmd, b->Count() );
+
+    int	n = batchConnections > 1 ? ConnectBatchClients( batchConnections ) : 0;
+    if( n )
+    {
+	b->RunParallel( batchClients, n, cmd, prog.Text(),
+			maxResults, maxScanRows, ui );
+
+	for( int i = 0; i < b->Count() && !ui->StopReason(); i++ )
+	    b->Replay( i, ui );
+
+	lastActivity = P4PerlSys::Now();
+	return 1;
+    }
+
+    for( int i = 0; i < b->Count() && !ui->StopReason(); i++ )
+    {
+	double	start = P4PerlSys::Now();
+	RunCmd( cmd, ui, b->Argc( i ), b->Argv( i ) );
+	b->SetSeconds( i, P4PerlSys::Now() - start );
+    }
+    return 1;
+}
+
+//
+// Make sure we have at least 'wanted' extra connections, for batches or
+// bulk saves. Any that have dropped are replaced. Returns the number
+// available, up to 'wanted', or 0 (having reported the error) if none
+// could be made, in which case the work is done on our own connection
+// instead.
+//
+int
+PerlClientApi::ConnectBatchClients( int wanted )
+{
+    if( !batchClients )
+    {
+	batchClients = new ClientApi *[ wanted ];
+	batchClientMax = wanted;
+	batchClientCount = 0;
+    }
+    else if( batchClientMax < wanted )
+    {
+	ClientApi **c = new ClientApi *[ wanted ];
+	for( int i = 0; i < batchClientCount; i++ )
+	    c[ i ] = batchClients[ i ];
+	delete [] batchClients;
+	batchClients = c;
+	batchClientMax = wanted;
+    }
+
+    int	i;
+    for( i = 0; i < batchClientCount; )
+    {
+	if( !batchClients[ i ]->Dropped() )
+	{
+	    i++;
+	    continue;
+	}
+
+	Error	e;
+	batchClients[ i ]->Final( &e );
+	delete batchClients[ i ];
+	batchClients[ i ] = batchClients[ --batchClientCount ];
+    }
+
+    while( batchClientCount < wanted )
+    {
+	ClientApi	*c = new ClientApi;
+	Error		e;
+
+	ApplySettings( c );
+	InitConnection( c, &e );
+	if( e.Test() )
+	{
+	    delete c;
+	    if( !batchClientCount )
+		ui->HandleError( &e );
+	    break;
+	}
+	batchClients[ batchClientCount++ ] = c;
+    }
+
+    return batchClientCount < wanted ? batchClientCount : wanted;
+}
+
+void
+PerlClientApi::DisconnectBatchClients()
+{
+    for( int i = 0; i < batchClientCount; i++ )
+    {
+	Error	e;
+	batchClients[ i ]->Final( &e );
+	delete batchClients[ i ];
+    }
+    batchClientCount = 0;
+}
+
+//
+// Ticket caching. Once we've logged in, the ticket is kept for the rest
+// of the process (and its children), and optionally in a file that only
+// we can read, and used by every connection to the same server as the
+// same user instead of logging in again.
+//
+void
+PerlClientApi::SetTicketCache( int enable, const char *file )
+{
+    ticketCache = enable;
+    ticketFile.Clear();
+    if( file )
+	ticketFile.Set( file );
+}
+
+const char *
+PerlClientApi::TicketFile()
+{
+    return ticketFile.Length() ? ticketFile.Text() : 0;
+}
+
+SV *
+PerlClientApi::Login()
+{
+    ui->Reset( compatFlags & CPT_MERGED );
+    ui->SetCommand( "login" );
+
+    if( !UseCachedTicket() )
+	LoginNow( ui );
+
+    return newRV( (SV*) GetOutput() );
+}
+
+//
+// Use a ticket from the cache in place of the password, keeping the 
+// password to log in with if the ticket stops working.
+//
+int
+PerlClientApi::UseCachedTicket()
+{
+    StrBuf	ticket;
+    P4Lock	l( apiLock );
+
+    if( !P4TicketCache::Find( client->GetPort(), client->GetUser(), 
+			      TicketFile(), ticket ) )
+	return 0;
+
+    if( ticket == client->GetPassword() )
+	return 1;
+
+    if( P4PERL_DEBUG_FLOW )
+	printf( "[P4::Login]: Using cached ticket for %s@%s\n", 
+		client->GetUser().Text(), client->GetPort().Text() );
+
+    SavePassword();
+    client->SetPassword( ticket.Text() );
+    return 1;
+}
+
+//
+// Before the password is first replaced by a ticket, keep it (even if
+// there wasn't one) for logging in again. From then on, the ClientApi's
+// password is a ticket, and must never be sent to 'login' as a password.
+// Called with apiLock held.
+//
+void
+PerlClientApi::SavePassword()
+{
+    if( passwordSaved )
+	return;
+
+    loginPassword.Set( client->GetPassword() );
+    passwordSaved = 1;
+}
+
+int
+PerlClientApi::HasLoginPassword()
+{
+    P4Lock	l( apiLock );
+    return passwordSaved ? loginPassword.Length() 
+			 : client->GetPassword().Length();
+}
+
+//
+// Run 'login -p' to get a ticket without writing it to the user's 
+// tickets file, and cache it. Output other than the ticket goes to u.
+//
+int
+PerlClientApi::LoginNow( ClientUser *u )
+{
+    char	*args[] = { (char *) "-p" };
+
+    CheckFork();
+
+    P4Lock	l( apiLock );
+
+    SavePassword();
+
+    P4LoginUser	lu( u, loginPassword );
+
+#if P4API_VERSION >= 513026
+    client->SetProg( prog.Text() );
+#endif
+    client->SetArgv( 1, args );
+    client->Run( "login", &lu );
+    lastActivity = P4PerlSys::Now();
+
+    if( lu.Failed() || !lu.Ticket().Length() )
+	return 0;
+
+    P4TicketCache::Store( client->GetPort(), client->GetUser(), 
+			  TicketFile(), lu.Ticket() );
+    client->SetPassword( lu.Ticket().Text() );
+    return 1;
+}
+
+//
+// Automatic splitting of commands that go over maxresults or maxscanrows.
+// 0 turns it off; otherwise the pieces are run on our own connection, or
+// in parallel if there's more than one connection.
+//
+void
+PerlClientApi::SetAutoSplit( int connections )
+{
+    splitConnections = connections > 0 ? connections : 0;
+}
+
+//
+// Run a command that the server refused as too big again, in pieces
+// small enough to fit. The output of the failed attempt is thrown away.
+//
+void
+PerlClientApi::RunSplit( const char *cmd, int argc, char * const *argv )
+{
+    if( !P4Splitter::IsSplittable( cmd ) )
+	return;
+
+    P4Splitter	s( cmd, argc, argv );
+    if( !s.CanSplit() )
+	return;
+
+    if( P4PERL_DEBUG_CMDS )
+	printf( "[P4::Run]: \"%s\" is over the server's limits. Splitting\n",
+		cmd );
+
+    ui->Reset( compatFlags & CPT_MERGED, 1 );
+    if( aggregate ) aggregate->Reset();
+
+    int	n = splitConnections > 1 ? ConnectBatchClients( splitConnections ) : 0;
+    if( n )
+    {
+	s.Run( batchClients, n, ui, prog.Text(), maxResults, maxScanRows,
+	       ui );
+    }
+    else
+    {
+	CheckFork();
+	P4Lock	l( apiLock );
+	s.Run( &client, 1, ui, prog.Text(), maxResults, maxScanRows, ui );
+	lastActivity = P4PerlSys::Now();
+    }
+
+    splitCount = s.Splits();
+
+    if( P4PERL_DEBUG_CMDS )
+	printf( "[P4::Run]: Split %d times, running %d commands\n", 
+		s.Splits(), s.Commands() );
+}
+
+//
+// A command that ran out of time or budget, or was cancelled, keeps the
+// output it had by then, plus a message saying why it stopped. The API
+// stops a command by dropping the connection, so we make a new one.
+// Returns 1 if the command was stopped.
+//
+int
+PerlClientApi::Stopped( const char *cmd )
+{
+    if( ui->StopReason() == PerlClientUser::STOP_NONE )
+	return 0;
+
+    if( P4PERL_DEBUG_FLOW )
+	printf( "[P4::Run]: \"%s\" stopped (%s)\n", cmd, ui->StopName() );
+
+    ui->ReportStop();
+    if( initCount && IsDropped() )
+	Reconnect();
+    return 1;
+}
+
+//
+// Timing for each batch of the last command, or an empty array if it
+// wasn't split up.
+//
+AV *
+PerlClientApi::GetBatchTimes()
+{
+    AV *	av = newAV();
+
+    for( int i = 0; lastBatch && i < lastBatch->Count(); i++ )
+    {
+	HV *	hv = newHV();
+
+	hv_store( hv, "files", 5, newSViv( lastBatch->Files( i ) ), 0 );
+	hv_store( hv, "bytes", 5, newSViv( lastBatch->Bytes( i ) ), 0 );
+	hv_store( hv, "seconds", 7, newSVnv( lastBatch->Seconds( i ) ), 0 );
+	hv_store( hv, "connection", 10, 
+		  newSViv( lastBatch->Connection( i ) ), 0 );
+	av_push( av, newRV_noinc( (SV *) hv ) );
+    }
+    return av;
+}
+
+//
+// Start iterating over the output of a changes, jobs, filelog or fstat
+// command a page at a time. The pages are fetched on a connection of
+// the iterator's own, always tagged, so that it can work out where each
+// page ends and the next should start.
+//
+P4Iterator *
+PerlClientApi::Iterate( const char *cmd, int argc, char * const *argv )
+{
+    if( !P4Iterator::Supported( cmd ) )
+    {
+	warn( "Can't iterate over \"%s\": only changes, jobs, filelog and "
+	      "fstat are supported", cmd );
+	return 0;
+    }
+
+    ui->Reset( compatFlags & CPT_MERGED );
+
+    ClientApi	*c = ConnectTagged();
+    if( !c )
+	return 0;
+
+    P4Iterator	*it = new P4Iterator( c, cmd, argc, argv, prog.Text() );
+    if( it->Problem() )
+    {
+	warn( "%s", it->Problem() );
+	delete it;
+	return 0;
+    }
+    return it;
+}
+
+//
+// Returns a reference to an array of the records in the iterator's next
+// page, or undef when there are no more. Any errors from fetching the
+// page are in Errors() as usual.
+//
+SV *
+PerlClientApi::NextPage( P4Iterator *it )
+{
+    ui->Reset( compatFlags & CPT_MERGED );
+
+    BufferedClientUser	*page = it->NextPage( ui );
+
+    if( !page )
+    {
+	ui->ReportStop();
+	return &PL_sv_undef;
+    }
+
+    if( P4PERL_DEBUG_CMDS )
+	printf( "[P4::Iterator]: Page %d, next page size %d\n", 
+		it->Pages(), it->PageSize() );
+
+    ui->SetCommand( it->Command() );
+    page->Replay( ui );
+    ui->ReportStop();
+
+    return newRV( (SV*) GetOutput() );
+}
+
+//
+// Build a local index of the head revisions of the files in 'path' from
+// a full fstat, and write it to 'file'. Returns the number of files in
+// the index, or undef on failure.
+//
+SV *
+PerlClientApi::BuildIndex( const char *file, const char *path )
+{
+    ui->Reset( compatFlags & CPT_MERGED );
+
+    if( !index )
+	index = new P4Index;
+
+    index->Close();
+    index->DiscardUpdates();
+    index->SetRoot( path );
+
+    ClientApi	*c = ConnectTagged();
+    if( !c )
+	return &PL_sv_undef;
+
+    //
+    // Find the high-water mark before the fstat, so that anything 
+    // submitted while the fstat runs is replayed by the next update
+    // rather than missed.
+    //
+    P4IndexUser	changes( index, P4IndexUser::IU_CHANGES );
+    P4IndexUser	fstat( index, P4IndexUser::IU_FSTAT );
+    char *	cargs[] = { (char *) "-m1", (char *) "-s", 
+			    (char *) "submitted", (char *) path };
+    char *	fargs[] = { (char *) "-Ol", (char *) "-T", 
+			    (char *) "depotFile,headRev,headChange,headType,"
+				     "headAction,headTime,fileSize",
+			    (char *) path };
+
+    int ok = IndexRun( c, changes, "changes", 4, cargs ) &&
+	     IndexRun( c, fstat, "fstat", 4, fargs );
+
+    Error	e;
+    c->Final( &e );
+    delete c;
+
+    if( !ok )
+    {
+	index->DiscardUpdates();
+	return &PL_sv_undef;
+    }
+
+    int hw = changes.ChangeCount() ? changes.GetChange( 0 ) : 0;
+    if( !index->Write( file, hw ) )
+    {
+	warn( "%s", index->GetError() );
+	return &PL_sv_undef;
+    }
+
+    if( P4PERL_DEBUG_CMDS )
+	printf( "[P4::BuildIndex]: %d files at change %d\n", 
+		index->Count(), hw );
+
+    return newSViv( index->Count() );
+}
+
+SV *
+PerlClientApi::OpenIndex( const char *file )
+{
+    if( !index )
+	index = new P4Index;
+
+    index->DiscardUpdates();
+    if( !index->Open( file ) )
+    {
+	warn( "%s", index->GetError() );
+	return &PL_sv_undef;
+    }
+    return newSViv( index->Count() );
+}
+
+//
+// Bring the index up to date by replaying "describe -s" for each change
+// submitted since the last one it has seen. describe doesn't give us
+// file sizes, so the files it mentions are fstat'ed afterwards. Returns
+// the number of changes applied.
+//
+SV *
+PerlClientApi::UpdateIndex()
+{
+    if( !index || !index->IsOpen() )
+    {
+	warn( "No index open. Use BuildIndex() or OpenIndex() first" );
+	return &PL_sv_undef;
+    }
+
+    ui->Reset( compatFlags & CPT_MERGED );
+
+    ClientApi	*c = ConnectTagged();
+    if( !c )
+	return &PL_sv_undef;
+
+    int		hw = index->HighWater();
+    StrBuf	range;
+    range << index->Root() << "@" << hw + 1 << ",#head";
+
+    P4IndexUser	changes( index, P4IndexUser::IU_CHANGES );
+    char *	cargs[] = { (char *) "-s", (char *) "submitted", range.Text() };
+    int		ok = IndexRun( c, changes, "changes", 3, cargs );
+    int		i;
+
+    // Oldest first, so later changes win
+    for( i = changes.ChangeCount() - 1; ok && i >= 0; i-- )
+    {
+	P4IndexUser	describe( index, P4IndexUser::IU_DESCRIBE );
+	StrBuf		change;
+	change << changes.GetChange( i );
+
+	char *	dargs[] = { (char *) "-s", change.Text() };
+	ok = IndexRun( c, describe, "describe", 2, dargs );
+	if( ok && changes.GetChange( i ) > hw )
+	    hw = changes.GetChange( i );
+    }
+
+    //
+    // Fill in the sizes, a few hundred files at a time.
+    //
+    const int	chunk = 500;
+    int		n = index->UpdateCount();
+    char **	fargs = new char *[ chunk + 3 ];
+
+    fargs[ 0 ] = (char *) "-Ol";
+    fargs[ 1 ] = (char *) "-T";
+    fargs[ 2 ] = (char *) "depotFile,headRev,headChange,headType,"
+			  "headAction,headTime,fileSize";
+
+    for( i = 0; ok && i < n; )
+    {
+	int	argc = 3;
+	for( ; i < n && argc < chunk + 3; i++ )
+	    if( !index->IsSized( i ) )
+		fargs[ argc++ ] = index->UpdatePath( i );
+
+	if( argc == 3 )
+	    break;
+
+	P4IndexUser	fstat( index, P4IndexUser::IU_FSTAT );
+	ok = IndexRun( c, fstat, "fstat", argc, fargs );
+    }
+    delete [] fargs;
+
+    Error	e;
+    c->Final( &e );
+    delete c;
+
+    if( !ok )
+    {
+	index->DiscardUpdates();
+	return &PL_sv_undef;
+    }
+
+    if( P4PERL_DEBUG_CMDS )
+	printf( "[P4::UpdateIndex]: %d changes, %d updates\n", 
+		changes.ChangeCount(), index->UpdateCount() );
+
+    if( changes.ChangeCount() )
+    {
+	StrBuf	file;
+	file.Set( index->File() );
+
+	if( !index->Write( file.Text(), hw ) )
+	{
+	    warn( "%s", index->GetError() );
+	    return &PL_sv_undef;
+	}
+    }
+
+    return newSViv( changes.ChangeCount() );
+}
+
+SV *
+PerlClientApi::IndexLookup( const char *path )
+{
+    if( !index || !index->IsOpen() )
+    {
+	warn( "No index open. Use BuildIndex() or OpenIndex() first" );
+	return &PL_sv_undef;
+    }
+
+    int	i = index->Find( path, strlen( path ) );
+    if( i < 0 )
+	return &PL_sv_undef;
+
+    return newRV_noinc( (SV *) IndexRecord( i ) );
+}
+
+AV *
+PerlClientApi::IndexPrefix( const char *prefix )
+{
+    AV *	av = newAV();
+    int		len = strlen( prefix );
+
+    if( !index || !index->IsOpen() )
+    {
+	warn( "No index open. Use BuildIndex() or OpenIndex() first" );
+	return av;
+    }
+
+    int	i = index->Lower( prefix, len );
+    for( ; index->HasPrefix( i, prefix, len ); i++ )
+	av_push( av, newRV_noinc( (SV *) IndexRecord( i ) ) );
+
+    return av;
+}
+
+HV *
+PerlClientApi::IndexRecord( int i )
+{
+    HV *	hv = newHV();
+
+    hv_store( hv, "depotFile", 9, 
+	      newSVpvn( index->Path( i ), index->PathLength( i ) ), 0 );
+    hv_store( hv, "headRev", 7, newSViv( index->HeadRev( i ) ), 0 );
+    hv_store( hv, "headChange", 10, newSViv( index->HeadChange( i ) ), 0 );
+    hv_store( hv, "headType", 8, newSVpv( index->HeadType( i ), 0 ), 0 );
+    hv_store( hv, "headAction", 10, newSVpv( index->HeadAction( i ), 0 ), 0 );
+    hv_store( hv, "headTime", 8, newSViv( index->HeadTime( i ) ), 0 );
+
+    // Deleted files have no size
+    if( index->FileSize( i ) >= 0 )
+	hv_store( hv, "fileSize", 8, newSViv( index->FileSize( i ) ), 0 );
+
+    return hv;
+}
+
+int
+PerlClientApi::IndexRun( ClientApi *c, P4IndexUser &u, const char *cmd,
+			 int argc, char * const *argv )
+{
+#if P4API_VERSION >= 513026
+    c->SetProg( prog.Text() );
+#endif
+    c->SetArgv( argc, argv );
+    c->Run( cmd, &u );
+
+    if( u.Failed() )
+    {
+	ui->HandleError( u.GetError() );
+	return 0;
+    }
+    return 1;
+}
+
+//
+// Compare the files under root (the client root by default) with the
+// have list, walking the tree and hashing files on a pool of threads.
+// Returns a hash of the modified, missing, extra and unchecked files,
+// or undef if the have list couldn't be fetched.
+//
+SV *
+PerlClientApi::ScanWorkspace( const char *root, int threads, double since )
+{
+    ui->Reset( compatFlags & CPT_MERGED );
+
+    ClientApi	*c = ConnectTagged();
+    if( !c )
+	return &PL_sv_undef;
+
+    P4Scanner	scanner;
+    P4ScanUser	info( &scanner, 0 );
+    P4ScanUser	have( &scanner, 0 );
+    P4ScanUser	opened( &scanner, 1 );
+    StrBuf	r;
+    int		ok = 1;
+
+    if( root )
+	r = root;
+
+    if( !r.Length() && ( ok = ScanRun( c, info, "info", 0, 0 ) ) )
+	r = info.ClientRoot();
+
+    if( ok && ( !r.Length() || r == "null" ) )
+    {
+	warn( "P4::ScanWorkspace(): No client root to scan" );
+	ok = 0;
+    }
+
+    //
+    // Unicode files can only be compared if they're stored as UTF-8,
+    // and text files have CRs in them on Windows.
+    //
+    {
+	P4Lock	l( apiLock );
+	const StrPtr &cs = client->GetCharset();
+	scanner.SetTranslated( cs.Length() && cs != "none" && 
+			       strncmp( cs.Text(), "utf8", 4 ) );
+    }
+#ifdef OS_NT
+    scanner.SetCrLf( 1 );
+#endif
+    scanner.SetSince( (long long) since );
+    scanner.SetRoot( r.Text() );
+
+    StrBuf	havePath, openPath;
+    havePath << scanner.Root() << "/...#have";
+    openPath << scanner.Root() << "/...";
+
+    char *	hargs[] = { (char *) "-Ol", (char *) "-T", 
+			    (char *) "clientFile,headType,fileSize,digest,"
+				     "action",
+			    havePath.Text() };
+    char *	oargs[] = { (char *) "-Ro", (char *) "-T", 
+			    (char *) "clientFile,action", openPath.Text() };
+
+    ok = ok && ScanRun( c, have, "fstat", 4, hargs ) &&
+	 ScanRun( c, opened, "fstat", 4, oargs );
+
+    Error	e;
+    c->Final( &e );
+    delete c;
+
+    if( !ok )
+	return &PL_sv_undef;
+
+    double	start = P4PerlSys::Now();
+    scanner.Run( threads );
+
+    if( P4PERL_DEBUG_CMDS )
+	printf( "[P4::ScanWorkspace]: %d files, %d hashed in %.2fs\n",
+		scanner.Files(), scanner.Hashed(), P4PerlSys::Now() - start );
+
+    static const char *names[] = { 0, "modified", "missing", "extra", 
+				   "unchecked" };
+    HV	*hv = newHV();
+
+    for( int s = P4Scanner::S_MODIFIED; s < P4Scanner::S_COUNT; s++ )
+    {
+	AV	*av = newAV();
+	for( int i = 0; i < scanner.Count( s ); i++ )
+	    av_push( av, newSVpv( scanner.Path( s, i ), 0 ) );
+	hv_store( hv, names[ s ], strlen( names[ s ] ), 
+		  newRV_noinc( (SV *) av ), 0 );
+    }
+    hv_store( hv, "files", 5, newSViv( scanner.Files() ), 0 );
+    hv_store( hv, "hashed", 6, newSViv( scanner.Hashed() ), 0 );
+
+    return newRV_noinc( (SV *) hv );
+}
+
+int
+PerlClientApi::ScanRun( ClientApi *c, P4ScanUser &u, const char *cmd,
+			int argc, char * const *argv )
+{
+#if P4API_VERSION >= 513026
+    c->SetProg( prog.Text() );
+#endif
+    c->SetArgv( argc, argv );
+    c->Run( cmd, &u );
+
+    if( u.Failed() )
+    {
+	ui->HandleError( u.GetError() );
+	return 0;
+    }
+    return 1;
+}
+
+//
+// Run the same command on several servers at once, each on a connection
+// and thread of its own, so it takes as long as the slowest of them. The
+// servers are hashes of port, user, password, client and charset, with
+// anything not given taken from our own settings. Output is always
+// tagged, and each record gets a "server" field saying where it came
+// from. If sortField is set, the records are merged into order by it.
+//
+SV *
+PerlClientApi::FanOut( AV *servers, const char *sortField, const char *cmd,
+		       int argc, char * const *argv )
+{
+    static const char *keys[] = { "port", "user", "password", "client",
+				  "charset" };
+
+    ui->Reset( compatFlags & CPT_MERGED );
+    ui->SetCommand( cmd );
+
+    P4FanOut	fanOut;
+    StrBuf	ourPort, ourUser;
+
+    {
+	P4Lock	l( apiLock );
+	ourPort = client->GetPort();
+	ourUser = client->GetUser();
+    }
+
+    for( int i = 0; i <= av_len( servers ); i++ )
+    {
+	SV	**s = av_fetch( servers, i, 0 );
+	HV	*hv;
+	SV	**v;
+	char	*vals[ 5 ];
+
+	if( !s || !SvROK( *s ) || SvTYPE( SvRV( *s ) ) != SVt_PVHV )
+	{
+	    warn( "P4::FanOut(): Servers must be hash references" );
+	    return &PL_sv_undef;
+	}
+	hv = (HV *) SvRV( *s );
+
+	for( int k = 0; k < 5; k++ )
+	{
+	    v = hv_fetch( hv, keys[ k ], strlen( keys[ k ] ), 0 );
+	    vals[ k ] = v && SvOK( *v ) ? SvPV_nolen( *v ) : 0;
+	}
+
+	if( !vals[ 0 ] )
+	{
+	    warn( "P4::FanOut(): No port given for a server" );
+	    return &PL_sv_undef;
+	}
+
+	ClientApi	*c = new ClientApi;
+
+	ApplySettings( c );
+	c->SetPort( vals[ 0 ] );
+	if( vals[ 1 ] ) c->SetUser( vals[ 1 ] );
+
+	//
+	// Our password may be a ticket, which is only any good to (and only
+	// ours to give to) our own server. Other servers get the one they
+	// were given, or find their own in P4TICKETS or P4PASSWD.
+	//
+	if( vals[ 2 ] )
+	    c->SetPassword( vals[ 2 ] );
+	else if( ourPort != vals[ 0 ] || ( vals[ 1 ] && ourUser != vals[ 1 ] ) )
+	    c->SetPassword( "" );
+	if( vals[ 3 ] ) c->SetClient( vals[ 3 ] );
+	if( vals[ 4 ] )
+	{
+	    CharSetApi::CharSet	id = CharSetApi::Lookup( vals[ 4 ] );
+	    if( id != (CharSetApi::CharSet) -1 )
+	    {
+		c->SetTrans( id, id, id, id );
+		c->SetCharset( vals[ 4 ] );
+	    }
+	}
+	c->SetProtocol( "tag", "" );
+
+	fanOut.AddServer( c, vals[ 0 ] );
+    }
+
+    if( P4PERL_DEBUG_CMDS )
+	printf( "[P4::FanOut]: Running \"%s\" on %d servers\n", cmd,
+		fanOut.Count() );
+
+    fanOut.Run( cmd, argc, argv, prog.Text(), maxResults, maxScanRows,
+		ui );
+
+    if( P4PERL_DEBUG_CMDS )
+	for( int i = 0; i < fanOut.Count(); i++ )
+	    printf( "[P4::FanOut]: %s took %.3fs\n", fanOut.Name( i ).Text(),
+		    fanOut.Seconds( i ) );
+
+    fanOut.Replay( ui, sortField );
+    ui->ReportStop();
+
+    return newRV( (SV*) GetOutput() );
+}
+
+//
+// Replica routing. Read-only commands are sent to whichever of the
+// replicas has been answering quickest, and everything else to the 
+// primary. After a write, a replica is only used again once 'pull -lj'
+// shows it's caught up, or if it can't say, once lagWindow seconds have
+// passed. An empty list turns routing off.
+//
+void
+PerlClientApi::SetReplicas( AV *ports, double lagWindow )
+{
+    delete router;
+    router = 0;
+
+    if( av_len( ports ) < 0 )
+	return;
+
+    router = new P4Router;
+    if( lagWindow >= 0 )
+	router->SetLagWindow( lagWindow );
+
+    for( int i = 0; i <= av_len( ports ); i++ )
+    {
+	SV **s = av_fetch( ports, i, 0 );
+	if( s && SvOK( *s ) )
+	    router->AddReplica( SvPV_nolen( *s ) );
+    }
+}
+
+AV *
+PerlClientApi::ReplicaStats()
+{
+    AV *	av = newAV();
+    double	now = P4PerlSys::Now();
+
+    if( !router )
+	return av;
+
+    for( int i = 0; i < router->Count(); i++ )
+    {
+	HV	*hv = newHV();
+
+	hv_store( hv, "port", 4, newSVpv( router->Port( i ).Text(), 0 ), 0 );
+	hv_store( hv, "latency", 7, newSVnv( router->Latency( i ) ), 0 );
+	hv_store( hv, "commands", 8, newSViv( router->Commands( i ) ), 0 );
+	hv_store( hv, "failures", 8, newSViv( router->Failures( i ) ), 0 );
+	hv_store( hv, "healthy", 7, newSViv( router->IsHealthy( i, now ) ), 0 );
+	hv_store( hv, "synced", 6, newSViv( router->IsSynced( i, now ) ), 0 );
+	av_push( av, newRV_noinc( (SV *) hv ) );
+    }
+    return av;
+}
+
+//
+// Returns 0 if the command should run on the primary. A replica that
+// can't be reached, or drops the connection, is left alone for a while
+// and the command tried elsewhere.
+//
+int
+PerlClientApi::RunRouted( const char *cmd, int argc, char * const *argv )
+{
+    if( !router || !IsReadOnlyCommand( cmd, argc, argv ) )
+	return 0;
+
+    CheckFork();
+
+    for( int tries = 0; tries < router->Count() * 2; tries++ )
+    {
+	double	now = P4PerlSys::Now();
+	int	r = router->Pick( now );
+
+	if( r < 0 )
+	    return 0;
+
+	if( router->NeedsSyncCheck( r ) )
+	{
+	    ClientApi		*p = ReplicaConnection( r, 1 );
+	    P4RouterUser	u;
+
+	    if( !p )
+	    {
+		router->Failure( r, now );
+		continue;
+	    }
+
+	    char *	args[] = { (char *) "-lj" };
+#if P4API_VERSION >= 513026
+	    p->SetProg( prog.Text() );
+#endif
+	    p->SetArgv( 1, args );
+	    p->Run( "pull", &u );
+	    router->SyncResult( r, u.Synced(), now );
+
+	    if( P4PERL_DEBUG_FLOW )
+		printf( "[P4::Run]: Replica %s sync check: %d\n", 
+			router->Port( r ).Text(), u.Synced() );
+
+	    if( !router->IsSynced( r, now ) )
+		continue;
+	}
+
+	ClientApi	*c = ReplicaConnection( r, 0 );
+	if( !c )
+	{
+	    router->Failure( r, now );
+	    continue;
+	}
+
+	if( P4PERL_DEBUG_CMDS )
+	    printf( "[P4::Run]: Routing \"%s\" to %s\n", cmd, 
+		    router->Port( r ).Text() );
+
+	if( maxResults  )	c->SetVar( "maxResults",  maxResults  );
+	if( maxScanRows )	c->SetVar( "maxScanRows", maxScanRows );
+#if P4API_VERSION >= 513026
+	c->SetProg( prog.Text() );
+#endif
+	c->SetArgv( argc, argv );
+	c->SetBreak( ui );
+	c->Run( cmd, ui );
+	c->SetBreak( 0 );
+
+	// Not the replica's fault, and not to be tried elsewhere. Its
+	// connection will be remade the next time it's needed.
+	if( ui->StopReason() )
+	    return 1;
+
+	if( c->Dropped() )
+	{
+	    router->Failure( r, now );
+	    ui->Reset( compatFlags & CPT_MERGED, 1 );
+	    if( aggregate ) aggregate->Reset();
+	    continue;
+	}
+
+	router->Success( r, P4PerlSys::Now() - now );
+	return 1;
+    }
+    return 0;
+}
+
+//
+// The connection to replica r, or its tagged probe connection, made
+// when first needed. Returns 0 if it couldn't be made.
+//
+ClientApi *
+PerlClientApi::ReplicaConnection( int r, int probe )
+{
+    ClientApi	*c = probe ? router->Probe( r ) : router->Client( r );
+    Error	e;
+
+    if( c && !c->Dropped() )
+	return c;
+
+    if( c )
+    {
+	c->Final( &e );
+	delete c;
+	e.Clear();
+    }
+
+    c = new ClientApi;
+    ApplySettings( c );
+    c->SetPort( router->Port( r ).Text() );
+    if( probe )
+	c->SetProtocol( "tag", "" );
+
+    InitConnection( c, &e );
+    if( e.Test() )
+    {
+	if( P4PERL_DEBUG_FLOW )
+	    printf( "[P4::Run]: Can't connect to replica %s\n", 
+		    router->Port( r ).Text() );
+	delete c;
+	c = 0;
+    }
+
+    if( probe )
+	router->SetProbe( r, c );
+    else
+	router->SetClient( r, c );
+    return c;
+}
+
+//
+// Managed connection support. When enabled, dropped connections are
+// replaced with a new one, retrying up to 'attempts' times with an
+// exponentially increasing pause capped at maxWait milliseconds.
+//
+void
+PerlClientApi::SetAutoReconnect( int attempts, int maxWait )
+{
+    reconnectAttempts = attempts > 0 ? attempts : 0;
+    reconnectMaxWait = maxWait > 0 ? maxWait : 5000;
+}
+
+//
+// Copy our connection settings onto another ClientApi object so that it
+// can be used in place of (or alongside) our own.
+//
+void
+PerlClientApi::ApplySettings( ClientApi *c )
+{
+    P4Lock	l( apiLock );
+
+    c->SetPort( client->GetPort().Text() );
+    c->SetUser( client->GetUser().Text() );
+    c->SetClient( client->GetClient().Text() );
+    c->SetHost( client->GetHost().Text() );
+    c->SetCwd( client->GetCwd().Text() );
+    c->SetPassword( client->GetPassword().Text() );
+
+    if( client->GetLanguage().Length() )
+	c->SetLanguage( client->GetLanguage().Text() );
+
+    const StrPtr &cs = client->GetCharset();
+    if( cs.Length() )
+    {
+	CharSetApi::CharSet	id = CharSetApi::Lookup( cs.Text() );
+	if( id != (CharSetApi::CharSet) -1 )
+	{
+	    c->SetTrans( id, id, id, id );
+	    c->SetCharset( cs.Text() );
+	}
+    }
+
+    // Tagged, specstring, api level and anything else we've been given
+    StrRef	var, val;
+    for( int i = 0; protocols.GetVar( i, var, val ); i++ )
+	c->SetProtocol( var.Text(), val.Text() );
+}
+
+//
+// A separate, tagged connection with our settings, for work that needs to
+// see tagged output whatever mode we're in. Returns 0 (having reported
+// the error) if it couldn't be made.
+//
+ClientApi *
+PerlClientApi::ConnectTagged()
+{
+    ClientApi	*c = new ClientApi;
+    Error	e;
+
+    ApplySettings( c );
+    c->SetProtocol( "tag", "" );
+    InitConnection( c, &e );
+    if( e.Test() )
+    {
+	ui->HandleError( &e );
+	delete c;
+	return 0;
+    }
+    return c;
+}
+
+//
+// Replace our (dropped) connection with a brand new one. Returns 0 if
+// the server could not be reached within the allowed number of attempts.
+//
+int
+PerlClientApi::Reconnect()
+{
+    ClientApi *	fresh = 0;
+    Error	e;
+    int		wait = 100;
+
+    for( int attempt = 1; ; attempt++ )
+    {
+	if( P4PERL_DEBUG_FLOW )
+	    printf( "[PerlClientApi::Reconnect]: Attempt %d\n", attempt );
+
+	fresh = new ClientApi;
+	ApplySettings( fresh );
+
+	e.Clear();
+	InitConnection( fresh, &e );
+	if( !e.Test() )
+	    break;
+
+	delete fresh;
+	fresh = 0;
+
+	if( attempt >= reconnectAttempts )
+	    break;
+
+	P4PerlSys::Sleep( wait );
+	wait = wait * 2 > reconnectMaxWait ? reconnectMaxWait : wait * 2;
+    }
+
+    if( !fresh )
+    {
+	ui->HandleError( &e );
+	return 0;
+    }
+
+    // The old connection is already dead, so Final() just tidies up.
+    P4Lock	l( apiLock );
+    Error	fe;
+    client->Final( &fe );
+    delete client;
+    client = fresh;
+    lastActivity = P4PerlSys::Now();
+    return 1;
+}
+
+//
+// Fork support. If we've been inherited by a child process, the ClientApi's
+// socket is shared with our parent and anything we send on it would corrupt
+// the parent's session. So the child first swaps all of the sockets it
+// inherited for /dev/null, and can then close and delete its copies of
+// the connections as usual without the parent noticing. If we were 
+// connected, it then makes a connection of its own with the same 
+// settings. The specdef cache and the password (or ticket) come along
+// for free.
+//
+void
+PerlClientApi::CheckFork( int reconnect )
+{
+    int	pid = P4PerlSys::GetPid();
+    if( pid == ownerPid )
+	return;
+
+    if( P4PERL_DEBUG_FLOW )
+	printf( "[PerlClientApi::CheckFork]: Inherited by process %d\n", pid );
+
+    ownerPid = pid;
+
+    // Threads don't survive a fork, and may have died holding the lock
+    apiLock.AfterFork();
+    P4TicketCache::AfterFork();
+    keepAliveThread.Forget();
+
+    P4Sockets::Detach();
+
+    ClientApi *fresh = new ClientApi;
+    ApplySettings( fresh );
+
+    if( initCount )
+    {
+	Error	e;
+	client->Final( &e );
+    }
+    delete client;
+    client = fresh;
+
+    // The batch and replica connections were our parent's too. New ones
+    // will be made if they're needed.
+    DisconnectBatchClients();
+    if( router )
+	router->Disconnect();
+
+    int	wasConnected = initCount;
+    initCount = 0;
+
+    if( !reconnect )
+	return;
+
+    if( wasConnected )
+	Connect();
+
+    if( keepAliveInterval )
+    {
+	keepAliveStop = 0;
+	keepAliveThread.Start( KeepAliveThread, this );
+    }
+}
+
+//
+// Keepalive support. A background thread runs a cheap command whenever
+// the connection has been idle for the given number of seconds so that
+// server and firewall idle timeouts never fire. Zero stops the thread.
+//
+void
+PerlClientApi::SetKeepAlive( int seconds )
+{
+    keepAliveInterval = seconds > 0 ? seconds : 0;
+    keepAlivePending = 0;
+
+    if( keepAliveInterval && !keepAliveThread.IsRunning() )
+    {
+	keepAliveStop = 0;
+	if( !keepAliveThread.Start( KeepAliveThread, this ) )
+	    warn( "P4::SetKeepAlive() - Unable to start keepalive thread" );
+    }
+    else if( !keepAliveInterval && keepAliveThread.IsRunning() )
+    {
+	keepAliveStop = 1;
+	keepAliveThread.Join();
+    }
+}
+
+void
+PerlClientApi::KeepAliveThread( void *api )
+{
+    ( (PerlClientApi *) api )->KeepAlive();
+}
+
+void
+PerlClientApi::KeepAlive()
+{
+    NullClientUser	nul;
+
+    while( !keepAliveStop )
+    {
+	P4PerlSys::Sleep( 250 );
+
+	P4Lock	l( apiLock );
+	if( keepAliveStop || !initCount || client->Dropped() )
+	    continue;
+
+	if( P4PerlSys::Now() - lastActivity < keepAliveInterval )
+	    continue;
+
+	client->SetArgv( 0, 0 );
+	client->Run( "info", &nul );
+	lastActivity = P4PerlSys::Now();
+    }
+}
+
+//
+// Convert a spec in string form into a hash and return a reference to that
+// hash.
+//
+SV *
+PerlClientApi::ParseSpec( const char *type, const char *form )
+{
+    if( P4PERL_DEBUG_FORMS )
+	printf( "[ParseSpec]: Parsing a %s spec. Form is:\n%s\n", 
+		type, form );
+
+    if( !IsParseForms() )
+    {
+	warn( "P4::ParseSpec() requires ParseForms mode" );
+	return &PL_sv_undef;
+    }
+
+    StrPtr	*specDef = FetchSpecDef( type );
+
+    if ( !specDef )
+    {
+	StrBuf m;
+	m = "P4::ParseSpec(): No spec definition for ";
+	m.Append( type );
+	m.Append( " objects." );
+	warn( m.Text() );
+	return &PL_sv_undef;
+    }
+
+    // Got a specdef so now we can attempt to parse it.
+    
+    SpecDataTable	specData;
+    Spec		s( specDef->Text(), "" );
+    Error		e;
+
+    s.ParseNoValid( form, &specData, &e );
+    if ( e.Test() )
+    {
+	//
+	// Report the error through the UI interface
+	//
+	ui->HandleError( &e );
+	return &PL_sv_undef;
+    }
+
+    // Now we've parsed it, convert it into a hash. We do that via 
     // direct access to the method in PerlClientUser - this is ugly, but
     // expedient.
 
+    ui->SetCommand( type );
     return ui->DictToHash( specData.Dict(), specDef );
 
 }
 
+//
+// Parse a whole array of forms of the same type. The parsing is done on
+// a pool of native threads; only the conversion of the parsed forms to
+// hashes needs the interpreter. Returns an array with a hash for each
+// form, or undef for those that couldn't be parsed, whose errors are
+// in Errors() with the form's index in their arguments.
+//
+AV *
+PerlClientApi::ParseSpecs( const char *type, AV *forms, int threads )
+{
+    AV *	results = newAV();
+
+    if( !IsParseForms() )
+    {
+	warn( "P4::ParseSpecs() requires ParseForms mode" );
+	return results;
+    }
+
+    StrPtr	*specDef = FetchSpecDef( type );
+
+    if ( !specDef )
+    {
+	StrBuf m;
+	m = "P4::ParseSpecs(): No spec definition for ";
+	m.Append( type );
+	m.Append( " objects." );
+	warn( "%s", m.Text() );
+	return results;
+    }
+
+    ui->Reset( compatFlags & CPT_MERGED );
+    ui->SetCommand( type );
+
+    // Get at the text of every form before any threads start
+    int		n = av_len( forms ) + 1;
+    const char	**texts = new const char *[ n ];
+    int		i;
+
+    for( i = 0; i < n; i++ )
+    {
+	SV **svp = av_fetch( forms, i, 0 );
+	texts[ i ] = svp && SvOK( *svp ) ? SvPV_nolen( *svp ) : "";
+    }
+
+    if( P4PERL_DEBUG_FORMS )
+	printf( "[ParseSpecs]: Parsing %d %s specs on %d threads\n", 
+		n, type, threads );
+
+    P4SpecParser	parser( *specDef, n, texts );
+    parser.Run( threads );
+
+    for( i = 0; i < n; i++ )
+    {
+	StrDict	*dict = parser.Dict( i );
+
+	if( dict )
+	{
+	    av_push( results, ui->DictToHash( dict, specDef ) );
+	    continue;
+	}
+
+	// Say which form it was, in the text and as an argument
+	Error	*e = parser.GetError( i );
+	e->Set( (ErrorSeverity) e->GetSeverity(), 
+		"Form %formIndex% could not be parsed." );
+	e->GetDict()->SetVar( "formIndex", i );
+
+	ui->HandleError( e );
+	av_push( results, newSV( 0 ) );
+    }
+
+    delete [] texts;
+    return results;
+}
+
+//
+// Save an array of specs of the same type. Each hash is formatted here
+// against the cached specdef, and the forms are sent with "-i" over a
+// pool of connections (or our own if there's only to be one). Returns
+// an array with a hash for each spec saying whether it was saved, and
+// what the server said about it.
+//
+AV *
+PerlClientApi::SaveSpecs( const char *type, AV *specs, int connections )
+{
+    AV *	results = newAV();
+
+    if( !IsParseForms() )
+    {
+	warn( "P4::SaveSpecs() requires ParseForms mode" );
+	return results;
+    }
+
+    StrPtr	*specDef = FetchSpecDef( type );
+
+    if ( !specDef )
+    {
+	StrBuf m;
+	m = "P4::SaveSpecs(): No spec definition for ";
+	m.Append( type );
+	m.Append( " objects." );
+	warn( "%s", m.Text() );
+	return results;
+    }
+
+    ui->Reset( compatFlags & CPT_MERGED );
+
+    //
+    // Format everything first. Anything that isn't a hash, or can't be
+    // converted, isn't sent: formIndex[ i ] is where spec i's form is,
+    // or -1.
+    //
+    int		n = av_len( specs ) + 1;
+    StrBuf	*forms = new StrBuf[ n ];
+    int		*formIndex = new int[ n ];
+    int		nForms = 0;
+    int		i;
+
+    for( i = 0; i < n; i++ )
+    {
+	SV **svp = av_fetch( specs, i, 0 );
+
+	formIndex[ i ] = -1;
+	if( svp && SvROK( *svp ) && SvTYPE( SvRV( *svp ) ) == SVt_PVHV &&
+	    ui->HashToForm( (HV *) SvRV( *svp ), &forms[ nForms ], specDef ) )
+	    formIndex[ i ] = nForms++;
+    }
+
+    if( P4PERL_DEBUG_FORMS )
+	printf( "[SaveSpecs]: Saving %d %s specs on %d connections\n", 
+		nForms, type, connections );
+
+    P4SpecSaver	saver( type, nForms, forms );
+    int		c = connections > 1 ? ConnectBatchClients( connections ) : 0;
+
+    if( c )
+    {
+	saver.Run( batchClients, c, prog.Text(), ui );
+    }
+    else
+    {
+	CheckFork();
+	P4Lock	l( apiLock );
+	saver.Run( &client, 1, prog.Text(), ui );
+    }
+    lastActivity = P4PerlSys::Now();
+
+    for( i = 0; i < n; i++ )
+    {
+	HV	*hv = newHV();
+	int	f = formIndex[ i ];
+	StrBuf	m;
+
+	if( f < 0 )
+	{
+	    hv_store( hv, "saved", 5, newSViv( 0 ), 0 );
+	    hv_store( hv, "message", 7, 
+		      newSVpv( "Error converting hash to a string.", 0 ), 0 );
+	}
+	else
+	{
+	    saver.Messages( f, &m );
+	    hv_store( hv, "saved", 5, newSViv( !saver.Failed( f ) ), 0 );
+	    hv_store( hv, "message", 7, newSVpv( m.Text(), m.Length() ), 0 );
+	    saver.Replay( f, ui );
+	}
+	av_push( results, newRV_noinc( (SV *) hv ) );
+    }
+    ui->ReportStop();
+
+    delete [] forms;
+    delete [] formIndex;
+    return results;
+}
+
+//
+// The bytes of one side of a DiffStrings() pair: UTF-8 if either side
+// is, or Latin-1 otherwise. Strings are upgraded on a mortal copy, so
+// the caller's are left alone and the text lasts until we've finished.
+//
+static const char *
+DiffText( SV *sv, int utf8, STRLEN *len )
+{
+    if( !utf8 )
+	return SvPVbyte( sv, *len );
+
+    SV	*copy = sv_mortalcopy( sv );
+    return SvPVutf8( copy, *len );
+}
+
+//
+// Diff pairs of strings in memory, sharing the pairs out between a pool
+// of threads. Each element of pairs is a reference to an array holding
+// the left and right texts. The result for each is the diff output, or
+// if hunks is set, a reference to an array of hashes describing the
+// blocks of changed lines.
+//
+AV *
+PerlClientApi::DiffStrings( AV *pairs, const char *flags, int threads, 
+			    int hunks )
+{
+    AV *	results = newAV();
+    P4TextDiff	diff;
+    StrBuf	e;
+
+    if( !diff.SetFlags( flags, &e ) )
+    {
+	StrBuf	m;
+	m << "P4::DiffStrings(): " << e;
+	warn( "%s", m.Text() );
+	return results;
+    }
+    diff.SetFormat( !hunks );
+
+    // Get at the texts before any threads start
+    int		n = av_len( pairs ) + 1;
+    char	*utf8 = new char[ n ];
+    int		i;
+
+    for( i = 0; i < n; i++ )
+    {
+	SV 		**svp = av_fetch( pairs, i, 0 );
+	SV		**l = 0, **r = 0;
+	const char	*lt = "", *rt = "";
+	STRLEN		ll = 0, rl = 0;
+
+	if( svp && SvROK( *svp ) && SvTYPE( SvRV( *svp ) ) == SVt_PVAV )
+	{
+	    l = av_fetch( (AV *) SvRV( *svp ), 0, 0 );
+	    r = av_fetch( (AV *) SvRV( *svp ), 1, 0 );
+	}
+
+	if( l && !SvOK( *l ) ) l = 0;
+	if( r && !SvOK( *r ) ) r = 0;
+
+	// Both sides must be in the same encoding to compare their lines
+	utf8[ i ] = ( l && SvUTF8( *l ) ) || ( r && SvUTF8( *r ) );
+	if( l ) lt = DiffText( *l, utf8[ i ], &ll );
+	if( r ) rt = DiffText( *r, utf8[ i ], &rl );
+
+	diff.Add( lt, ll, rt, rl );
+    }
+
+    if( P4PERL_DEBUG_FLOW )
+	printf( "[DiffStrings]: Comparing %d pairs on %d threads\n", 
+		n, threads );
+
+    diff.Run( threads );
+
+    for( i = 0; i < n; i++ )
+    {
+	if( !hunks )
+	{
+	    const StrPtr &o = diff.Output( i );
+	    SV *sv = newSVpvn( o.Text(), o.Length() );
+	    if( utf8[ i ] ) SvUTF8_on( sv );
+	    av_push( results, sv );
+	    continue;
+	}
+
+	AV	*av = newAV();
+
+	for( int h = 0; h < diff.HunkCount( i ); h++ )
+	{
+	    P4TextDiff::Hunk	k = diff.GetHunk( i, h );
+	    HV			*hv = newHV();
+	    const char		*type = !k.leftCount ? "a" 
+					: !k.rightCount ? "d" : "c";
+
+	    hv_store( hv, "type", 4, newSVpv( type, 1 ), 0 );
+	    hv_store( hv, "leftStart", 9, newSViv( k.leftStart ), 0 );
+	    hv_store( hv, "leftCount", 9, newSViv( k.leftCount ), 0 );
+	    hv_store( hv, "rightStart", 10, newSViv( k.rightStart ), 0 );
+	    hv_store( hv, "rightCount", 10, newSViv( k.rightCount ), 0 );
+	    av_push( av, newRV_noinc( (SV *) hv ) );
+	}
+	av_push( results, newRV_noinc( (SV *) av ) );
+    }
+
+    delete [] utf8;
+    return results;
+}
+
 //
 // Convert a spec in hash form into its string representation
 //
@@ -25,6 +25,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 class ClientApi;
 class PerlClientUser;
+class P4Filter;
+class P4Aggregate;
+class P4Batch;
+class P4Iterator;
+class P4Index;
+class P4IndexUser;
+class P4ScanUser;
+class P4Router;
 
 class PerlClientApi 
 {
@@ -32,22 +40,79 @@ class PerlClientApi
     		PerlClientApi();
 		~PerlClientApi();
 
+    // A new object with the same settings, for use by another Perl thread
+    PerlClientApi *	Clone();
+
     SV *	Connect();
     SV *	Disconnect();
     SV *	Dropped();
     SV *	Run( const char *cmd, int argc, char * const *argv );
 
+    // Filtering of tagged output for the next command
+    SV *	SetFilter( const char *expr );
+    I32		GetFilteredCount();
+
+    // Aggregation of tagged output for the next command
+    SV *	SetAggregate( HV *spec );
+
+    // Page-at-a-time iteration over big results
+    P4Iterator *Iterate( const char *cmd, int argc, char * const *argv );
+    SV *	NextPage( P4Iterator *it );
+
+    // Local index of head revision metadata
+    SV *	BuildIndex( const char *file, const char *path );
+    SV *	OpenIndex( const char *file );
+    SV *	UpdateIndex();
+    SV *	IndexLookup( const char *path );
+    AV *	IndexPrefix( const char *prefix );
+
+    // Comparing the workspace with the have list
+    SV *	ScanWorkspace( const char *root, int threads, double since );
+
+    // Running a command on several servers at once
+    SV *	FanOut( AV *servers, const char *sortField, const char *cmd,
+			int argc, char * const *argv );
+
+    // Splitting of long file argument lists
+    void	SetBatching( int files, int bytes, int connections );
+    AV *	GetBatchTimes();
+
+    // Logging in once per process, not once per connection
+    void	SetTicketCache( int enable, const char *file );
+    int		IsTicketCache()			{ return ticketCache;	}
+    SV *	Login();
+
+    // Running commands that are over the server's limits in pieces
+    void	SetAutoSplit( int connections );
+    int		GetSplitCount()			{ return splitCount;	}
+
+    // Deadlines, output budgets and cancellation
+    void	SetTimeLimit( double seconds );
+    void	SetBudget( int records, double bytes );
+    void	SetCancelOnSignal( int enable );
+    void	Cancel();
+    static void	CancelAll();
+    const char *Cancelled();
+
+    // Sending reads to replicas
+    void	SetReplicas( AV *ports, double lagWindow );
+    AV *	ReplicaStats();
+
+    // Managed connections
+    void	SetAutoReconnect( int attempts, int maxWait );
+    void	SetKeepAlive( int seconds );
+
     void	SetApiLevel( int level );
     SV *	SetCharset( const char *c );
-    void	SetClient( const char *c ) 	{ client->SetClient( c );    }
-    void	SetCwd( const char *c )		{ client->SetCwd( c );	     }
-    void	SetHost( const char *c )	{ client->SetHost( c );	     }
-    void	SetLanguage( const char *c )	{ client->SetLanguage( c );  }
-    void	SetPassword( const char *c )	{ client->SetPassword( c );  }
+    void	SetClient( const char *c );
+    void	SetCwd( const char *c );
+    void	SetHost( const char *c );
+    void	SetLanguage( const char *c );
+    void	SetPassword( const char *c );
     void	SetMaxResults( int v )		{ maxResults = v;	     }
     void	SetMaxScanRows( int v )		{ maxScanRows = v;	     }
-    void	SetPort( const char *c )	{ client->SetPort( c );	     }
-    void	SetUser( const char *c )	{ client->SetUser( c );      }
+    void	SetPort( const char *c );
+    void	SetUser( const char *c );
     void	SetProg( const char *c )	{ prog.Set( c );	     }
 
     void	SetInput( SV *i );
@@ -62,7 +127,7 @@ class PerlClientApi
     SV *	GetUser();
 
     // Base protocol ops
-    void	SetProtocol( const char *p, const char *v );
+    void	SetProtocol( const char *p, const char *v );
     StrPtr *	GetProtocol( const char *v );
 
     // High-level protocol ops
@@ -75,6 +140,17 @@ class PerlClientApi
     // Handling command output
     //
     SV *	MergeErrors( int merge = -1 );
+    SV *	MergeOutput( int merge = -1 );
+    SV *	TypedValues( int typed = -1 );
+    SV *	Utf8Values( int utf8 = -1 );
+    SV *	InternValues( int mode = -1 );
+    HV *	GetInternStats();
+
+    // Progress reporting for long-running commands
+    void	SetProgress( SV *cb, double interval );
+    HV *	GetProgressStats();
+    SV *	SetFieldType( const char *field, const char *type, 
+			      const char *cmd = 0 );
     SV *	GetFirstOutput();
     AV *	GetOutput();
     AV *	GetWarnings();
@@ -84,15 +160,25 @@ class PerlClientApi
     I32		GetWarningCount();
     I32		GetErrorCount();
 
+    // Warnings and errors, unformatted
+    I32		GetMessageCount( int generic = -1 );
+    AV *	GetMessages( int generic, int code, int text );
+
 
     // Spec parsing
     SV *	ParseSpec( const char *type, const char *form );
+    AV *	ParseSpecs( const char *type, AV *forms, int threads );
+    AV *	SaveSpecs( const char *type, AV *specs, int connections );
     SV *	FormatSpec( const char *type, HV *hash );
+
+    // In-memory diffs
+    AV *	DiffStrings( AV *pairs, const char *flags, int threads, 
+			     int hunks );
     
     // Debugging support
     void	SetDebugLevel( int l );
     int		GetDebugLevel()			{ return debug;	     }
-    int		IsConnected()			{ return initCount;	     }
+    int		IsConnected();
 
     //
     private:
@@ -118,16 +204,95 @@ class PerlClientApi
     StrPtr * 	FetchSpecDef( const char *type );
     void	RunCmd( const char *cmd, ClientUser *ui, int argc, char * const *argv );
 
+    int		RunBatched( const char *cmd, int argc, char * const *argv );
+    int		ConnectBatchClients( int wanted );
+    void	DisconnectBatchClients();
+
+    void	ApplySettings( ClientApi *c );
+    ClientApi *	ConnectTagged();
+
+    int		IndexRun( ClientApi *c, P4IndexUser &u, const char *cmd,
+			  int argc, char * const *argv );
+    HV *	IndexRecord( int i );
+    int		ScanRun( ClientApi *c, P4ScanUser &u, const char *cmd,
+			 int argc, char * const *argv );
+    int		UseCachedTicket();
+    void	SavePassword();
+    int		HasLoginPassword();
+    int		LoginNow( ClientUser *u );
+    const char *TicketFile();
+    void	RunSplit( const char *cmd, int argc, char * const *argv );
+    int		Stopped( const char *cmd );
+    int		RunRouted( const char *cmd, int argc, char * const *argv );
+    ClientApi *	ReplicaConnection( int r, int probe );
+    int		Reconnect();
+    int		IsDropped();
+    void	CheckFork( int reconnect = 1 );
+    void	UpdateUtf8();
+    void	KeepAlive();
+    static void	KeepAliveThread( void *api );
+
     private:
 	ClientApi *		client;
 	PerlClientUser *	ui;
 	StrBufDict		specDict;
+	StrBufDict		protocols;
 	StrBuf			prog;
 	int			server2;
 	int			mode;
 	int			initCount;
 	int			debug;
 	int			compatFlags;
+	int			utf8Values;
 	int			maxResults;
 	int			maxScanRows;
+
+	// Managed connection support. The keepalive thread shares the
+	// ClientApi with us, so all use of it is serialised by apiLock.
+	int			reconnectAttempts;
+	int			reconnectMaxWait;
+	int			keepAliveInterval;
+	int			keepAlivePending;	// Start on first Run
+	volatile int		keepAliveStop;
+	double			lastActivity;
+	P4Mutex			apiLock;
+	P4Thread		keepAliveThread;
+
+	// The process that owns our connection
+	int			ownerPid;
+
+	// Set on clones: connect when first used
+	int			connectOnUse;
+
+	// Filter and aggregate for the next command
+	P4Filter *		filter;
+	P4Aggregate *		aggregate;
+
+	// Argument batching. The extra connections for parallel batches
+	// are made when first needed and kept until we disconnect.
+	int			batchFiles;
+	int			batchBytes;
+	int			batchConnections;
+	ClientApi **		batchClients;
+	int			batchClientCount;
+	int			batchClientMax;
+	P4Batch *		lastBatch;
+
+	// The local metadata index, if one's been built or opened
+	P4Index *		index;
+
+	// Replicas for read-only commands, if any
+	P4Router *		router;
+
+	// Splitting of commands over maxresults/maxscanrows, and how many
+	// splits the last command needed
+	int			splitConnections;
+	int			splitCount;
+
+	// Ticket caching. The password is kept for logging in again when
+	// it's been replaced by a ticket; passwordSaved says it has been.
+	int			ticketCache;
+	StrBuf			ticketFile;
+	StrBuf			loginPassword;
+	int			passwordSaved;
 };
@@ -61,7 +61,15 @@ extern "C"
 # undef Error
 #endif
 
+#include "p4utf8.h"
 #include "p4result.h"
+#include "p4arena.h"
+#include "p4filter.h"
+#include "p4aggregate.h"
+#include "p4fieldtypes.h"
+#include "p4intern.h"
+#include "p4perlsys.h"
+#include "p4progress.h"
 #include "p4perldebug.h"
 #include "perlclientuser.h"
 
@@ -71,22 +79,165 @@ extern "C"
  * server, and converts the data to Perl format for returning to the caller.
  ******************************************************************************/
 
+// Bumped by CancelAll(). Commands compare it with the value it had when
+// they started, so a cancellation only affects those already running.
+volatile int PerlClientUser::cancelGeneration = 0;
+
 PerlClientUser::PerlClientUser()
 { 
     debug = 0;
     input = 0;
+    filter = 0;
+    filtered = 0;
+    aggregate = 0;
+    typedValues = 0;
+    progressCallback = 0;
+    timeLimit = 0;
+    startTime = 0;
+    cancelOnSignal = 0;
+    stopReason = STOP_NONE;
+    generation = cancelGeneration;
+}
+
+PerlClientUser::~PerlClientUser()
+{
+    if( progressCallback )
+	SvREFCNT_dec( progressCallback );
 }
 
 
 void
-PerlClientUser::Reset(int merged )
+PerlClientUser::Reset(int merged, int keepClock )
 {
     results.Reset( merged );
     lastSpecDef.Clear();
+    filtered = 0;
+    interner.Reset();
+    progress.Start();
+
+    // The time limit runs from here, unless this is a rerun or a split
+    // of the same command, which has to finish within the original limit.
+    stopReason = STOP_NONE;
+    if( !keepClock )
+    {
+	startTime = P4PerlSys::Now();
+	generation = cancelGeneration;
+    }
 
     // Leave input alone.
 }
 
+//
+// Called by the API while it waits for the server, and by us as output
+// arrives. Returning zero makes the API abandon the command, which it
+// does by dropping the connection. The first reason found sticks.
+//
+int
+PerlClientUser::IsAlive()
+{
+    if( stopReason )
+	return 0;
+
+    if( generation != cancelGeneration )
+	Stop( STOP_CANCELLED );
+    else if( cancelOnSignal && PL_sig_pending )
+	Stop( STOP_SIGNAL );
+    else if( timeLimit > 0 && P4PerlSys::Now() - startTime >= timeLimit )
+	Stop( STOP_TIME );
+
+    return !stopReason;
+}
+
+//
+// Whether to take the next piece of output. The budget is only checked
+// here, when there's more to come, so a command whose output exactly 
+// fills it isn't reported as cut short.
+//
+int
+PerlClientUser::Accept()
+{
+    int	over = stopReason ? 0 : results.OverBudget();
+
+    if( over )
+	Stop( over == P4Result::B_RECORDS ? STOP_RECORDS : STOP_BYTES );
+
+    return IsAlive();
+}
+
+void
+PerlClientUser::Stop( int reason )
+{
+    if( stopReason )
+	return;
+
+    stopReason = reason;
+
+    if( P4PERL_DEBUG_FLOW )
+	printf( "[PerlClientUser::Stop]: Stopping command (%s)\n",
+		StopName() );
+}
+
+const char *
+PerlClientUser::StopName()
+{
+    switch( stopReason )
+    {
+    case STOP_CANCELLED:	return "cancelled";
+    case STOP_SIGNAL:		return "signal";
+    case STOP_TIME:		return "time";
+    case STOP_RECORDS:		return "records";
+    case STOP_BYTES:		return "bytes";
+    }
+    return 0;
+}
+
+//
+// Say why a command was stopped. Running out of time, or being
+// cancelled, is an error; reaching the output budget just means the
+// results are incomplete, so that's only a warning.
+//
+void
+PerlClientUser::ReportStop()
+{
+    Error	e;
+    char	limit[ 32 ];
+
+    switch( stopReason )
+    {
+    case STOP_NONE:
+	return;
+
+    case STOP_CANCELLED:
+	e.Set( E_FAILED, "Command cancelled." );
+	break;
+
+    case STOP_SIGNAL:
+	e.Set( E_FAILED, "Command cancelled by a signal." );
+	break;
+
+    case STOP_TIME:
+	sprintf( limit, "%g", timeLimit );
+	e.Set( E_FAILED, 
+	       "Command cancelled: time limit of %limit% seconds reached." );
+	e << limit;
+	break;
+
+    case STOP_RECORDS:
+	e.Set( E_WARN, "Output truncated: record limit of %limit% reached." );
+	e << results.MaxRecords();
+	break;
+
+    case STOP_BYTES:
+	sprintf( limit, "%.0f", results.MaxBytes() );
+	e.Set( E_WARN, 
+	       "Output truncated: output limit of %limit% bytes reached." );
+	e << limit;
+	break;
+    }
+
+    results.AddError( &e );
+}
+
 void	
 PerlClientUser::Finished()
 {
@@ -108,6 +259,10 @@ PerlClientUser::HandleError( Error *e )
     if( P4PERL_DEBUG_FLOW )
 	printf( "[PerlClientUser:HandleError]: Received error\n" );
 
+    // The API's complaints about the connection we dropped on purpose
+    if( stopReason )
+	return;
+
     results.AddError( e );
 }
 
@@ -117,7 +272,14 @@ PerlClientUser::OutputText( const_char *data, int length )
     if ( P4PERL_DEBUG_FLOW )
 	printf( "[PerlClientUser::OutputText]: Received %d bytes\n", length );
 
-    results.AddOutput( data );
+    if( !Accept() )
+	return;
+
+    results.AddText( data, length );
+
+    progress.OutputBytes( length );
+    if( progressCallback && progress.Due() )
+	ReportProgress( 0 );
 }
 
 void
@@ -126,7 +288,15 @@ PerlClientUser::OutputInfo( char level, const_char *data )
     if ( P4PERL_DEBUG_FLOW )
 	printf( "[PerlClientUser::OutputInfo]: Received data\n" );
 
+    if( !Accept() )
+	return;
+
     results.AddOutput( data );
+
+    // Commands like sync report each file with a line of output
+    progress.OutputFile( 0 );
+    if( progressCallback && progress.Due() )
+	ReportProgress( 0 );
 }
 
 void
@@ -136,11 +306,31 @@ PerlClientUser::OutputBinary( const_char *data, int length )
 	printf( "[PerlClientUser::OutputBinary]: Received %d bytes\n", length );
 
     //
-    // Binary is just stored in a string. Since the char * version of
-    // P4Result::AddOutput() assumes it can strlen() to find the length,
-    // we'll make the String object here.
+    // Binary is just stored in a string, the same as text.
     //
-    results.AddOutput( sv_2mortal( newSVpv( data, length) ) );
+    if( !Accept() )
+	return;
+
+    results.AddText( data, length );
+
+    progress.OutputBytes( length );
+    if( progressCallback && progress.Due() )
+	ReportProgress( 0 );
+}
+
+//
+// Roughly what a tagged record weighs, for the output budget: the length
+// of its keys and values.
+//
+static double
+DictBytes( StrDict *d )
+{
+    StrRef	var, val;
+    double	n = 0;
+
+    for( int i = 0; d->GetVar( i, var, val ); i++ )
+	n += var.Length() + val.Length();
+    return n;
 }
 
 void
@@ -148,6 +338,12 @@ PerlClientUser::OutputStat( StrDict *values )
 {
     StrPtr	*spec, *data;
 
+    if( !Accept() )
+	return;
+
+    // Each record starts with a clean slate of scratch memory
+    scratch.Reset();
+
     // If both specdef and data are set, then we need to parse the form
     // and return the results. If not, then we just convert it as is.
 
@@ -163,6 +359,19 @@ PerlClientUser::OutputStat( StrDict *values )
     if( spec )
 	lastSpecDef = spec->Text();
 
+    // Each record is (usually) a file, so count it for progress reports.
+    // Some commands also tell us in advance how much there is to do.
+    StrPtr	*v;
+    if( ( v = values->GetVar( "totalFileCount" ) ) )
+	progress.SetTotalFiles( v->Atoi() );
+    if( ( v = values->GetVar( "totalFileSize" ) ) )
+	progress.SetTotalBytes( atof( v->Text() ) );
+
+    v = values->GetVar( "fileSize" );
+    progress.OutputFile( v ? atof( v->Text() ) : 0 );
+    if( progressCallback && progress.Due() )
+	ReportProgress( 0 );
+
     if ( spec && data )
     {
 	if ( P4PERL_DEBUG_FORMS )
@@ -183,14 +392,105 @@ PerlClientUser::OutputStat( StrDict *values )
 	    return;
 	}
 
+	if ( filter && !filter->Match( specData.Dict() ) )
+	{
+	    filtered++;
+	    return;
+	}
+
+	if ( aggregate )
+	{
+	    aggregate->Add( specData.Dict() );
+	    return;
+	}
+
+	results.AddBytes( data->Length() );
 	results.AddOutput( DictToHash( specData.Dict(), spec ) );
     }
     else
     {
+	// Records that fail the filter never make it into Perl at all
+	if ( filter && !filter->Match( values ) )
+	{
+	    filtered++;
+	    return;
+	}
+
+	// Likewise, aggregated records are only counted
+	if ( aggregate )
+	{
+	    aggregate->Add( values );
+	    return;
+	}
+
+	// Sized only if anyone's counting
+	if( results.MaxBytes() )
+	    results.AddBytes( DictBytes( values ) );
+
 	results.AddOutput( DictToHash( values, NULL ) );
     }
 }
 
+/*
+ * Convert the rows of the aggregate into hashes once the command has
+ * finished. Group rows hold the group values, the count and each of the
+ * sum/min/max columns (omitted when no record had a numeric value for
+ * it). In record mode, the selected records are converted as usual.
+ */
+void
+PerlClientUser::AggregateResults()
+{
+    if ( !aggregate ) return;
+
+    aggregate->Finish();
+
+    if ( P4PERL_DEBUG_DATA )
+	printf( "[PerlClientUser::AggregateResults]: %d rows\n", 
+		aggregate->GroupCount() );
+
+    for ( int g = 0; g < aggregate->GroupCount(); g++ )
+    {
+	if ( aggregate->IsRecordMode() )
+	{
+	    results.AddOutput( DictToHash( aggregate->Record( g ), NULL ) );
+	    continue;
+	}
+
+	HV *	hv = newHV();
+	int	i;
+
+	for ( i = 0; i < aggregate->KeyCount(); i++ )
+	{
+	    const StrPtr &k = aggregate->KeyName( i );
+	    const StrPtr &v = aggregate->KeyValue( g, i );
+	    hv_store( hv, k.Text(), k.Length(), 
+			results.NewString( v.Text(), v.Length() ), 0 );
+	}
+
+	hv_store( hv, "count", 5, newSViv( (IV) aggregate->Count( g ) ), 0 );
+
+	for ( i = 0; i < aggregate->ColumnCount(); i++ )
+	{
+	    if ( !aggregate->HasValue( g, i ) ) continue;
+
+	    const StrPtr &k = aggregate->ColumnName( i );
+	    double	d = aggregate->Value( g, i );
+	    SV *	sv;
+
+	    // Whole numbers (the usual case: sizes, revisions, changes)
+	    // come back as integers
+	    if ( d == (double)(IV) d )
+		sv = newSViv( (IV) d );
+	    else
+		sv = newSVnv( d );
+
+	    hv_store( hv, k.Text(), k.Length(), sv, 0 );
+	}
+
+	results.AddOutput( newRV_noinc( (SV *) hv ) );
+    }
+}
+
 
 /*
  * Diff support for Perl API. Since the Diff class only writes its output
@@ -247,7 +547,15 @@ PerlClientUser::Diff( FileSys *f1, FileSys *f2, int doPage,
 	// OK, now we have the diff output, read it in and add it to 
 	// the output.
 	if ( ! e->Test() ) t->Open( FOM_READ, e );
-	if ( ! e->Test() ) 
+	if ( ! e->Test() && results.IsMergeOutput() )
+	{
+	    // Merging, so there's no need to split it into lines
+	    char	buf[ 65536 ];
+	    int		len;
+	    while( ( len = t->Read( buf, sizeof( buf ), e ) ) > 0 )
+		results.AddText( buf, len );
+	}
+	else if ( ! e->Test() ) 
 	{
 	    StrBuf 	b;
 	    while( t->ReadLine( &b, e ) )
@@ -266,19 +574,21 @@ PerlClientUser::Diff( FileSys *f1, FileSys *f2, int doPage,
 /*
  * Prompt the user for input
  */
+
 void
 PerlClientUser::Prompt( const StrPtr &msg, StrBuf &rsp, int noEcho, Error *e )
 {
     if ( P4PERL_DEBUG_FLOW )
 	printf( "[PerlClientUser::Prompt]: Using supplied input\n" );
 
-    InputData( &rsp, e );
+    NextInput( &rsp, &msg );
 }
 
 /*
  * convert input from the user into a form digestible to Perforce. This
  * involves either (a) converting any supplied hash to a Perforce form, or
- * (b) reading whatever we were given as a string.
+ * (b) reading whatever we were given as a string, or (c) pulling the 
+ * next input from a filehandle or code ref.
  */
 
 void
@@ -287,6 +597,12 @@ PerlClientUser::InputData( StrBuf *strbuf, Error *e )
     if ( P4PERL_DEBUG_FLOW )
 	printf( "[PerlClientUser::InputData]: Using supplied input\n" );
 
+    NextInput( strbuf, 0 );
+}
+
+void
+PerlClientUser::NextInput( StrBuf *strbuf, const StrPtr *prompt )
+{
     if( ! input )
     {
 	warn( "InputData() called with no supplied input" );
@@ -304,29 +620,147 @@ PerlClientUser::InputData( StrBuf *strbuf, Error *e )
     }
 
     // 
-    // Now de-reference it and try to figure out if we're looking at a PV, 
-    // an HV, or an AV. If it's an array, then it may be an array of PVs or
-    // an array of HVs, so we shift it by one and use the first element.
+    // Now de-reference it and try to figure out what we're looking at.
+    // If it's an array, then it may be an array of any of the other
+    // kinds of input, so we shift it by one and use the first element.
     //
     SV *s = SvRV( input );
     if( SvTYPE( s ) == SVt_PVAV )
     {
 	s = av_shift( (AV *) s );
-	if( !s )
+	if( !s || s == &PL_sv_undef )
 	{
 	    warn( "InputData() ran out of input for Perforce command" );
 	    return;
 	}
+	sv_2mortal( s );
     }
 
-    if( SvTYPE( s ) == SVt_PVHV )
+    ConvertInput( s, strbuf, prompt );
+}
+
+/*
+ * Turn one input item into the text of a response. Hashes are converted
+ * to forms. Code refs are called (with the prompt, if there is one) and
+ * whatever they return is used in turn; returning undef means there's
+ * no more input. Filehandles are read directly into the buffer in large
+ * blocks, without going through a Perl string: to EOF for forms, or a 
+ * line at a time for prompts. Anything else is used as a string.
+ */
+
+void
+PerlClientUser::ConvertInput( SV *s, StrBuf *strbuf, const StrPtr *prompt )
+{
+    if( SvROK( s ) )
+	s = SvRV( s );
+
+    switch( SvTYPE( s ) )
     {
+    case SVt_PVHV:
 	HashToForm( (HV *)s, strbuf );
 	return;
-    } 
+
+    case SVt_PVCV:
+	CallInput( (CV *)s, strbuf, prompt );
+	return;
+
+    case SVt_PVGV:
+    case SVt_PVIO:
+	ReadInput( s, strbuf, prompt != 0 );
+	return;
+
+    default:
+	break;
+    }
 
     // Otherwise, we assume it's a string - a reasonable assumption
-    strbuf->Set( SvPV_nolen( s ) );
+    STRLEN	len;
+    char	*p = SvPV( s, len );
+    strbuf->Set( p, len );
+}
+
+void
+PerlClientUser::CallInput( CV *cv, StrBuf *strbuf, const StrPtr *prompt )
+{
+    dSP;
+    int		n;
+    SV *	r;
+
+    if ( P4PERL_DEBUG_FLOW )
+	printf( "[PerlClientUser::CallInput]: Calling input generator\n" );
+
+    ENTER;
+    SAVETMPS;
+
+    PUSHMARK( SP );
+    if( prompt )
+	XPUSHs( sv_2mortal( newSVpv( prompt->Text(), prompt->Length() ) ) );
+    PUTBACK;
+
+    n = call_sv( (SV *)cv, G_SCALAR | G_EVAL );
+
+    SPAGAIN;
+    r = n ? POPs : &PL_sv_undef;
+    PUTBACK;
+
+    if( SvTRUE( ERRSV ) )
+	warn( "Input generator failed: %s", SvPV_nolen( ERRSV ) );
+    else if( !SvOK( r ) )
+	warn( "InputData() ran out of input for Perforce command" );
+    else if( SvROK( r ) && SvTYPE( SvRV( r ) ) == SVt_PVCV )
+	warn( "Input generator returned a code ref" );
+    else
+	ConvertInput( r, strbuf, prompt );
+
+    FREETMPS;
+    LEAVE;
+}
+
+void
+PerlClientUser::ReadInput( SV *fh, StrBuf *strbuf, int line )
+{
+    IO *	io = sv_2io( fh );
+    PerlIO *	fp = io ? IoIFP( io ) : 0;
+
+    strbuf->Clear();
+
+    if( !fp )
+    {
+	warn( "Input filehandle is not open for reading" );
+	return;
+    }
+
+    if( line )
+    {
+	int	c;
+	while( ( c = PerlIO_getc( fp ) ) != EOF && c != '\n' )
+	    strbuf->Extend( (char) c );
+
+	if( strbuf->Length() && strbuf->Text()[ strbuf->Length() - 1 ] == '\r' )
+	    strbuf->SetLength( strbuf->Length() - 1 );
+
+	strbuf->Terminate();
+	return;
+    }
+
+    // Read in 64K blocks straight into the buffer
+    for( ;; )
+    {
+	int	len = strbuf->Length();
+	char	*p = strbuf->Alloc( 65536 );
+	SSize_t	n = PerlIO_read( fp, p, 65536 );
+
+	strbuf->SetLength( len + ( n > 0 ? n : 0 ) );
+	if( n <= 0 ) break;
+    }
+    strbuf->Terminate();
+
+    if( PerlIO_error( fp ) )
+	warn( "Error reading input filehandle" );
+
+    if ( P4PERL_DEBUG_FLOW )
+	printf( "[PerlClientUser::ReadInput]: Read %d bytes\n", 
+		strbuf->Length() );
 }
 
 /*
@@ -353,6 +787,100 @@ PerlClientUser::SetInput( SV * i )
 }
 
 
+/*
+ * Progress reporting. The callback is called with a hash of the figures
+ * so far, no more often than the configured interval, and once more when
+ * the command has finished.
+ */
+
+void
+PerlClientUser::SetProgress( SV *cb, double interval )
+{
+    if( progressCallback )
+	SvREFCNT_dec( progressCallback );
+    progressCallback = 0;
+
+    if( cb && SvOK( cb ) )
+	progressCallback = newSVsv( cb );
+
+    progress.SetInterval( interval );
+}
+
+HV *
+PerlClientUser::ProgressHash( int done )
+{
+    HV *	hv = newHV();
+
+    hv_store( hv, "files", 5, newSVnv( progress.Files() ), 0 );
+    hv_store( hv, "totalFiles", 10, newSVnv( progress.TotalFiles() ), 0 );
+    hv_store( hv, "bytes", 5, newSVnv( progress.Bytes() ), 0 );
+    hv_store( hv, "totalBytes", 10, newSVnv( progress.TotalBytes() ), 0 );
+    hv_store( hv, "elapsed", 7, newSVnv( progress.Elapsed() ), 0 );
+    hv_store( hv, "rate", 4, 
+	      newSVnv( done ? progress.AverageRate() : progress.Rate() ), 0 );
+    hv_store( hv, "done", 4, newSViv( done ), 0 );
+
+    const StrPtr &d = progress.Description();
+    if( d.Length() )
+	hv_store( hv, "description", 11, newSVpv( d.Text(), d.Length() ), 0 );
+
+    return hv;
+}
+
+void
+PerlClientUser::ReportProgress( int done )
+{
+    dSP;
+
+    if( !progressCallback )
+	return;
+
+    if( P4PERL_DEBUG_FLOW )
+	printf( "[PerlClientUser::ReportProgress]: %.0f files\n", 
+		progress.Files() );
+
+    ENTER;
+    SAVETMPS;
+
+    PUSHMARK( SP );
+    XPUSHs( sv_2mortal( newRV_noinc( (SV *) ProgressHash( done ) ) ) );
+    PUTBACK;
+
+    call_sv( progressCallback, G_DISCARD | G_EVAL );
+
+    if( SvTRUE( ERRSV ) )
+	warn( "Progress callback failed: %s", SvPV_nolen( ERRSV ) );
+
+    FREETMPS;
+    LEAVE;
+}
+
+void
+PerlClientUser::ProgressEvent( void *ui )
+{
+    PerlClientUser *u = (PerlClientUser *) ui;
+
+    if( u->progressCallback && u->progress.Due() )
+	u->ReportProgress( 0 );
+}
+
+#if P4API_VERSION >= 515073
+// Progress indicators were first introduced in 2012.1
+
+ClientProgress *
+PerlClientUser::CreateProgress( int type )
+{
+    return new P4ClientProgress( type, &progress, ProgressEvent, this );
+}
+
+int
+PerlClientUser::ProgressIndicator()
+{
+    return progressCallback != 0;
+}
+
+#endif
+
 /*
  * Convert a Perforce StrDict into a Perl hash. Convert multi-level 
  * data (Files0, Files1 etc. ) into (nested) array members of the hash. If
@@ -369,13 +897,17 @@ PerlClientUser::DictToHash( StrDict *d, StrPtr *specDef )
     HV		*hv = newHV();
     int		i;
     int		seq;
-    StrBuf	key;
     StrRef	var, val;
     StrPtr	*data = d->GetVar( "data" );
 
     if( P4PERL_DEBUG_FLOW )
     	printf( "[PerlClientUser::DictToHash]: Converting dictionary to hash\n" );
 
+    scratch.Reset();
+
+    if( typedValues )
+	fieldTypes.Select( command.Text(), specDef );
+
     for( i = 0; d->GetVar( i, var, val ); i++ )
     {
 	// Ignore special variables
@@ -436,7 +968,8 @@ PerlClientUser::HashToForm( HV *hv, StrBuf *b, StrPtr *specdef )
 
     for ( hv_iterinit( flatHv ); val = hv_iternextsv( flatHv, &key, &klen ); )
     {
-	if ( !SvPOK( val ) ) continue;
+	// Numbers, as typed values come back, are stringified too
+	if ( !SvOK( val ) ) continue;
 	specData.Dict()->SetVar( key, SvPV_nolen( val ) );
     }
 
@@ -450,16 +983,18 @@ PerlClientUser::HashToForm( HV *hv, StrBuf *b, StrPtr *specdef )
 
 /*
  * Split a key into its base name and its index. i.e. for a key "how1,0"
- * the base name is "how" and they index is "1,0"
+ * the base name is "how" and they index is "1,0". Both are references into
+ * the key itself, so nothing is copied. Note that base is therefore not
+ * null terminated.
  */
 
 void
-PerlClientUser::SplitKey( const StrPtr *key, StrBuf &base, StrBuf &index )
+PerlClientUser::SplitKey( const StrPtr *key, StrRef &base, StrRef &index )
 {
     int i;
 
-    base = *key;
-    index = "";
+    base.Set( key->Text(), key->Length() );
+    index.Set( "", 0 );
     // Start at the end and work back till we find the first char that is
     // neither a digit, nor a comma. That's the split point.
     for ( i = key->Length(); i;  i-- )
@@ -468,7 +1003,7 @@ PerlClientUser::SplitKey( const StrPtr *key, StrBuf &base, StrBuf &index )
 	if ( !isdigit( prev ) && prev != ',' )
 	{
 	    base.Set( key->Text(), i );
-	    index.Set( key->Text() + i );
+	    index.Set( key->Text() + i, key->Length() - i );
 	    break;
 	}
     }
@@ -477,6 +1012,10 @@ PerlClientUser::SplitKey( const StrPtr *key, StrBuf &base, StrBuf &index )
 /*
  * Insert an element into the response structure. The element may need to
  * be inserted into an array nested deeply within the enclosing hash.
+ *
+ * This is called for every field of every record, so it's careful not to
+ * touch the heap: the key is split in place, the index levels are parsed
+ * in place, and anything else is allocated from the scratch arena.
  */
 
 void
@@ -484,8 +1023,7 @@ PerlClientUser::InsertItem( HV *hv, const StrPtr *var, const StrPtr *val )
 {
     SV		**svp = 0;
     AV		*av = 0;
-    StrBuf	base, index;
-    StrRef	comma( "," );
+    StrRef	base, index;
 
     if ( P4PERL_DEBUG_DATA )
 	printf( "[PerlClientUser::InsertItem]: key %s, value %s \n", 
@@ -494,7 +1032,8 @@ PerlClientUser::InsertItem( HV *hv, const StrPtr *var, const StrPtr *val )
     SplitKey( var, base, index );
 
     if ( P4PERL_DEBUG_FORMCONV )
-	printf( "\tbase=%s, index=%s\n", base.Text(), index.Text() );
+	printf( "\tbase=%.*s, index=%s\n", base.Length(), base.Text(), 
+		index.Text() );
 
 
     // If there's no index, then we insert into the top level hash 
@@ -503,16 +1042,22 @@ PerlClientUser::InsertItem( HV *hv, const StrPtr *var, const StrPtr *val )
     // both an array element and a scalar. The scalar comes last, so we
     // just rename it to "otherOpens" to avoid trashing the previous key
     // value
-    if ( index == "" )
+    if ( !index.Length() )
     {
 	svp = hv_fetch( hv, base.Text(), base.Length(), 0 );
 	if ( svp )
-	    base.Append( "s" );
+	{
+	    char *s = scratch.Alloc( base.Length() + 2 );
+	    memcpy( s, base.Text(), base.Length() );
+	    s[ base.Length() ] = 's';
+	    s[ base.Length() + 1 ] = 0;
+	    base.Set( s, base.Length() + 1 );
+	}
 
 	if ( P4PERL_DEBUG_FORMCONV )
-	    printf( "\tCreating new scalar hash member %s\n", base.Text() );
-	hv_store( hv, base.Text(), base.Length(), 
-	     newSVpv( val->Text(), val->Length() ), 0 );
+	    printf( "\tCreating new scalar hash member %.*s\n", 
+		    base.Length(), base.Text() );
+	hv_store( hv, base.Text(), base.Length(), NewValue( base, val ), 0 );
 	return;
     }
 
@@ -523,10 +1068,11 @@ PerlClientUser::InsertItem( HV *hv, const StrPtr *var, const StrPtr *val )
     if ( ! svp ) 
     {
 	if ( P4PERL_DEBUG_FORMCONV )
-	    printf( "\tCreating new array hash member %s\n", base.Text() );
+	    printf( "\tCreating new array hash member %.*s\n", 
+		    base.Length(), base.Text() );
 
 	av = newAV();
-	hv_store( hv, base.Text(), base.Length(), newRV( (SV*)av) ,0 );
+	hv_store( hv, base.Text(), base.Length(), newRV_noinc( (SV*)av) ,0 );
     }
 
     //
@@ -541,20 +1087,21 @@ PerlClientUser::InsertItem( HV *hv, const StrPtr *var, const StrPtr *val )
 	SV *	sv;
 
 	if ( P4PERL_DEBUG_FORMCONV )
-	    printf( "\tConverting value for %s from scalar to array.\n", base.Text() );
+	    printf( "\tConverting value for %.*s from scalar to array.\n", 
+		    base.Length(), base.Text() );
 	//
 	// For some reason simply moving the SV out of the hash and into
 	// the array doesn't work. Hence we're creating a copy...
 	//
 	av = newAV();
-	sv = newSVpv( SvPV( *svp, PL_na ), 0 );
+	sv = newSVsv( *svp );
 	av_push( av, sv );
 
 	// Now delete the existing value and have its refcount decremented
 	hv_delete( hv, base.Text(), base.Length(), G_DISCARD );
 
 	// Store the new entry and refetch it so that svp is correctly set
-	hv_store( hv, base.Text(), base.Length(), newRV( (SV*)av ), 0 );
+	hv_store( hv, base.Text(), base.Length(), newRV_noinc( (SV*)av ), 0 );
 	svp = hv_fetch( hv, base.Text(), base.Length(), 0 );
     }
 
@@ -567,11 +1114,12 @@ PerlClientUser::InsertItem( HV *hv, const StrPtr *var, const StrPtr *val )
     if ( P4PERL_DEBUG_FORMCONV )
 	printf( "\tFinding correct index level...\n" );
 
-    for( const char *c = 0 ; c = index.Contains( comma ); )
+    for( const char *c = index.Text(); strchr( c, ',' ); c++ )
     {
-	StrBuf	level;
-	level.Set( index.Text(), c - index.Text() );
-	index.Set( c + 1 );
+	// Parse the level number in place
+	int	level = 0;
+	for( ; *c != ','; c++ )
+	    level = level * 10 + ( *c - '0' );
 
 	// Found another level so we need to get/create a nested AV
 	// under the current av. If the level is "0", then we create a new
@@ -580,11 +1128,11 @@ PerlClientUser::InsertItem( HV *hv, const StrPtr *var, const StrPtr *val )
 	if ( P4PERL_DEBUG_FORMCONV )
 	    printf( "\t\tgoing down...\n" );
 
-	svp = av_fetch( av, level.Atoi(), 0 );
+	svp = av_fetch( av, level, 0 );
 	if ( ! svp )
 	{
 	    AV *tav = newAV();
-	    av_store( av, level.Atoi(), newRV( (SV*)tav) );
+	    av_store( av, level, newRV_noinc( (SV*)tav) );
 	    av = tav;
 	}
 	else
@@ -607,7 +1155,74 @@ PerlClientUser::InsertItem( HV *hv, const StrPtr *var, const StrPtr *val )
     if ( P4PERL_DEBUG_FORMCONV )
 	printf( "\tInserting value %s\n", val->Text() );
 
-    av_push( av, newSVpv( val->Text(), 0 ) );
+    av_push( av, NewValue( base, val ) );
+}
+
+/*
+ * Create the SV for a value. Normally that's a string but with typed 
+ * values enabled, known numeric fields holding a plain integer become
+ * IVs. Only canonical integers (no leading zeros or plus signs) are
+ * converted, so the value stringifies exactly as the server sent it.
+ * Strings may come from the interner if it's enabled, and are flagged
+ * as UTF-8 in UTF-8 mode.
+ */
+
+SV *
+PerlClientUser::NewValue( const StrPtr &field, const StrPtr *val )
+{
+    const char	*p = val->Text();
+    int		len = val->Length();
+    SV		*sv;
+
+    switch( typedValues ? fieldTypes.Lookup( field.Text(), field.Length() )
+			: P4FieldTypes::T_STRING )
+    {
+    case P4FieldTypes::T_INT:
+	{
+	    int	neg = ( *p == '-' );
+	    int	digits = len - neg;
+	    IV	iv = 0;
+
+	    // Small enough that it can't overflow
+	    if( !digits || digits > ( sizeof( IV ) > 4 ? 18 : 9 ) )
+		break;
+	    if( p[ neg ] == '0' && digits > 1 )
+		break;
+
+	    int i;
+	    for( i = neg; i < len && p[ i ] >= '0' && p[ i ] <= '9'; i++ )
+		iv = iv * 10 + ( p[ i ] - '0' );
+
+	    if( i < len || ( neg && !iv ) )
+		break;
+
+	    return newSViv( neg ? -iv : iv );
+	}
+
+    case P4FieldTypes::T_NUM:
+	{
+	    char	*end;
+	    NV		nv;
+
+	    if( !len ) break;
+	    nv = strtod( p, &end );
+	    if( end != p + len ) break;
+
+	    return newSVnv( nv );
+	}
+
+    default:
+	break;
+    }
+
+    // Interned values are shared, so only plain ASCII ones can be shared
+    // once they might need flagging as UTF-8.
+    if( interner.GetMode() && 
+	( !results.IsUtf8() || P4Utf8::IsAscii( p, len ) ) &&
+	( sv = interner.Get( field, p, len ) ) )
+	return sv;
+
+    return results.NewString( p, len );
 }
 
 // Flatten array elements in a hash into something Perforce can parse.
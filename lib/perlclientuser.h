@@ -40,10 +40,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * PerlClientUser - the user interface part. Gets responses from the Perforce
  * server, and converts the data to Perl format for returning to the caller.
  ******************************************************************************/
-class PerlClientUser : public ClientUser
+class PerlClientUser : public ClientUser, public KeepAlive
 {
     public:
 	PerlClientUser();
+	~PerlClientUser();
 
 	// Client User methods overridden here
 	void	HandleError( Error *e );
@@ -59,13 +60,63 @@ class PerlClientUser : public ClientUser
 
 	void	Finished();
 
+#if P4API_VERSION >= 515073
+	ClientProgress *CreateProgress( int type );
+	int		ProgressIndicator();
+#endif
+
 	// Local methods
 	void	 	SetInput( SV * i );
 	P4Result& 	GetResults()		{ return results;	} 
 	I32	 	ErrorCount();
-	void	 	Reset(int merged = 0);
+	void	 	Reset(int merged = 0, int keepClock = 0);
 	StrPtr & 	LastSpecDef()		{ return lastSpecDef;	}
 
+	// Filtering of tagged output. The filter is owned by the caller.
+	void		SetFilter( P4Filter *f )	{ filter = f;	}
+	I32		FilteredCount()		{ return filtered;	}
+
+	// Aggregation of tagged output. Records are folded into the
+	// aggregate instead of being returned; AggregateResults() then
+	// adds its rows to the results. Also owned by the caller.
+	void		SetAggregate( P4Aggregate *a )	{ aggregate = a; }
+	void		AggregateResults();
+
+	// Typed values. Known numeric fields become IVs or NVs instead of
+	// strings. The command is needed to choose the right fields.
+	void		SetTypedValues( int t )	{ typedValues = t;	}
+	int		IsTypedValues()		{ return typedValues;	}
+	P4FieldTypes &	FieldTypes()		{ return fieldTypes;	}
+	void		SetCommand( const char *c )	{ command.Set( c ); }
+
+	// Progress reporting
+	void		SetProgress( SV *cb, double interval );
+	void		ReportProgress( int done );
+	HV *		ProgressHash( int done );
+	int		HasProgress()		{ return progressCallback != 0; }
+
+	// Stopping a command before it's finished. The API calls IsAlive()
+	// every so often while a command runs, and the output handlers
+	// check before taking each piece of output; once either has said
+	// no, any further output is dropped. IsAlive() only looks at flags
+	// and the clock, so it's safe wherever the API calls it from.
+	enum { STOP_NONE, STOP_CANCELLED, STOP_SIGNAL, STOP_TIME, 
+	       STOP_RECORDS, STOP_BYTES };
+
+	int		IsAlive();
+	void		Cancel()		{ Stop( STOP_CANCELLED ); }
+	static void	CancelAll()		{ cancelGeneration++;	}
+	void		SetTimeLimit( double s )	{ timeLimit = s; }
+	double		TimeLimit()		{ return timeLimit;	}
+	void		SetCancelOnSignal( int c )	{ cancelOnSignal = c; }
+	int		IsCancelOnSignal()	{ return cancelOnSignal; }
+	int		StopReason()		{ return stopReason;	}
+	const char *	StopName();
+	void		ReportStop();
+
+	// Interning of repetitive values
+	P4Interner &	Interner()		{ return interner;	}
+
 	// Debugging support
 	void		SetDebugLevel( int d )	
 	{ 
@@ -79,14 +130,43 @@ class PerlClientUser : public ClientUser
 	SV *		DictToHash( StrDict *form, StrPtr *specDef );
 
     private:
-	void	SplitKey( const StrPtr *key, StrBuf &base, StrBuf &index );
+	void	NextInput( StrBuf *strbuf, const StrPtr *prompt );
+	void	ConvertInput( SV *s, StrBuf *strbuf, const StrPtr *prompt );
+	void	CallInput( CV *cv, StrBuf *strbuf, const StrPtr *prompt );
+	void	ReadInput( SV *fh, StrBuf *strbuf, int line );
+
+	static void	ProgressEvent( void *ui );
+
+	int	Accept();
+	void	Stop( int reason );
+
+	SV *	NewValue( const StrPtr &field, const StrPtr *val );
+	void	SplitKey( const StrPtr *key, StrRef &base, StrRef &index );
 	void	InsertItem( HV * hash, const StrPtr *var, const StrPtr *val );
 	HV * 	FlattenHash( HV *hv );
 
     private:
 	P4Result	results;
+	P4Arena		scratch;	// Per-record conversion temporaries
 	StrBuf		lastSpecDef;
+	P4Filter *	filter;
+	I32		filtered;
+	P4Aggregate *	aggregate;
+	P4FieldTypes	fieldTypes;
+	int		typedValues;
+	StrBuf		command;
+	P4Interner	interner;
+	P4ProgressStats	progress;
+	SV *		progressCallback;
 	SV *		input;
 	int		debug;
+
+	double		timeLimit;
+	double		startTime;
+	int		cancelOnSignal;
+	int		stopReason;
+	int		generation;
+
+	static volatile int	cancelGeneration;
 };
 